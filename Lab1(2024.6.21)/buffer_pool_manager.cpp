@@ -1,5 +1,37 @@
 #include "buffer_pool_manager.h"
 
+#include <algorithm>
+#include <chrono>
+
+#include "metrics.h"
+#include "recovery/log_manager.h"
+
+/**
+ * 帧的数据不再内嵌在Page中，而是指向FrameArena中按页对齐的一块，使DiskManager可以对帧直接做O_DIRECT读写
+ */
+BufferPoolManager::BufferPoolManager(size_t pool_size, DiskManager *disk_manager)
+    : pool_size_(pool_size), frames_(pool_size), disk_manager_(disk_manager) {
+    pages_ = new Page[pool_size_];
+    for (size_t i = 0; i < pool_size_; ++i) {
+        pages_[i].data_ = frames_.frame(i);
+    }
+    replacer_ = new LRUReplacer(pool_size_);
+    // 初始化时，所有的page都在free_list_中
+    for (size_t i = 0; i < pool_size_; ++i) {
+        free_list_.emplace_back(static_cast<frame_id_t>(i));
+    }
+}
+
+BufferPoolManager::~BufferPoolManager() {
+    delete[] pages_;
+    delete replacer_;
+}
+
+/** 从start到现在的纳秒数，用于把查询的停顿归因到缓冲池的I/O上 */
+static uint64_t nanos_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
 /**
  * @brief 从free_list或replacer中得到可淘汰帧页的 *frame_id
  * @param frame_id 帧页id指针,返回成功找到的可替换帧id
@@ -15,6 +47,7 @@ bool BufferPoolManager::FindVictimPage(frame_id_t *frame_id) {
         if (!this->replacer_->Victim(frame_id)) { // 空闲帧不足,调用LRU淘汰
             return false; // 淘汰失败
         }
+        MetricsRegistry::add(Metric::BUFFER_POOL_EVICTIONS);
     }
     else {
         *frame_id = this->free_list_.front();// 还有空闲帧,直接使用
@@ -25,44 +58,167 @@ bool BufferPoolManager::FindVictimPage(frame_id_t *frame_id) {
 }
 
 
+/**
+ * @brief WAL: 写回页面之前，保证修改该页面的日志(LSN <= page_lsn)已经落盘
+ * 记录文件之外的页面(索引、FSM、文件头)不写日志，其page_lsn为0，总是已持久化
+ * @param page 即将写回磁盘的页面
+ */
+void BufferPoolManager::FlushLogForPage(Page *page) {
+    if (log_manager_ != nullptr && page->GetPageLsn() > log_manager_->GetPersistLsn()) {
+        auto start = std::chrono::steady_clock::now();
+        log_manager_->WaitForFlush(page->GetPageLsn());
+        MetricsRegistry::add(Metric::BUFFER_POOL_WAL_STALL_NS, nanos_since(start));
+    }
+}
+
+/**
+ * @brief 页面从磁盘读入或写回磁盘时调用，记录recLSN的下界：此后对页面的修改的LSN都不小于当前的next_lsn
+ */
+void BufferPoolManager::ResetRecLsn(Page *page) {
+    page->rec_lsn_ = log_manager_ == nullptr ? INVALID_LSN : log_manager_->GetNextLsn();
+}
+
+/**
+ * @brief 等待page_id上正在进行的换入、换出或写回完成，这期间页面不在page_table_中或者帧中的数据不完整
+ */
+void BufferPoolManager::WaitForPageIo(std::unique_lock<std::mutex> &lock, PageId page_id) {
+    io_cv_.wait(lock, [&] { return in_io_.count(page_id) == 0; });
+}
+
+/**
+ * @brief 等待fd的所有页面上正在进行的I/O完成
+ */
+void BufferPoolManager::WaitForFileIo(std::unique_lock<std::mutex> &lock, int fd) {
+    io_cv_.wait(lock, [&] {
+        return std::none_of(in_io_.begin(), in_io_.end(), [&](const PageId &page_id) { return page_id.fd == fd; });
+    });
+}
+
+/**
+ * @brief 写回frames中的页面，它们都在page_table_中且pin_count为0，写回后仍留在缓冲池中
+ * 页面先在latch_内移出replacer并登记到in_io_，其他线程fetch它们时等待，写回期间页面不会被修改或淘汰；
+ * 然后释放latch_等待日志落盘(WAL)并写盘，返回时重新持有latch_
+ */
+void BufferPoolManager::WritePages(std::unique_lock<std::mutex> &lock, const std::vector<frame_id_t> &frames) {
+    if (frames.empty()) {
+        return;
+    }
+    for (frame_id_t id : frames) {
+        replacer_->Pin(id);
+        in_io_.insert(pages_[id].GetPageId());
+    }
+    lock.unlock();
+    size_t num_written = 0;
+    auto finish = [&] {
+        for (size_t i = 0; i < frames.size(); i++) {
+            Page *page = &pages_[frames[i]];
+            if (i < num_written) {
+                page->is_dirty_ = false;
+                ResetRecLsn(page);
+            }
+            replacer_->Unpin(frames[i]);
+            in_io_.erase(page->GetPageId());
+        }
+        io_cv_.notify_all();
+    };
+    try {
+        for (; num_written < frames.size(); num_written++) {
+            Page *page = &pages_[frames[num_written]];
+            FlushLogForPage(page);
+            disk_manager_->write_page(page->GetPageId().fd, page->GetPageId().page_no, page->GetData(), PAGE_SIZE);
+        }
+    } catch (...) {
+        lock.lock();
+        finish();
+        throw;
+    }
+    lock.lock();
+    finish();
+}
+
 /**
  * @brief 更新页面数据, 为脏页则需写入磁盘，更新page元数据(data, is_dirty, page_id)和page table
+ * 调用时持有latch_，返回时帧的pin_count为1。帧先在latch_内被占住(pin_count为1并移出replacer)，新旧page_id登记到
+ * in_io_，然后释放latch_等待日志落盘、写回旧页面并读入新页面，其他线程访问这两个页面时在io_cv_上等待；
+ * 写回完成之前帧仍以旧page_id出现在脏页表中
  *
+ * @param lock 持有latch_的锁，I/O期间释放
  * @param page 写回页指针
- * @param new_page_id 写回页新page_id
+ * @param new_page_id 写回页新page_id，page_no为INVALID_PAGE_ID时只写回旧页面
  * @param new_frame_id 写回页新帧frame_id
  */
-void BufferPoolManager::UpdatePage(Page *page, PageId new_page_id, frame_id_t new_frame_id) {
+void BufferPoolManager::UpdatePage(std::unique_lock<std::mutex> &lock, Page *page, PageId new_page_id,
+                                   frame_id_t new_frame_id) {
     // Todo:
     // 1 如果是脏页，写回磁盘，并且把dirty置为false
     // 2 更新page table
     // 3 重置page的data，更新page id
 
-    if(page->IsDirty()) {  //脏位处理
-        this->disk_manager_->write_page(page->GetPageId().fd, page->GetPageId().page_no, page->GetData(), PAGE_SIZE);
-        page->is_dirty_ = false;
+    PageId old_page_id = page->id_;
+    bool old_valid = old_page_id.page_no != INVALID_PAGE_ID;
+    bool new_valid = new_page_id.page_no != INVALID_PAGE_ID;
+    bool dirty = page->IsDirty();
+    page->pin_count_ = 1;
+    this->replacer_->Pin(new_frame_id);
+    if (old_valid) {  //更新table
+        this->page_table_.erase(old_page_id);
+        this->in_io_.insert(old_page_id);
     }
+    if (new_valid) {
+        this->page_table_[new_page_id] = new_frame_id;
+        this->in_io_.insert(new_page_id);
+    }
+    lock.unlock();
 
-    page->ResetMemory();
-
-    for(auto position = this->page_table_.begin(); position != this->page_table_.end(); position++) {  //更新table
-        if(position->first == page->id_) {
-            this->page_table_.erase(position);
-            break;
+    bool reset = false;
+    try {
+        if (dirty) {  //脏位处理
+            this->FlushLogForPage(page);
+            auto start = std::chrono::steady_clock::now();
+            this->disk_manager_->write_page(old_page_id.fd, old_page_id.page_no, page->GetData(), PAGE_SIZE);
+            MetricsRegistry::add(Metric::BUFFER_POOL_DIRTY_WRITEBACKS);
+            MetricsRegistry::add(Metric::BUFFER_POOL_WRITEBACK_STALL_NS, nanos_since(start));
+        }
+        page->ResetMemory();
+        reset = true;
+        if (new_valid) {
+            auto start = std::chrono::steady_clock::now();
+            this->disk_manager_->read_page(new_page_id.fd, new_page_id.page_no, page->GetData(), PAGE_SIZE);
+            MetricsRegistry::add(Metric::BUFFER_POOL_READ_STALL_NS, nanos_since(start));
+        }
+    } catch (...) {
+        // 写回失败时帧中仍是完整的旧页面，放回page table；否则帧已经被清空，归还free_list_
+        lock.lock();
+        this->page_table_.erase(new_page_id);
+        this->in_io_.erase(old_page_id);
+        this->in_io_.erase(new_page_id);
+        page->pin_count_ = 0;
+        if (old_valid && !reset) {
+            this->page_table_[old_page_id] = new_frame_id;
+            this->replacer_->Unpin(new_frame_id);
+        } else {
+            page->is_dirty_ = false;
+            page->id_.page_no = INVALID_PAGE_ID;
+            this->free_list_.push_back(new_frame_id);
         }
+        this->io_cv_.notify_all();
+        throw;
     }
-    this->page_table_[new_page_id] = new_frame_id;
 
+    lock.lock();
+    page->is_dirty_ = false;
     page->id_ = new_page_id;
-    if(page->id_.page_no != INVALID_PAGE_ID) {
-        this->disk_manager_->read_page(page->GetPageId().fd, page->GetPageId().page_no, page->GetData(), PAGE_SIZE);
-    }
+    this->ResetRecLsn(page);
+    this->in_io_.erase(old_page_id);
+    this->in_io_.erase(new_page_id);
+    this->io_cv_.notify_all();
 }
 
 /**
  * Fetch the requested page from the buffer pool.
  * 如果页表中存在page_id（说明该page在缓冲池中），并且pin_count++。
  * 如果页表不存在page_id（说明该page在磁盘中），则找缓冲池victim page，将其替换为磁盘中读取的page，pin_count置1。
+ * 页面正在被换入换出或写回时先等待I/O完成
  * @param page_id id of page to be fetched
  * @return the requested page
  */
@@ -76,27 +232,27 @@ Page *BufferPoolManager::FetchPage(PageId page_id) {
     // 2.     If R is dirty, write it back to the disk.
     // 3.     Delete R from the page table and insert P.
     // 4.     Update P's metadata, read in the page content from disk, and then return a pointer to P.
-    std::scoped_lock lock{latch_};
-    frame_id_t id;
-    int flag=0;
-    if(this->page_table_.find(page_id) != this->page_table_.end()) { //是否在缓冲池
-        id = this->page_table_[page_id];
-        flag=1;
+    std::unique_lock lock{latch_, std::try_to_lock};
+    if (!lock.owns_lock()) {  // 只在竞争时计数，不竞争时没有额外开销
+        MetricsRegistry::add(Metric::BUFFER_POOL_LATCH_WAITS);
+        lock.lock();
     }
-    else {
-        if(!this->FindVictimPage(&id)) {  //找空闲帧或替换
-            return nullptr;
-        }
-        this->UpdatePage(&this->pages_[id], page_id, id);
-    }
-
-    this->replacer_->Pin(id);
-    if (flag==1){
+    this->WaitForPageIo(lock, page_id);
+    frame_id_t id;
+    auto position = this->page_table_.find(page_id);
+    if(position != this->page_table_.end()) { //是否在缓冲池
+        id = position->second;
+        this->replacer_->Pin(id);
         this->pages_[id].pin_count_++;
+        MetricsRegistry::add(Metric::BUFFER_POOL_HITS);
+        return &this->pages_[id];
     }
-    else{
-        this->pages_[id].pin_count_=1;
+    if(!this->FindVictimPage(&id)) {  //找空闲帧或替换
+        MetricsRegistry::add(Metric::BUFFER_POOL_FETCH_FAILURES);  // 所有帧都被pin住
+        return nullptr;
     }
+    this->UpdatePage(lock, &this->pages_[id], page_id, id);  // 返回时pin_count为1
+    MetricsRegistry::add(Metric::BUFFER_POOL_MISSES);
 
     return &this->pages_[id]; //返回时自动解锁
 }
@@ -137,9 +293,11 @@ bool BufferPoolManager::UnpinPage(PageId page_id, bool is_dirty) {
 }
 
 /**
- * Flushes the target page to disk. 将page写入磁盘；不考虑pin_count
+ * Flushes the target page to disk. 将page写入磁盘
+ * 页面没有latch，被pin住的页面可能正在被修改(page_lsn已经设置而数据还没改完)，写回这样的页面会让redo跳过
+ * 没有写进磁盘的修改，因此只写回pin_count为0的页面；写回期间页面登记在in_io_中，没有人能pin它
  * @param page_id id of page to be flushed, cannot be INVALID_PAGE_ID
- * @return false if the page could not be found in the page table, true otherwise
+ * @return false if the page could not be found in the page table or is pinned, true otherwise
  */
 bool BufferPoolManager::FlushPage(PageId page_id) {
     // Todo:
@@ -148,16 +306,19 @@ bool BufferPoolManager::FlushPage(PageId page_id) {
     // 2. 存在时如何写回磁盘
     // 3. 写回后页面的脏位
     // Make sure you call DiskManager::WritePage!
-    std::scoped_lock lock{latch_};
+    std::unique_lock lock{latch_};
+    this->WaitForPageIo(lock, page_id);
 
     if(this->page_table_.find(page_id) == this->page_table_.end()) {
         return false;
     }
     frame_id_t id = this->page_table_[page_id]; //获取id
     Page* page = &this->pages_[id]; //通过id获取page
+    if (page->pin_count_ > 0) {
+        return false;  // 仍在脏页表中，由之后的检查点或淘汰写回
+    }
 
-    this->disk_manager_->write_page(page->GetPageId().fd, page->GetPageId().page_no, page->GetData(), PAGE_SIZE);
-    page->is_dirty_ = false;
+    this->WritePages(lock, {id});
     return true;
 }
 
@@ -174,21 +335,35 @@ Page *BufferPoolManager::NewPage(PageId *page_id) {
     // 3.   Pick a victim page P from either the free list or the replacer. Always pick from the free list first.
     // 4.   Update P's metadata, zero out memory and add P to the page table. pin_count set to 1.
     // 5.   Set the page ID output parameter. Return a pointer to P.
-    std::scoped_lock lock{latch_};
+    std::unique_lock lock{latch_};
 
     frame_id_t id;
     if(this->FindVictimPage(&id)) {  //找到一个位置
         page_id->page_no = this->disk_manager_->AllocatePage(page_id->fd); //获取编号
-        this->UpdatePage(&this->pages_[id], *page_id, id);  //更新page
-        this->replacer_->Pin(id);
-        this->pages_[id].pin_count_ = 1;
-
+        this->UpdatePage(lock, &this->pages_[id], *page_id, id);  //更新page，返回时pin_count为1
     } else {
         return nullptr;
     }
     return &this->pages_[id];
 }
 
+/**
+ * @brief 为一个已经由DiskManager::AllocatePages()分配好页号的新页面分配缓冲池帧
+ * 用于批量追加页面：页号一次性分配，之后逐页调用本函数，语义与NewPage()相同(pin_count为1)
+ * @param page_id 已分配的页面id
+ * @return nullptr if no frame is available, otherwise pointer to the new page
+ */
+Page *BufferPoolManager::CreatePage(PageId page_id) {
+    std::unique_lock lock{latch_};
+
+    frame_id_t id;
+    if (!this->FindVictimPage(&id)) {
+        return nullptr;
+    }
+    this->UpdatePage(lock, &this->pages_[id], page_id, id);
+    return &this->pages_[id];
+}
+
 /**
  * @brief Deletes a page from the buffer pool.
  * @param page_id id of page to be deleted
@@ -203,7 +378,8 @@ bool BufferPoolManager::DeletePage(PageId page_id) {
     // 2.2  If P exists, but has a non-zero pin-count, return false. Someone is using the page.
     // 3.   Otherwise, P can be deleted. Remove P from the page table, reset its metadata and return it to the free
     // list.
-    std::scoped_lock lock{latch_};
+    std::unique_lock lock{latch_};
+    this->WaitForPageIo(lock, page_id);
 
     if(this->page_table_.find(page_id) == this->page_table_.end()) {
         return true;
@@ -215,24 +391,95 @@ bool BufferPoolManager::DeletePage(PageId page_id) {
     }
     this->disk_manager_->DeallocatePage(page->GetPageId().page_no);
     page_id.page_no = INVALID_PAGE_ID;
-    this->UpdatePage(page, page_id, id); //包含page table处理
+    this->UpdatePage(lock, page, page_id, id); //包含page table处理
+    page->pin_count_ = 0;
     this->free_list_.push_back(id);
     return true;
 }
 
 /**
  * @brief Flushes all the pages in the buffer pool to disk.
+ * 与FlushPage()一样跳过被pin住的页面
  *
  * @param fd 指定的diskfile open句柄
+ * @return 有页面因为被pin住而没有写回时返回false
  */
-void BufferPoolManager::FlushAllPages(int fd) {
+bool BufferPoolManager::FlushAllPages(int fd) {
     // example for disk write
-    std::scoped_lock lock{latch_};
+    std::unique_lock lock{latch_};
+    this->WaitForFileIo(lock, fd);
+    bool all_flushed = true;
+    std::vector<frame_id_t> frames;
     for (size_t i = 0; i < pool_size_; i++) {
         Page *page = &this->pages_[i];
         if (page->GetPageId().fd == fd && page->GetPageId().page_no != INVALID_PAGE_ID) {
-            disk_manager_->write_page(page->GetPageId().fd, page->GetPageId().page_no, page->GetData(), PAGE_SIZE);
-            page->is_dirty_ = false;
+            if (page->pin_count_ > 0) {
+                all_flushed = false;
+                continue;
+            }
+            frames.push_back(static_cast<frame_id_t>(i));
+        }
+    }
+    this->WritePages(lock, frames);
+    return all_flushed;
+}
+
+/**
+ * @brief 把fd的所有页面写回磁盘并移出缓冲池，用于关闭文件：fd被新打开的文件复用时不会读到旧文件的页面
+ * 脏页在释放latch_后写回，写回期间其他线程可能又访问了这个文件，因此写回后重新检查，直到在latch_内看到
+ * 所有页面都是干净的才把它们移出缓冲池
+ *
+ * @param fd 指定的diskfile open句柄
+ * @return 有页面被pin住时返回false，此时没有页面被移出缓冲池
+ */
+bool BufferPoolManager::DeleteAllPages(int fd) {
+    std::unique_lock lock{latch_};
+    while (true) {
+        WaitForFileIo(lock, fd);
+        std::vector<frame_id_t> frames;
+        std::vector<frame_id_t> dirty_frames;
+        for (auto &[page_id, frame_id] : page_table_) {
+            if (page_id.fd != fd || page_id.page_no == INVALID_PAGE_ID) {
+                continue;
+            }
+            if (pages_[frame_id].pin_count_ > 0) {
+                return false;
+            }
+            frames.push_back(frame_id);
+            if (pages_[frame_id].IsDirty()) {
+                dirty_frames.push_back(frame_id);
+            }
+        }
+        if (!dirty_frames.empty()) {
+            WritePages(lock, dirty_frames);
+            continue;
+        }
+        for (frame_id_t frame_id : frames) {
+            Page *page = &pages_[frame_id];
+            page_table_.erase(page->GetPageId());
+            replacer_->Pin(frame_id);  // 从replacer中移除，之后只通过free_list_分配
+            page->ResetMemory();
+            page->id_.page_no = INVALID_PAGE_ID;
+            free_list_.push_back(frame_id);
+        }
+        return true;
+    }
+}
+
+/**
+ * @brief 获取脏页表，用于模糊检查点；只在复制期间持有latch_，不做任何I/O
+ * 被pin住的页面可能正在被修改、尚未通过UnpinPage()置脏，也算作脏页
+ *
+ * @return 每个脏页的(page_id, recLSN)
+ */
+std::vector<std::pair<PageId, lsn_t>> BufferPoolManager::GetDirtyPageTable() {
+    std::scoped_lock lock{latch_};
+    std::vector<std::pair<PageId, lsn_t>> dirty_pages;
+    for (size_t i = 0; i < pool_size_; i++) {
+        Page *page = &this->pages_[i];
+        if (page->GetPageId().page_no != INVALID_PAGE_ID && (page->IsDirty() || page->pin_count_ > 0)) {
+            dirty_pages.emplace_back(page->GetPageId(), page->rec_lsn_);
         }
     }
-}
\ No newline at end of file
+    return dirty_pages;
+}
@@ -1,14 +1,37 @@
 #include "storage/disk_manager.h"
 
+#include <algorithm>   // for min
 #include <assert.h>    // for assert
+#include <errno.h>     // for errno
+#include <fcntl.h>     // for fallocate
 #include <string.h>    // for memset
 #include <sys/stat.h>  // for stat
 #include <unistd.h>    // for lseek
 
 #include "defs.h"
+#include "storage/frame_arena.h"
+#include "storage/io_latency.h"
+#include "storage/metrics.h"
 
 DiskManager::DiskManager() { memset(fd2pageno_, 0, MAX_FD * (sizeof(std::atomic<page_id_t>) / sizeof(char))); }
 
+/**
+ * O_DIRECT要求缓冲区地址和长度按块对齐。缓冲池的帧(FrameArena)总是对齐的，
+ * 不对齐的只有直接读写文件头等结构体的调用，这些调用经过本线程的对齐缓冲区读写整页
+ */
+alignas(FrameArena::DIRECT_IO_ALIGNMENT) static thread_local char direct_io_buf[PAGE_SIZE];
+
+static bool need_bounce(int file_flags, const void *buf, int num_bytes) {
+    return (file_flags & O_DIRECT) != 0 &&
+           (!FrameArena::is_aligned(buf) || num_bytes % FrameArena::DIRECT_IO_ALIGNMENT != 0);
+}
+
+/**
+ * @brief 打开文件时是否使用O_DIRECT，绕过操作系统的页缓存，由缓冲池独自缓存数据页
+ * 只影响之后打开的文件；日志文件按任意长度追加写，总是使用页缓存
+ */
+void DiskManager::set_direct_io(bool direct_io) { direct_io_ = direct_io; }
+
 /**
  * @brief Write the contents of the specified page into disk file
  *
@@ -19,17 +42,36 @@ void DiskManager::write_page(int fd, page_id_t page_no, const char *offset, int
     // 2.调用write()函数
     // 注意处理异常
 
-    int flags = fcntl(fd, F_GETFD);  //fd是否可用
+    int flags = fcntl(fd, F_GETFL);  //fd是否可用，同时取得是否为O_DIRECT
     if (flags == -1) {
         throw UnixError();
     }
 
-    if(lseek(fd, page_no * PAGE_SIZE, SEEK_SET) == -1) {  //定位读写指针
-        throw UnixError();
-    }
-    if(write(fd, offset, num_bytes) != num_bytes) { //写文件
-        throw UnixError();
+    IoLatencyTimer timer(fd, IoOp::WRITE_PAGE, page_no);
+    if (need_bounce(flags, offset, num_bytes)) {
+        assert(num_bytes <= PAGE_SIZE);
+        off_t file_offset = static_cast<off_t>(page_no) * PAGE_SIZE;
+        if (num_bytes < PAGE_SIZE) {  // 只写页面的前num_bytes字节：读出整页(文件末尾之后补0)，覆盖后整页写回
+            ssize_t bytes_read = pread(fd, direct_io_buf, PAGE_SIZE, file_offset);
+            if (bytes_read == -1) {
+                throw UnixError();
+            }
+            memset(direct_io_buf + bytes_read, 0, PAGE_SIZE - bytes_read);
+        }
+        memcpy(direct_io_buf, offset, num_bytes);
+        if (pwrite(fd, direct_io_buf, PAGE_SIZE, file_offset) != PAGE_SIZE) {
+            throw UnixError();
+        }
+    } else {
+        if(lseek(fd, page_no * PAGE_SIZE, SEEK_SET) == -1) {  //定位读写指针
+            throw UnixError();
+        }
+        if(write(fd, offset, num_bytes) != num_bytes) { //写文件
+            throw UnixError();
+        }
     }
+    MetricsRegistry::add(Metric::DISK_WRITES);
+    MetricsRegistry::add(Metric::DISK_WRITE_BYTES, num_bytes);
 
 }
 
@@ -42,17 +84,32 @@ void DiskManager::read_page(int fd, page_id_t page_no, char *offset, int num_byt
     // 2.调用read()函数
     // 注意处理异常
 
-    int flags = fcntl(fd, F_GETFD);  //fd是否可用
+    int flags = fcntl(fd, F_GETFL);  //fd是否可用，同时取得是否为O_DIRECT
     if (flags == -1) {
         throw UnixError();
     }
 
-    if(lseek(fd, page_no * PAGE_SIZE, SEEK_SET) == -1) {  //定位读写指针
-        throw UnixError();
-    }
-    if(read(fd, offset, num_bytes) == -1) { //读文件
-        throw UnixError();
+    IoLatencyTimer timer(fd, IoOp::READ_PAGE, page_no);
+    ssize_t bytes_read;
+    if (need_bounce(flags, offset, num_bytes)) {
+        assert(num_bytes <= PAGE_SIZE);
+        bytes_read = pread(fd, direct_io_buf, PAGE_SIZE, static_cast<off_t>(page_no) * PAGE_SIZE);
+        if (bytes_read == -1) {
+            throw UnixError();
+        }
+        bytes_read = std::min<ssize_t>(bytes_read, num_bytes);
+        memcpy(offset, direct_io_buf, bytes_read);
+    } else {
+        if(lseek(fd, page_no * PAGE_SIZE, SEEK_SET) == -1) {  //定位读写指针
+            throw UnixError();
+        }
+        bytes_read = read(fd, offset, num_bytes);
+        if(bytes_read == -1) { //读文件
+            throw UnixError();
+        }
     }
+    MetricsRegistry::add(Metric::DISK_READS);
+    MetricsRegistry::add(Metric::DISK_READ_BYTES, bytes_read);
 
 }
 
@@ -68,6 +125,14 @@ page_id_t DiskManager::AllocatePage(int fd) {
     return pidt;
 }
 
+/**
+ * @brief 为批量追加一次性分配连续的num_pages个页面
+ * @return 第一个页面的编号，分配到的页面为[返回值, 返回值 + num_pages)
+ */
+page_id_t DiskManager::AllocatePages(int fd, int num_pages) {
+    return fd2pageno_[fd].fetch_add(num_pages);
+}
+
 /**
  * @brief Deallocate page (operations like drop index/table)
  * Need bitmap in header page for tracking pages
@@ -139,7 +204,7 @@ void DiskManager::destroy_file(const std::string &path) {
     if(unlink(path.c_str()) < 0) {
         throw UnixError();
     }
-    
+    IoLatency::forget(path);
 }
 
 /**
@@ -155,12 +220,19 @@ int DiskManager::open_file(const std::string &path) {
     if(!this->is_file(path)) { // path是否正确
         throw FileNotFoundError(path);
     }
-    int fd = open(path.c_str(), O_RDWR);
+    int fd = -1;
+    if (direct_io_ && path != LOG_FILE_NAME) {
+        fd = open(path.c_str(), O_RDWR | O_DIRECT);  // 文件系统不支持O_DIRECT(如tmpfs)时退回页缓存
+    }
+    if(fd < 0) {
+        fd = open(path.c_str(), O_RDWR);
+    }
     if(fd < 0) {
         throw UnixError();
     }
     this->path2fd_[path] = fd;  //更新映射
     this->fd2path_[fd] = path;
+    IoLatency::attach(fd, path);
     return fd;
 }
 
@@ -176,6 +248,7 @@ void DiskManager::close_file(int fd) {
         throw FileNotOpenError(fd);
         return;
     }
+    IoLatency::detach(fd);  // 先解除登记，close之后fd可能立即被复用
     if(close(fd) == -1) {
         throw UnixError();
         return;
@@ -192,7 +265,7 @@ void DiskManager::close_file(int fd) {
     
 }
 
-int DiskManager::GetFileSize(const std::string &file_name) {
+off_t DiskManager::GetFileSize(const std::string &file_name) {
     struct stat stat_buf;
     int rc = stat(file_name.c_str(), &stat_buf);
     return rc == 0 ? stat_buf.st_size : -1;
@@ -212,18 +285,18 @@ int DiskManager::GetFileFd(const std::string &file_name) {
     return path2fd_[file_name];
 }
 
-bool DiskManager::ReadLog(char *log_data, int size, int offset, int prev_log_end) {
+bool DiskManager::ReadLog(char *log_data, int size, off_t offset, off_t prev_log_end) {
     // read log file from the previous end
     if (log_fd_ == -1) {
         log_fd_ = open_file(LOG_FILE_NAME);
     }
     offset += prev_log_end;
-    int file_size = GetFileSize(LOG_FILE_NAME);
+    off_t file_size = GetFileSize(LOG_FILE_NAME);
     if (offset >= file_size) {
         return false;
     }
 
-    size = std::min(size, file_size - offset);
+    size = static_cast<int>(std::min<off_t>(size, file_size - offset));
     lseek(log_fd_, offset, SEEK_SET);
     ssize_t bytes_read = read(log_fd_, log_data, size);
     if (bytes_read != size) {
@@ -238,9 +311,41 @@ void DiskManager::WriteLog(char *log_data, int size) {
     }
 
     // write from the file_end
+    IoLatencyTimer timer(log_fd_, IoOp::WRITE_LOG);
     lseek(log_fd_, 0, SEEK_END);
     ssize_t bytes_write = write(log_fd_, log_data, size);
     if (bytes_write != size) {
         throw UnixError();
     }
+    MetricsRegistry::add(Metric::LOG_WRITES);
+    MetricsRegistry::add(Metric::LOG_WRITE_BYTES, size);
+}
+
+/**
+ * @brief 把日志文件中已写入的内容持久化到磁盘，由LogManager的flush线程在WriteLog()之后调用
+ */
+void DiskManager::SyncLog() {
+    if (log_fd_ == -1) {
+        return;
+    }
+    IoLatencyTimer timer(log_fd_, IoOp::SYNC_LOG);
+    if (fdatasync(log_fd_) != 0) {
+        throw UnixError();
+    }
+    MetricsRegistry::add(Metric::LOG_SYNCS);
+}
+
+/**
+ * @brief 释放日志文件[0, offset)所占的磁盘空间，文件长度和其余内容的偏移不变
+ * 文件系统不支持打洞时什么也不做，只是不能回收空间
+ */
+void DiskManager::DiscardLog(off_t offset) {
+    if (log_fd_ == -1) {
+        log_fd_ = open_file(LOG_FILE_NAME);
+    }
+    offset -= offset % PAGE_SIZE;
+    if (offset > 0 && fallocate(log_fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, offset) != 0 &&
+        errno != EOPNOTSUPP) {
+        throw UnixError();
+    }
 }
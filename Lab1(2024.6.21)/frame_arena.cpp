@@ -0,0 +1,78 @@
+#include "frame_arena.h"
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+#include "errors.h"
+#include "storage/metrics.h"
+
+FrameArena::FrameArena(size_t num_frames, int numa_node) {
+    // 大页映射的长度必须是大页大小的整数倍。不能加MAP_NORESERVE：预留的大页不足时应当在这里失败并退回普通页，
+    // 而不是等到第一次访问时收到SIGBUS
+    size_ = (num_frames * PAGE_SIZE + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    void *addr = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (addr != MAP_FAILED) {
+        huge_page_mode_ = HUGE_PAGE_HUGETLB;
+    } else {
+        addr = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (addr == MAP_FAILED) {
+            throw UnixError();
+        }
+        // 内核未开启透明大页时失败，不影响使用
+        huge_page_mode_ = madvise(addr, size_, MADV_HUGEPAGE) == 0 ? HUGE_PAGE_TRANSPARENT : HUGE_PAGE_NONE;
+    }
+    base_ = static_cast<char *>(addr);
+    apply_numa_policy(numa_node);
+    int64_t mode = huge_page_mode_;
+    gauge_id_ = MetricsRegistry::register_gauge("buffer_pool_huge_pages", [mode] { return mode; });
+}
+
+FrameArena::~FrameArena() {
+    MetricsRegistry::unregister_gauge(gauge_id_);
+    munmap(base_, size_);
+}
+
+/** 在线的NUMA结点，/sys/devices/system/node/online的格式如"0-1"或"0,2-3"；每一位对应一个结点 */
+static unsigned long online_numa_nodes() {
+    std::ifstream ifs("/sys/devices/system/node/online");
+    std::string list;
+    if (!(ifs >> list)) {
+        return 1;
+    }
+    unsigned long mask = 0;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        std::string range = list.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int node = first; node <= last && node < static_cast<int>(sizeof(mask) * 8); node++) {
+            mask |= 1UL << node;
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+        pos = end + 1;
+    }
+    return mask == 0 ? 1 : mask;
+}
+
+void FrameArena::apply_numa_policy(int numa_node) {
+    unsigned long nodes = online_numa_nodes();
+    if (__builtin_popcountl(nodes) <= 1) {
+        return;
+    }
+    int mode = MPOL_INTERLEAVE;
+    if (numa_node != INTERLEAVE_NODES && numa_node < static_cast<int>(sizeof(nodes) * 8) && (nodes >> numa_node & 1)) {
+        nodes = 1UL << numa_node;
+        mode = MPOL_PREFERRED;  // 该结点内存不足时仍可以从其他结点分配
+    }
+    // glibc没有mbind的包装(在libnuma中)，直接使用系统调用；失败时保持默认的first-touch策略
+    syscall(SYS_mbind, base_, size_, mode, &nodes, sizeof(nodes) * 8 + 1, 0);
+}
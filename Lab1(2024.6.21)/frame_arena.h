@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+
+#include "common/config.h"
+
+/**
+ * @brief 缓冲池所有帧的内存，一整块按页对齐的匿名映射
+ * O_DIRECT要求用户缓冲区、文件偏移和长度都按逻辑块大小(DIRECT_IO_ALIGNMENT)对齐，
+ * 帧按PAGE_SIZE依次排列，每一帧都满足对齐要求，可以直接作为O_DIRECT读写的缓冲区。
+ * 匿名映射在第一次访问时才分配物理内存，缓冲池配置得很大时RSS随实际使用的帧增长。
+ *
+ * 为减少TLB缺失，优先从预留的2MB大页(MAP_HUGETLB)分配；没有预留大页时退回普通页，
+ * 并通过MADV_HUGEPAGE请求透明大页。多NUMA结点的机器上，映射在第一次访问之前设置内存策略：
+ * 默认在所有结点间交错分配，避免全部帧落在初始化线程所在的结点上；指定结点时优先在该结点上分配
+ */
+class FrameArena {
+   public:
+    static constexpr size_t DIRECT_IO_ALIGNMENT = 4096;
+    static_assert(PAGE_SIZE % DIRECT_IO_ALIGNMENT == 0, "frames must stay aligned for O_DIRECT");
+
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+    static constexpr int INTERLEAVE_NODES = -1;
+
+    enum HugePageMode { HUGE_PAGE_NONE = 0, HUGE_PAGE_TRANSPARENT = 1, HUGE_PAGE_HUGETLB = 2 };
+
+    /**
+     * @param numa_node 帧优先分配在哪个NUMA结点上，INTERLEAVE_NODES表示在所有结点间交错
+     */
+    explicit FrameArena(size_t num_frames, int numa_node = INTERLEAVE_NODES);
+
+    ~FrameArena();
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    char *frame(size_t frame_id) const { return base_ + frame_id * PAGE_SIZE; }
+
+    HugePageMode huge_page_mode() const { return huge_page_mode_; }
+
+    static bool is_aligned(const void *ptr) { return reinterpret_cast<size_t>(ptr) % DIRECT_IO_ALIGNMENT == 0; }
+
+   private:
+    /** 设置[base_, base_ + size_)的NUMA内存策略，单结点机器或不支持时什么也不做 */
+    void apply_numa_policy(int numa_node);
+
+    char *base_;
+    size_t size_;
+    HugePageMode huge_page_mode_ = HUGE_PAGE_NONE;
+    int gauge_id_;
+};
@@ -0,0 +1,211 @@
+#include "io_latency.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "storage/metrics.h"
+
+uint64_t LatencyHistogram::percentile(double quantile) const {
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t target = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(total * quantile)), 1);
+    uint64_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            return std::min(bucket_upper_bound(i), max());
+        }
+    }
+    return max();
+}
+
+/** 一个文件各操作的直方图，按需分配，文件删除前不释放 */
+struct FileIoLatency {
+    std::string path;
+    std::atomic<LatencyHistogram *> ops[static_cast<int>(IoOp::NUM_IO_OPS)] = {};
+
+    ~FileIoLatency() {
+        for (auto &op : ops) {
+            delete op.load(std::memory_order_relaxed);
+        }
+    }
+
+    LatencyHistogram &get(IoOp op) {
+        auto &slot = ops[static_cast<int>(op)];
+        LatencyHistogram *hist = slot.load(std::memory_order_acquire);
+        if (hist != nullptr) {
+            return *hist;
+        }
+        auto *created = new LatencyHistogram;
+        if (slot.compare_exchange_strong(hist, created, std::memory_order_acq_rel)) {
+            return *created;
+        }
+        delete created;  // 其他线程先分配了
+        return *hist;
+    }
+};
+
+struct IoLatencyState {
+    std::mutex latch_;  // 保护files_
+    std::map<std::string, std::unique_ptr<FileIoLatency>> files_;
+    std::atomic<FileIoLatency *> by_fd_[DiskManager::MAX_FD] = {};
+    std::atomic<uint64_t> slow_threshold_ns_{IoLatency::DEFAULT_SLOW_IO_THRESHOLD_US * 1000};
+
+    std::mutex slow_latch_;  // 保护以下慢I/O队列
+    std::condition_variable slow_cv_;
+    std::vector<std::string> slow_lines_;
+    uint64_t slow_dropped_ = 0;
+    bool slow_writer_started_ = false;
+};
+
+static IoLatencyState &state() {
+    static auto *state = new IoLatencyState;
+    return *state;
+}
+
+/** 后台线程：把队列中的慢I/O记录批量追加到日志文件中 */
+static void slow_io_writer() {
+    auto &st = state();
+    std::vector<std::string> lines;
+    while (true) {
+        uint64_t dropped;
+        {
+            std::unique_lock<std::mutex> lock(st.slow_latch_);
+            st.slow_cv_.wait(lock, [&] { return !st.slow_lines_.empty() || st.slow_dropped_ != 0; });
+            lines.swap(st.slow_lines_);
+            dropped = st.slow_dropped_;
+            st.slow_dropped_ = 0;
+        }
+        FILE *log = fopen(IoLatency::SLOW_IO_LOG_NAME, "a");
+        if (log != nullptr) {  // 慢I/O日志只用于诊断，写不了就丢弃
+            for (auto &line : lines) {
+                fputs(line.c_str(), log);
+            }
+            if (dropped != 0) {
+                fprintf(log, "# %" PRIu64 " slow I/O records dropped\n", dropped);
+            }
+            fclose(log);
+        }
+        lines.clear();
+    }
+}
+
+static const LatencyMetric GLOBAL_METRICS[] = {LatencyMetric::DISK_READ, LatencyMetric::DISK_WRITE,
+                                               LatencyMetric::LOG_WRITE, LatencyMetric::LOG_SYNC};
+
+const char *IoLatency::op_name(IoOp op) {
+    static const char *names[] = {"read_page", "write_page", "write_log", "sync_log"};
+    return names[static_cast<int>(op)];
+}
+
+void IoLatency::attach(int fd, const std::string &path) {
+    if (fd < 0 || fd >= DiskManager::MAX_FD) {
+        return;
+    }
+    auto &st = state();
+    std::scoped_lock lock{st.latch_};
+    auto &file = st.files_[path];
+    if (file == nullptr) {
+        file = std::make_unique<FileIoLatency>();
+        file->path = path;
+    }
+    st.by_fd_[fd].store(file.get(), std::memory_order_release);
+}
+
+void IoLatency::detach(int fd) {
+    if (fd >= 0 && fd < DiskManager::MAX_FD) {
+        state().by_fd_[fd].store(nullptr, std::memory_order_release);
+    }
+}
+
+void IoLatency::forget(const std::string &path) {
+    auto &st = state();
+    std::scoped_lock lock{st.latch_};
+    auto iter = st.files_.find(path);
+    if (iter == st.files_.end()) {
+        return;
+    }
+    for (auto &file : st.by_fd_) {
+        if (file.load(std::memory_order_acquire) == iter->second.get()) {
+            return;  // 仍然打开着，不能释放
+        }
+    }
+    st.files_.erase(iter);
+}
+
+void IoLatency::set_slow_threshold_us(uint64_t micros) {
+    state().slow_threshold_ns_.store(micros * 1000, std::memory_order_relaxed);
+}
+
+void IoLatency::record(int fd, IoOp op, page_id_t page_no, uint64_t nanos) {
+    auto &st = state();
+    MetricsRegistry::record_latency(GLOBAL_METRICS[static_cast<int>(op)], nanos / 1000);
+    FileIoLatency *file = nullptr;
+    if (fd >= 0 && fd < DiskManager::MAX_FD) {
+        file = st.by_fd_[fd].load(std::memory_order_acquire);
+        if (file != nullptr) {
+            file->get(op).record(nanos);
+        }
+    }
+    uint64_t threshold = st.slow_threshold_ns_.load(std::memory_order_relaxed);
+    if (threshold == 0 || nanos < threshold) {
+        return;
+    }
+    char line[512];
+    snprintf(line, sizeof(line), "%s %s fd=%d page=%d latency_us=%" PRIu64 "\n",
+             file == nullptr ? "?" : file->path.c_str(), op_name(op), fd, page_no, nanos / 1000);
+    std::scoped_lock lock{st.slow_latch_};
+    if (!st.slow_writer_started_) {
+        std::thread(slow_io_writer).detach();
+        st.slow_writer_started_ = true;
+    }
+    if (st.slow_lines_.size() >= MAX_PENDING_SLOW_IO) {
+        st.slow_dropped_++;
+    } else {
+        st.slow_lines_.emplace_back(line);
+    }
+    st.slow_cv_.notify_one();
+}
+
+std::vector<IoLatency::Summary> IoLatency::summaries() {
+    auto &st = state();
+    std::scoped_lock lock{st.latch_};
+    std::vector<Summary> result;
+    for (auto &[path, file] : st.files_) {
+        for (int i = 0; i < static_cast<int>(IoOp::NUM_IO_OPS); i++) {
+            LatencyHistogram *ophist = file->ops[i].load(std::memory_order_acquire);
+            if (ophist == nullptr || ophist->count() == 0) {
+                continue;
+            }
+            auto &hist = *ophist;
+            result.push_back({path, static_cast<IoOp>(i), hist.count(), hist.percentile(0.5) / 1000,
+                              hist.percentile(0.99) / 1000, hist.percentile(0.999) / 1000, hist.max() / 1000});
+        }
+    }
+    return result;
+}
+
+void IoLatency::dump(const std::string &path) {
+    std::string tmp_path = path + ".tmp";
+    FILE *out = fopen(tmp_path.c_str(), "w");
+    if (out == nullptr) {
+        throw UnixError();
+    }
+    fprintf(out, "# file op count p50_us p99_us p999_us max_us\n");
+    for (auto &s : summaries()) {
+        fprintf(out, "%s %s %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 "\n", s.file.c_str(),
+                op_name(s.op), s.count, s.p50_us, s.p99_us, s.p999_us, s.max_us);
+    }
+    if (fclose(out) != 0 || rename(tmp_path.c_str(), path.c_str()) < 0) {
+        throw UnixError();
+    }
+}
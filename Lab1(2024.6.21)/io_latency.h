@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "storage/disk_manager.h"
+
+/** DiskManager的I/O操作类型 */
+enum class IoOp { READ_PAGE, WRITE_PAGE, WRITE_LOG, SYNC_LOG, NUM_IO_OPS };
+
+/**
+ * @brief HDR风格的延迟直方图，单位纳秒
+ * 每个2的幂区间[2^m, 2^(m+1))再等分为SUB_BUCKETS个桶，相对误差不超过1/SUB_BUCKETS(约6%)，
+ * 小于SUB_BUCKETS的值各占一个桶。记录只有几次relaxed的原子加，不加锁
+ */
+class LatencyHistogram {
+   public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int MAX_MAGNITUDE = 36;  // 2^36纳秒约69秒，更大的值计入最后一个桶
+    static constexpr int NUM_BUCKETS = SUB_BUCKETS + (MAX_MAGNITUDE - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+    void record(uint64_t nanos) {
+        buckets_[bucket_index(nanos)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (nanos > max && !max_.compare_exchange_weak(max, nanos, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    /** 第quantile分位数所在桶的上界；与record()并发时结果是近似的 */
+    uint64_t percentile(double quantile) const;
+
+    static int bucket_index(uint64_t nanos) {
+        if (nanos < SUB_BUCKETS) {
+            return static_cast<int>(nanos);
+        }
+        int magnitude = 63 - __builtin_clzll(nanos);
+        if (magnitude >= MAX_MAGNITUDE) {
+            return NUM_BUCKETS - 1;
+        }
+        int sub = static_cast<int>(nanos >> (magnitude - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+        return SUB_BUCKETS + (magnitude - SUB_BUCKET_BITS) * SUB_BUCKETS + sub;
+    }
+
+    /** 桶内的最大值 */
+    static uint64_t bucket_upper_bound(int index) {
+        if (index < SUB_BUCKETS) {
+            return index;
+        }
+        int magnitude = (index - SUB_BUCKETS) / SUB_BUCKETS + SUB_BUCKET_BITS;
+        uint64_t sub = (index - SUB_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS;
+        return ((sub + 1) << (magnitude - SUB_BUCKET_BITS)) - 1;
+    }
+
+   private:
+    std::atomic<uint64_t> buckets_[NUM_BUCKETS] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+/**
+ * @brief 按文件、按操作类型统计DiskManager的I/O延迟
+ * 文件在open_file()时按路径登记，同一路径重新打开后继续累计，删除文件时丢弃；记录时通过fd直接找到文件的直方图，
+ * 不加锁，每种操作的直方图在第一次出现该操作时才分配。
+ * 超过阈值的慢I/O先放入内存队列，由后台线程追加到SLOW_IO_LOG_NAME中，每行一条，I/O路径上不打开文件；
+ * 所有延迟同时计入MetricsRegistry的全局直方图
+ */
+class IoLatency {
+   public:
+    static constexpr uint64_t DEFAULT_SLOW_IO_THRESHOLD_US = 50000;
+    static constexpr const char *SLOW_IO_LOG_NAME = "slow_io.log";
+    static constexpr size_t MAX_PENDING_SLOW_IO = 4096;  // 后台线程跟不上时，超出的慢I/O只计数
+
+    /** 文件打开后调用，此后该fd上的I/O计入path的直方图 */
+    static void attach(int fd, const std::string &path);
+
+    /** 文件关闭前调用 */
+    static void detach(int fd);
+
+    /** 文件删除后调用，丢弃path的直方图 */
+    static void forget(const std::string &path);
+
+    static void record(int fd, IoOp op, page_id_t page_no, uint64_t nanos);
+
+    /** 慢I/O的阈值，0表示不记录 */
+    static void set_slow_threshold_us(uint64_t micros);
+
+    struct Summary {
+        std::string file;
+        IoOp op;
+        uint64_t count;
+        uint64_t p50_us;
+        uint64_t p99_us;
+        uint64_t p999_us;
+        uint64_t max_us;
+    };
+
+    /** 每个有过I/O的(文件, 操作)一行，按文件名排序 */
+    static std::vector<Summary> summaries();
+
+    /** 把summaries()写入文件，每行"文件 操作 次数 p50 p99 p999 max"，单位微秒 */
+    static void dump(const std::string &path);
+
+    static const char *op_name(IoOp op);
+};
+
+/** 作用域内的耗时作为一次I/O记入IoLatency */
+class IoLatencyTimer {
+   public:
+    IoLatencyTimer(int fd, IoOp op, page_id_t page_no = INVALID_PAGE_ID)
+        : fd_(fd), op_(op), page_no_(page_no), start_(std::chrono::steady_clock::now()) {}
+
+    ~IoLatencyTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        IoLatency::record(fd_, op_, page_no_, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+   private:
+    int fd_;
+    IoOp op_;
+    page_id_t page_no_;
+    std::chrono::steady_clock::time_point start_;
+};
@@ -1,8 +1,13 @@
 #include "lru_replacer.h"
 
-LRUReplacer::LRUReplacer(size_t num_pages) { max_size_ = num_pages; }
+#include "storage/metrics.h"
 
-LRUReplacer::~LRUReplacer() = default;
+LRUReplacer::LRUReplacer(size_t num_pages) {
+    max_size_ = num_pages;
+    gauge_id_ = MetricsRegistry::register_gauge("replacer_size", [this] { return static_cast<int64_t>(Size()); });
+}
+
+LRUReplacer::~LRUReplacer() { MetricsRegistry::unregister_gauge(gauge_id_); }
 
 /**
  * @brief 使用LRU策略删除一个victim frame，这个函数能得到frame_id
@@ -0,0 +1,176 @@
+#include "metrics.h"
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#include "errors.h"
+
+static const char *METRIC_NAMES[MetricsRegistry::NUM_METRICS] = {
+    "buffer_pool_hits",
+    "buffer_pool_misses",
+    "buffer_pool_evictions",
+    "buffer_pool_dirty_writebacks",
+    "buffer_pool_latch_waits",
+    "buffer_pool_fetch_failures",
+    "disk_reads",
+    "disk_read_bytes",
+    "disk_writes",
+    "disk_write_bytes",
+    "log_writes",
+    "log_write_bytes",
+    "log_syncs",
+    "index_lookups",
+    "index_inserts",
+    "index_deletes",
+    "buffer_pool_read_stall_ns",
+    "buffer_pool_writeback_stall_ns",
+    "buffer_pool_wal_stall_ns",
+};
+
+static const char *LATENCY_NAMES[MetricsRegistry::NUM_LATENCY_METRICS] = {
+    "disk_read_latency",
+    "disk_write_latency",
+    "log_write_latency",
+    "log_sync_latency",
+};
+
+/**
+ * 所有线程的计数槽及已退出线程的累计值。只在线程创建/退出和读取时加锁；
+ * 有意不释放，保证进程退出时其他线程的thread_local析构仍能访问
+ */
+struct MetricsState {
+    std::mutex latch_;
+    std::vector<const void *> slabs_;
+    uint64_t retired_counters_[MetricsRegistry::NUM_METRICS] = {};
+    uint64_t retired_latencies_[MetricsRegistry::NUM_LATENCY_METRICS][MetricsRegistry::LATENCY_BUCKETS] = {};
+    std::map<int, std::pair<std::string, std::function<int64_t()>>> gauges_;
+    int next_gauge_id_ = 0;
+};
+
+static MetricsState &state() {
+    static auto *state = new MetricsState;
+    return *state;
+}
+
+MetricsRegistry::ThreadSlab::ThreadSlab() {
+    std::scoped_lock lock{state().latch_};
+    state().slabs_.push_back(this);
+}
+
+MetricsRegistry::ThreadSlab::~ThreadSlab() {
+    auto &st = state();
+    std::scoped_lock lock{st.latch_};
+    for (int i = 0; i < NUM_METRICS; i++) {
+        st.retired_counters_[i] += counters[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < NUM_LATENCY_METRICS; i++) {
+        for (int j = 0; j < LATENCY_BUCKETS; j++) {
+            st.retired_latencies_[i][j] += latencies[i][j].load(std::memory_order_relaxed);
+        }
+    }
+    st.slabs_.erase(std::find(st.slabs_.begin(), st.slabs_.end(), this));
+}
+
+uint64_t MetricsRegistry::get(Metric metric) {
+    int idx = static_cast<int>(metric);
+    auto &st = state();
+    std::scoped_lock lock{st.latch_};
+    uint64_t value = st.retired_counters_[idx];
+    for (auto slab : st.slabs_) {
+        value += static_cast<const ThreadSlab *>(slab)->counters[idx].load(std::memory_order_relaxed);
+    }
+    return value;
+}
+
+std::vector<uint64_t> MetricsRegistry::get_histogram(LatencyMetric metric) {
+    int idx = static_cast<int>(metric);
+    auto &st = state();
+    std::scoped_lock lock{st.latch_};
+    std::vector<uint64_t> buckets(st.retired_latencies_[idx], st.retired_latencies_[idx] + LATENCY_BUCKETS);
+    for (auto slab : st.slabs_) {
+        for (int j = 0; j < LATENCY_BUCKETS; j++) {
+            buckets[j] += static_cast<const ThreadSlab *>(slab)->latencies[idx][j].load(std::memory_order_relaxed);
+        }
+    }
+    return buckets;
+}
+
+int MetricsRegistry::register_gauge(const std::string &name, std::function<int64_t()> getter) {
+    auto &st = state();
+    std::scoped_lock lock{st.latch_};
+    int id = st.next_gauge_id_++;
+    st.gauges_.emplace(id, std::make_pair(name, std::move(getter)));
+    return id;
+}
+
+void MetricsRegistry::unregister_gauge(int id) {
+    auto &st = state();
+    std::scoped_lock lock{st.latch_};
+    st.gauges_.erase(id);
+}
+
+/** 直方图中第一个使累计次数达到总次数*quantile的桶的上界(微秒) */
+static uint64_t bucket_quantile(const std::vector<uint64_t> &buckets, uint64_t total, double quantile) {
+    uint64_t target = std::max<uint64_t>(static_cast<uint64_t>(total * quantile), 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            return i == 0 ? 0 : 1ULL << i;
+        }
+    }
+    return 0;
+}
+
+std::vector<std::pair<std::string, std::string>> MetricsRegistry::snapshot() {
+    std::vector<std::pair<std::string, std::string>> result;
+    for (int i = 0; i < NUM_METRICS; i++) {
+        result.emplace_back(METRIC_NAMES[i], std::to_string(get(static_cast<Metric>(i))));
+    }
+    std::map<std::string, int64_t> gauges;
+    {
+        // 回调在锁内调用，不能再访问注册表
+        auto &st = state();
+        std::scoped_lock lock{st.latch_};
+        for (auto &[id, gauge] : st.gauges_) {
+            gauges[gauge.first] += gauge.second();
+        }
+    }
+    for (auto &[name, value] : gauges) {
+        result.emplace_back(name, std::to_string(value));
+    }
+    for (int i = 0; i < NUM_LATENCY_METRICS; i++) {
+        auto buckets = get_histogram(static_cast<LatencyMetric>(i));
+        uint64_t total = 0;
+        for (auto count : buckets) {
+            total += count;
+        }
+        std::string name = LATENCY_NAMES[i];
+        result.emplace_back(name + "_count", std::to_string(total));
+        if (total == 0) {
+            continue;
+        }
+        result.emplace_back(name + "_p50_us", std::to_string(bucket_quantile(buckets, total, 0.5)));
+        result.emplace_back(name + "_p99_us", std::to_string(bucket_quantile(buckets, total, 0.99)));
+        result.emplace_back(name + "_max_us", std::to_string(bucket_quantile(buckets, total, 1.0)));
+    }
+    return result;
+}
+
+void MetricsRegistry::dump(const std::string &path) {
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream ofs(tmp_path, std::ios::trunc);
+        for (auto &[name, value] : snapshot()) {
+            ofs << name << ' ' << value << '\n';
+        }
+        if (!ofs.flush()) {
+            throw UnixError();
+        }
+    }
+    if (rename(tmp_path.c_str(), path.c_str()) < 0) {
+        throw UnixError();
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** 计数器：各线程分别累加，读取时汇总 */
+enum class Metric {
+    BUFFER_POOL_HITS,
+    BUFFER_POOL_MISSES,
+    BUFFER_POOL_EVICTIONS,
+    BUFFER_POOL_DIRTY_WRITEBACKS,
+    BUFFER_POOL_LATCH_WAITS,
+    BUFFER_POOL_FETCH_FAILURES,
+    DISK_READS,
+    DISK_READ_BYTES,
+    DISK_WRITES,
+    DISK_WRITE_BYTES,
+    LOG_WRITES,
+    LOG_WRITE_BYTES,
+    LOG_SYNCS,
+    INDEX_LOOKUPS,
+    INDEX_INSERTS,
+    INDEX_DELETES,
+    BUFFER_POOL_READ_STALL_NS,       // 缺页时等待读盘的时间
+    BUFFER_POOL_WRITEBACK_STALL_NS,  // 淘汰脏页时等待写盘的时间
+    BUFFER_POOL_WAL_STALL_NS,        // 写回脏页前等待日志落盘的时间
+    NUM_METRICS
+};
+
+/** 延迟直方图：按2的幂分桶，单位微秒 */
+enum class LatencyMetric { DISK_READ, DISK_WRITE, LOG_WRITE, LOG_SYNC, NUM_LATENCY_METRICS };
+
+/**
+ * @brief 全局指标注册表
+ * 热路径上的add()/record_latency()只写本线程的计数槽(relaxed load + store，没有原子读改写和共享缓存行)，
+ * 读取时遍历所有线程的计数槽求和；线程退出时把它的计数并入全局的累计值。
+ * 瞬时值(如replacer大小)不在热路径上维护，而是注册回调，读取时调用
+ */
+class MetricsRegistry {
+   public:
+    static constexpr int NUM_METRICS = static_cast<int>(Metric::NUM_METRICS);
+    static constexpr int NUM_LATENCY_METRICS = static_cast<int>(LatencyMetric::NUM_LATENCY_METRICS);
+    static constexpr int LATENCY_BUCKETS = 32;  // 第i个桶为[2^(i-1), 2^i)微秒，第0个桶为0微秒
+
+    static void add(Metric metric, uint64_t n = 1) {
+        auto &counter = local().counters[static_cast<int>(metric)];
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static void record_latency(LatencyMetric metric, uint64_t micros) {
+        int bucket = micros == 0 ? 0 : std::min(64 - __builtin_clzll(micros), LATENCY_BUCKETS - 1);
+        auto &counter = local().latencies[static_cast<int>(metric)][bucket];
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    /** 当前线程的计数，用于统计一段代码执行期间的增量(如EXPLAIN ANALYZE) */
+    static uint64_t thread_value(Metric metric) {
+        return local().counters[static_cast<int>(metric)].load(std::memory_order_relaxed);
+    }
+
+    /** 所有线程的计数之和 */
+    static uint64_t get(Metric metric);
+
+    static std::vector<uint64_t> get_histogram(LatencyMetric metric);
+
+    /**
+     * @brief 注册一个瞬时值，读取时调用getter；同名的瞬时值输出时相加
+     * @return 注销时使用的id
+     */
+    static int register_gauge(const std::string &name, std::function<int64_t()> getter);
+
+    static void unregister_gauge(int id);
+
+    /** 全部指标的(名称, 值)，用于SHOW STATUS；延迟直方图输出为次数和p50/p99/max的桶上界 */
+    static std::vector<std::pair<std::string, std::string>> snapshot();
+
+    /** 把snapshot()写入文件，每行一个"名称 值" */
+    static void dump(const std::string &path);
+
+   private:
+    struct ThreadSlab {
+        std::atomic<uint64_t> counters[NUM_METRICS] = {};
+        std::atomic<uint64_t> latencies[NUM_LATENCY_METRICS][LATENCY_BUCKETS] = {};
+
+        ThreadSlab();
+        ~ThreadSlab();
+    };
+
+    static ThreadSlab &local() {
+        thread_local ThreadSlab slab;
+        return slab;
+    }
+};
@@ -1,5 +1,110 @@
 #include "rm_file_handle.h"
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common/context.h"
+
+/** context中是否有需要写日志的事务 */
+static bool need_log(Context *context) {
+    return context != nullptr && context->log_mgr_ != nullptr && context->txn_ != nullptr;
+}
+
+/**
+ * WAL: 为context中的事务追加一条日志，并把它的LSN记到被修改的页面上，
+ * 缓冲池写回该页面之前会等待这条日志落盘；page为nullptr表示没有修改页面(删除标记)
+ */
+static void append_log(Context *context, LogRecord *log_record, Page *page) {
+    Transaction *txn = context->txn_;
+    log_record->prev_lsn_ = txn->GetPrevLsn();
+    lsn_t lsn = context->log_mgr_->add_log_to_buffer(log_record);
+    txn->SetPrevLsn(lsn);
+    if (page != nullptr && lsn > page->GetPageLsn()) {
+        page->SetPageLsn(lsn);
+    }
+}
+
+/**
+ * context中的事务是否需要并发控制；回滚中的事务已经持有所需的锁，GC等事务外的操作(INVALID_TXN_ID)不加锁
+ */
+static bool need_lock(Context *context) {
+    return context != nullptr && context->txn_ != nullptr &&
+           context->txn_->GetTransactionId() != INVALID_TXN_ID &&
+           context->txn_->GetState() != TransactionState::ABORTED;
+}
+
+/**
+ * 需要在versions_中登记修改的事务：不论隔离级别，所有事务的修改都登记为未提交的最新版本，
+ * 快照隔离事务据此看不到其他事务未提交的修改，并按first-updater-wins发现已提交的修改；
+ * 正在回滚(ABORTED)的事务和事务外的操作直接修改记录文件，版本信息由TransactionManager::Abort()自己恢复
+ */
+static Transaction *versioned_txn(Context *context) {
+    return need_lock(context) ? context->txn_ : nullptr;
+}
+
+/**
+ * 读记录前的并发控制：2PL事务加S锁(LockSharedOnRecord会先在表上加IS锁)；
+ * 乐观事务不加锁，在读取记录之前把它的TID记入读集，提交时由TransactionManager验证；快照读不需要加锁
+ */
+void RmFileHandle::lock_for_read(const Rid &rid, Context *context) const {
+    if (!need_lock(context)) {
+        return;
+    }
+    Transaction *txn = context->txn_;
+    if (txn->IsOptimistic()) {
+        txn->GetReadSet()->push_back({fd_, rid, tids_.read(rid, txn)});
+    } else if (context->lock_mgr_ != nullptr && txn->GetIsolationLevel() != IsolationLevel::SNAPSHOT_ISOLATION) {
+        context->lock_mgr_->LockSharedOnRecord(txn, rid, fd_);
+    }
+}
+
+/**
+ * 并行扫描(morsel)前的并发控制，由调用线程在worker开始之前调用：事务的锁集和读集不是线程安全的，
+ * worker读取记录时不能各自加行锁或记录读集，因此先对整个表加S锁，覆盖扫描读到的所有记录；
+ * 乐观事务在并行扫描中同样以表S锁代替读集，快照读不需要加锁
+ */
+void RmFileHandle::lock_for_scan(Context *context) const {
+    if (!need_lock(context) || context->lock_mgr_ == nullptr ||
+        context->txn_->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION) {
+        return;
+    }
+    context->lock_mgr_->LockSharedOnTable(context->txn_, fd_);
+}
+
+/**
+ * 修改记录前的并发控制：乐观事务与2PL事务一样对记录加X锁，写写冲突仍由锁管理器处理；
+ * 所有事务都在tids_中登记为writer，使乐观事务能发现未提交的修改
+ * @return 本次调用是否新登记了writer，修改失败时据此调用abandon_write()
+ */
+bool RmFileHandle::lock_for_write(const Rid &rid, Context *context) {
+    if (!need_lock(context)) {
+        return false;
+    }
+    Transaction *txn = context->txn_;
+    if (context->lock_mgr_ != nullptr && txn->GetIsolationLevel() != IsolationLevel::SNAPSHOT_ISOLATION) {
+        context->lock_mgr_->LockExclusiveOnRecord(txn, rid, fd_);
+    }
+    return tids_.lock(rid, txn);
+}
+
+/**
+ * 修改在写入页面之前失败时调用：撤销本次调用在tids_和versions_中的登记。
+ * 失败的修改不会进入撤销缓冲区，事务结束时不会清除这些登记，留下的writer会让之后所有的修改都写写冲突；
+ * 本事务之前对同一条记录的修改已经在撤销缓冲区中，它们的登记保留
+ */
+void RmFileHandle::abandon_write(const Rid &rid, Context *context, bool tid_locked, bool version_registered) {
+    if (!tid_locked && !version_registered) {
+        return;
+    }
+    txn_id_t txn_id = context->txn_->GetTransactionId();
+    if (version_registered) {
+        versions_.abort(rid, txn_id);
+    }
+    if (tid_locked) {
+        tids_.release(rid, txn_id);
+    }
+}
+
 /**
  * @brief 由Rid得到指向RmRecord的指针
  *
@@ -11,16 +116,59 @@ std::unique_ptr<RmRecord> RmFileHandle::get_record(const Rid &rid, Context *cont
     // 1. 获取指定记录所在的page handle
     // 2. 初始化一个指向RmRecord的指针（赋值其内部的data和size）
 
+    lock_for_read(rid, context);
+    if (const char *bitmap = mapped_bitmap(rid.page_no)) {  // 只读映射，不经过缓冲池
+        if (!Bitmap::is_set(bitmap, rid.slot_no)) {
+            throw RecordNotFoundError(rid.page_no, rid.slot_no);
+        }
+        auto record = std::make_unique<RmRecord>(file_hdr_.record_size);
+        memcpy(record->data, mapped_slot(bitmap, rid.slot_no), file_hdr_.record_size);
+        return record;
+    }
     auto page_handle = fetch_page_handle(rid.page_no); // 取指定记录所在的page handle
-    auto record = std::make_unique<RmRecord>(file_hdr_.record_size);
     if(!Bitmap::is_set(page_handle.bitmap, rid.slot_no)) {  // 是否找到record
+        buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
         throw RecordNotFoundError(rid.page_no, rid.slot_no);
     }
+    auto record = std::make_unique<RmRecord>(file_hdr_.record_size);
     memcpy(record->data, page_handle.get_slot(rid.slot_no), file_hdr_.record_size);  // .get_slot()返回位于slot_no的record的地址
     record->size = file_hdr_.record_size;
+    buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
     return record;
 }
 
+/**
+ * @brief 由Rid得到对context中的事务可见的记录版本，用于扫描算子
+ * 快照隔离事务读取其快照中的版本，可能来自versions_中的旧版本；其他事务读取最新版本，但看不到删除标记
+ *
+ * @return std::unique_ptr<RmRecord> 不可见时返回nullptr
+ */
+std::unique_ptr<RmRecord> RmFileHandle::get_visible_record(const Rid &rid, Context *context) const {
+    lock_for_read(rid, context);
+    return read_visible_record(rid, context == nullptr ? nullptr : context->txn_);
+}
+
+/**
+ * @brief 不加锁地读取对txn可见的记录版本，调用者已经通过lock_for_scan()在表上加了锁
+ * 可被多个线程并发调用
+ */
+std::unique_ptr<RmRecord> RmFileHandle::read_visible_record(const Rid &rid, Transaction *txn) const {
+    std::unique_ptr<RmRecord> record;
+    if (const char *bitmap = mapped_bitmap(rid.page_no)) {
+        if (Bitmap::is_set(bitmap, rid.slot_no)) {
+            record = std::make_unique<RmRecord>(file_hdr_.record_size);
+            memcpy(record->data, mapped_slot(bitmap, rid.slot_no), file_hdr_.record_size);
+        }
+        return versions_.read(rid, txn, std::move(record));
+    }
+    auto page_handle = fetch_page_handle(rid.page_no);
+    if (Bitmap::is_set(page_handle.bitmap, rid.slot_no)) {
+        record = std::make_unique<RmRecord>(file_hdr_.record_size, page_handle.get_slot(rid.slot_no));
+    }
+    buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
+    return versions_.read(rid, txn, std::move(record));
+}
+
 /**
  * @brief 在该记录文件（RmFileHandle）中插入一条记录
  *
@@ -33,19 +181,172 @@ Rid RmFileHandle::insert_record(char *buf, Context *context) {
     // 2. 在page handle中找到空闲slot位置
     // 3. 将buf复制到空闲slot位置
     // 4. 更新page_handle.page_hdr中的数据结构
-    // 注意考虑插入一条记录后页面已满的情况，需要更新file_hdr_.first_free_page_no
+    // 注意插入一条记录后页面的空闲程度会变化，需要更新fsm_
+
+    leave_mmap_for_write();
+    std::string tab_name = need_log(context) ? disk_manager_->GetFileName(fd_) : "";
+    while (true) {
+        RmPageHandle page_handle = create_page_handle(); // 创建或获取一个空闲的page handle
+        if (page_handle.page == nullptr) {
+            throw InternalError("RmFileHandle::insert_record: no free frame in buffer pool");
+        }
+        int page_no = page_handle.page->GetPageId().page_no;
+        int free_slot = next_free_slot(page_handle, -1);  // 获取空闲的slot
+        if(free_slot == file_hdr_.num_records_per_page) {  // 并发插入时该页已被其他线程填满，修正FSM后重新查找
+            update_fsm(page_handle);
+            buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
+            continue;
+        }
+        bool claimed;
+        try {
+            claimed = claim_slot(page_handle, free_slot, buf, context, tab_name);
+        } catch (...) {
+            buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
+            throw;
+        }
+        if (!claimed) {  // 该slot已被并发插入的线程占用，重新查找
+            buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
+            continue;
+        }
+        update_fsm(page_handle);
+        buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), true);
+        return Rid{page_no, free_slot};
+    }
+}
+
+/**
+ * @brief 在页面latch内查找page_handle中slot_no之后的第一个空闲slot
+ * @return 没有空闲slot时返回num_records_per_page
+ */
+int RmFileHandle::next_free_slot(const RmPageHandle &page_handle, int slot_no) const {
+    std::scoped_lock latch{page_latch(page_handle.page->GetPageId().page_no)};
+    return Bitmap::next_bit(false, page_handle.bitmap, file_hdr_.num_records_per_page, slot_no);
+}
+
+/**
+ * @brief 把buf插入page_handle中的空闲slot slot_no，供insert_record()和insert_records()使用
+ * 行锁可能阻塞，在页面latch之外获取；拿到行锁后在latch内确认slot仍然空闲再写入，
+ * 并发插入同一页面的线程因此不会占用同一个slot，也不会丢失对页头中记录数的修改
+ * @return slot已被其他线程占用时返回false，页面不做任何修改，调用者另选slot
+ */
+bool RmFileHandle::claim_slot(const RmPageHandle &page_handle, int slot_no, const char *buf, Context *context,
+                              const std::string &tab_name) {
+    Rid rid{page_handle.page->GetPageId().page_no, slot_no};
+    bool tid_locked = lock_for_write(rid, context);
+    std::scoped_lock latch{page_latch(rid.page_no)};
+    if (Bitmap::is_set(page_handle.bitmap, slot_no)) {
+        abandon_write(rid, context, tid_locked, false);
+        return false;
+    }
+    bool registered = false;
+    try {
+        if (Transaction *txn = versioned_txn(context)) {  // 先登记为未提交的插入，其他快照看不到这条记录
+            registered = versions_.before_write(rid, txn, nullptr, false);
+        }
+        if (need_log(context)) {  // WAL: 先写日志并设置page_lsn，再修改页面
+            InsertLogRecord log_record(context->txn_->GetTransactionId(),
+                                       RmRecord(file_hdr_.record_size, const_cast<char *>(buf)), rid, tab_name);
+            append_log(context, &log_record, page_handle.page);
+        }
+    } catch (...) {
+        abandon_write(rid, context, tid_locked, registered);
+        throw;
+    }
+    memcpy(page_handle.get_slot(slot_no), buf, file_hdr_.record_size);
+    Bitmap::set(page_handle.bitmap, slot_no);
+    page_handle.page_hdr->num_records++;
+    return true;
+}
+
+/** 在页面latch内读取记录数并更新FSM */
+void RmFileHandle::update_fsm(const RmPageHandle &page_handle) {
+    int page_no = page_handle.page->GetPageId().page_no;
+    std::scoped_lock latch{page_latch(page_no)};
+    fsm_->update(page_no, page_handle.page_hdr->num_records);
+}
+
+/**
+ * @brief 批量插入记录，用于多行INSERT和LOAD DATA
+ * 与逐条调用insert_record()相比，每个页面只fetch一次并一次性填满；
+ * 已有空闲页填满后，剩余记录所需的新页面由extend_pages()通过DiskManager::AllocatePages()一次分配一段连续页号
+ *
+ * @param bufs 连续存放的num_records条记录，每条长度为file_hdr_.record_size
+ * @param num_records 记录条数
+ * @return std::vector<Rid> 每条记录的插入位置，与输入顺序一致
+ */
+std::vector<Rid> RmFileHandle::insert_records(const char *bufs, int num_records, Context *context) {
+    leave_mmap_for_write();
+    std::vector<Rid> rids;
+    rids.reserve(num_records);
+    int inserted = 0;
+    std::string tab_name = need_log(context) ? disk_manager_->GetFileName(fd_) : "";
+
+    // 将记录填入page_handle中的空闲slot，直到页面满或记录插完
+    auto fill_page = [&](RmPageHandle &page_handle) {
+        int page_no = page_handle.page->GetPageId().page_no;
+        for (int slot_no = next_free_slot(page_handle, -1);
+             inserted < num_records && slot_no < file_hdr_.num_records_per_page;
+             slot_no = next_free_slot(page_handle, slot_no)) {
+            if (claim_slot(page_handle, slot_no, bufs + (size_t)inserted * file_hdr_.record_size, context, tab_name)) {
+                rids.push_back(Rid{page_no, slot_no});
+                inserted++;
+            }
+        }
+    };
+
+    while (true) {
+        // 1. 先填满FSM中登记的未满页面
+        while (inserted < num_records) {
+            page_id_t page_no = fsm_->find_free_page(file_hdr_.num_pages);
+            if (page_no == RM_NO_PAGE) {
+                break;
+            }
+            RmPageHandle page_handle = fetch_page_handle(page_no);
+            try {
+                fill_page(page_handle);
+            } catch (...) {
+                update_fsm(page_handle);
+                buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), true);
+                throw;
+            }
+            update_fsm(page_handle);
+            buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), true);
+        }
+        if (inserted == num_records) {
+            return rids;
+        }
+        // 2. 为剩余记录追加一段连续的新页面，登记到FSM后回到第1步填充；
+        //    新页面可能被并发插入的线程抢先用掉一部分，不够时再扩展
+        int num_new_pages =
+            (num_records - inserted + file_hdr_.num_records_per_page - 1) / file_hdr_.num_records_per_page;
+        extend_pages(num_new_pages);
+    }
+}
 
-    RmPageHandle page_handle = create_page_handle(); // 创建或获取一个空闲的page handle
-    int free_slot = Bitmap::first_bit(false, page_handle.bitmap, file_hdr_.num_records_per_page);  // 获取空闲的slot
-    //false表示找到第一个未设置的比特位，传入page_handle的位图和该页最大记录数。Bitmap::first_bit会扫描位图，找到第一个为0的slot位。即查找页面中第一个空闲的记录槽位，并返回该空闲slot的序号。
-    memcpy(page_handle.get_slot(free_slot), buf, file_hdr_.record_size);
-    Bitmap::set(page_handle.bitmap, free_slot);
-    // 更新page_handle.page_hdr
-    page_handle.page_hdr->num_records+=1;
-    if(page_handle.page_hdr->num_records == file_hdr_.num_records_per_page) {  // 满了
-        file_hdr_.first_free_page_no = page_handle.page_hdr->next_free_page_no;  // file_hdr_.first_free_page_no从被占满的此页变为此页指向的next_free_page_no
+/**
+ * @brief 在文件末尾追加num_pages个连续的空页面，并登记到file_hdr_和FSM中
+ * 只在extend_latch_内分配和初始化页面，不在latch内等待行锁或写日志。
+ * 缓冲池没有空闲帧时不创建该页面：读文件末尾之后的页面得到全0的数据，本身就是合法的空页面，
+ * 因此分配到的页号总是全部登记，不会出现已分配但num_pages和FSM都不知道的页面
+ */
+void RmFileHandle::extend_pages(int num_pages) {
+    std::scoped_lock lock{extend_latch_};
+    page_id_t first_page_no = disk_manager_->AllocatePages(fd_, num_pages);
+    for (int i = 0; i < num_pages; i++) {
+        Page *page = buffer_pool_manager_->CreatePage({fd_, first_page_no + i});
+        if (page == nullptr) {
+            continue;
+        }
+        RmPageHandle page_handle(&file_hdr_, page);
+        page_handle.page_hdr->num_records = 0;
+        page_handle.page_hdr->next_free_page_no = RM_NO_PAGE;
+        Bitmap::init(page_handle.bitmap, file_hdr_.bitmap_size);
+        buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+    }
+    file_hdr_.num_pages += num_pages;
+    for (int i = 0; i < num_pages; i++) {
+        fsm_->update(first_page_no + i, 0);
     }
-    return Rid{page_handle.page->GetPageId().page_no, free_slot};
 }
 
 /**
@@ -57,17 +358,56 @@ void RmFileHandle::delete_record(const Rid &rid, Context *context) {
     // Todo:
     // 1. 获取指定记录所在的page handle
     // 2. 更新page_handle.page_hdr中的数据结构
-    // 注意考虑删除一条记录后页面未满的情况，需要调用release_page_handle()
+    // 注意删除一条记录后页面的空闲程度会变化，需要更新fsm_
 
+    leave_mmap_for_write();
+    bool tid_locked = lock_for_write(rid, context);
+    if (Transaction *txn = versioned_txn(context)) {
+        // 事务的删除只留下删除标记，旧快照仍能读到这条记录，由versions_的GC真正删除
+        bool registered = false;
+        try {
+            auto page_handle = fetch_page_handle(rid.page_no); // 取指定记录所在的page handle
+            bool found = Bitmap::is_set(page_handle.bitmap, rid.slot_no);
+            RmRecord old_record(file_hdr_.record_size, page_handle.get_slot(rid.slot_no));
+            buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
+            if (!found) { // 是否找到record
+                throw PageNotExistError("  ", rid.page_no);
+            }
+            registered = versions_.before_write(rid, txn, &old_record, true);
+            if (need_log(context)) {
+                MarkDeleteLogRecord log_record(txn->GetTransactionId(), old_record, rid,
+                                               disk_manager_->GetFileName(fd_));
+                append_log(context, &log_record, nullptr);
+            }
+        } catch (...) {
+            abandon_write(rid, context, tid_locked, registered);
+            throw;
+        }
+        return;
+    }
     auto page_handle = fetch_page_handle(rid.page_no); // 取指定记录所在的page handle
     if(!Bitmap::is_set(page_handle.bitmap, rid.slot_no)) { // 是否找到record
+        buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
         throw PageNotExistError("  ", rid.page_no);
     }
-    Bitmap::reset(page_handle.bitmap, rid.slot_no);  // 置0
-    if(page_handle.page_hdr->num_records == file_hdr_.num_records_per_page) {
-        release_page_handle(page_handle);
+    if (need_log(context)) {
+        DeleteLogRecord log_record(context->txn_->GetTransactionId(),
+                                   RmRecord(file_hdr_.record_size, page_handle.get_slot(rid.slot_no)), rid,
+                                   disk_manager_->GetFileName(fd_));
+        try {
+            append_log(context, &log_record, page_handle.page);
+        } catch (...) {
+            buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
+            throw;
+        }
     }
-    page_handle.page_hdr->num_records-=1;
+    {
+        std::scoped_lock latch{page_latch(rid.page_no)};  // 与同一页面上的并发插入互斥
+        Bitmap::reset(page_handle.bitmap, rid.slot_no);  // 置0
+        page_handle.page_hdr->num_records-=1;
+        fsm_->update(rid.page_no, page_handle.page_hdr->num_records);
+    }
+    buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), true);
 
 }
 
@@ -81,11 +421,36 @@ void RmFileHandle::update_record(const Rid &rid, char *buf, Context *context) {
     // Todo:
     // 1. 获取指定记录所在的page handle
     // 2. 更新记录
+    leave_mmap_for_write();
+    if (rid.page_no >= file_hdr_.num_pages) {  // 在登记writer之前检查，此后fetch_page_handle()不会失败
+        throw PageNotExistError(" ", rid.page_no);
+    }
+    bool tid_locked = lock_for_write(rid, context);
+    bool registered = false;
     auto page_handle = fetch_page_handle(rid.page_no); // 取指定记录所在的page handle
     if(!Bitmap::is_set(page_handle.bitmap, rid.slot_no)) {  // 是否找到record
+        buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
+        abandon_write(rid, context, tid_locked, registered);
         throw PageNotExistError("  ", rid.page_no);
     }
+    try {  // 写冲突或日志写入失败时页面尚未修改
+        if (Transaction *txn = versioned_txn(context)) {  // 把修改前的版本保存到版本链中
+            RmRecord old_record(file_hdr_.record_size, page_handle.get_slot(rid.slot_no));
+            registered = versions_.before_write(rid, txn, &old_record, false);
+        }
+        if (need_log(context)) {
+            UpdateLogRecord log_record(context->txn_->GetTransactionId(),
+                                       RmRecord(file_hdr_.record_size, page_handle.get_slot(rid.slot_no)),
+                                       RmRecord(file_hdr_.record_size, buf), rid, disk_manager_->GetFileName(fd_));
+            append_log(context, &log_record, page_handle.page);
+        }
+    } catch (...) {
+        buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
+        abandon_write(rid, context, tid_locked, registered);
+        throw;
+    }
     memcpy(page_handle.get_slot(rid.slot_no), buf, file_hdr_.record_size);  // 更新record
+    buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), true);
 }
 
 /** -- 以下为辅助函数 -- */
@@ -116,8 +481,9 @@ RmPageHandle RmFileHandle::create_new_page_handle() {
     // Todo:
     // 1.使用缓冲池来创建一个新page
     // 2.更新page handle中的相关信息
-    // 3.更新file_hdr_
+    // 3.更新file_hdr_，并在fsm_中登记新页面
 
+    std::scoped_lock lock{extend_latch_};  // 并发插入时可能同时扩展文件
     PageId page_id = {this->fd_, INVALID_PAGE_ID};  //新页id未确定，由NewPage()确定
     Page* newPage = this->buffer_pool_manager_->NewPage(&page_id);
     RmPageHandle page_handle = RmPageHandle(&file_hdr_, newPage);
@@ -125,7 +491,7 @@ RmPageHandle RmFileHandle::create_new_page_handle() {
         page_handle.page_hdr->num_records = 0;
         page_handle.page_hdr->next_free_page_no = RM_NO_PAGE;
         file_hdr_.num_pages+=1;
-        file_hdr_.first_free_page_no = page_id.page_no;
+        fsm_->update(page_id.page_no, 0);
     }
     return page_handle;
 
@@ -139,56 +505,168 @@ RmPageHandle RmFileHandle::create_new_page_handle() {
  */
 RmPageHandle RmFileHandle::create_page_handle() {
     // Todo:
-    // 1. 判断file_hdr_中是否还有空闲页
+    // 1. 通过fsm_查找是否还有空闲页
     //     1.1 没有空闲页：使用缓冲池来创建一个新page；可直接调用create_new_page_handle()
-    //     1.2 有空闲页：直接获取第一个空闲页
+    //     1.2 有空闲页：直接获取该空闲页
     // 2. 生成page handle并返回给上层
 
-    if(file_hdr_.first_free_page_no != RM_NO_PAGE){
-        return fetch_page_handle(file_hdr_.first_free_page_no);
+    page_id_t page_no = fsm_->find_free_page(file_hdr_.num_pages);
+    if(page_no != RM_NO_PAGE){
+        return fetch_page_handle(page_no);
     }
     return create_new_page_handle();
 }
 
 /**
- * @brief 当page handle中的page从已满变成未满的时候调用
+ * @brief 打开记录文件对应的FSM(.fsm文件)，由RmManager::open_file()在打开记录文件后调用
+ * 如果.fsm文件不存在(旧版本创建的记录文件)，则创建并根据各数据页的页头重建
+ * 文件头只在关闭文件时写回，崩溃后其中的num_pages可能落后于已经写入文件的页面；检查点截断日志后，
+ * 恢复也无法再从日志中得知这些页面，因此以文件大小为准，并把多出的页面登记到FSM中
  *
- * @param page_handle
- * @note only used in delete_record()
+ * @param filename 记录文件名
  */
-void RmFileHandle::release_page_handle(RmPageHandle &page_handle) {
-    // Todo:
-    // 当page从已满变成未满，考虑如何更新：
-    // 1. page_handle.page_hdr->next_free_page_no
-    // 2. file_hdr_.first_free_page_no
-    page_handle.page_hdr->next_free_page_no = file_hdr_.first_free_page_no;
-    file_hdr_.first_free_page_no = page_handle.page->GetPageId().page_no;
-    /* 更新方式
-       file->first_free(old)
-       page->next_free=first_free(old)
-       file->first_free(new) = page_no
-       file-->first_free(new)（this page)--> first_free(old)*/
+void RmFileHandle::open_free_space_map(const std::string &filename) {
+    int num_hdr_pages = file_hdr_.num_pages;
+    int num_file_pages = disk_manager_->GetFileSize(filename) / PAGE_SIZE;
+    if (num_file_pages > file_hdr_.num_pages) {
+        file_hdr_.num_pages = num_file_pages;
+        disk_manager_->set_fd2pageno(fd_, num_file_pages);
+    }
+    std::string fsm_name = RmFreeSpaceMap::get_fsm_name(filename);
+    bool need_rebuild = !disk_manager_->is_file(fsm_name);
+    if (need_rebuild) {
+        disk_manager_->create_file(fsm_name);
+    }
+    int fsm_fd = disk_manager_->open_file(fsm_name);
+    int num_fsm_pages = disk_manager_->GetFileSize(fsm_name) / PAGE_SIZE;
+    disk_manager_->set_fd2pageno(fsm_fd, num_fsm_pages);
+    fsm_ = std::make_unique<RmFreeSpaceMap>(buffer_pool_manager_, fsm_fd, num_fsm_pages,
+                                            file_hdr_.num_records_per_page);
+    int first_unregistered = need_rebuild ? RM_FIRST_RECORD_PAGE : std::max(num_hdr_pages, RM_FIRST_RECORD_PAGE);
+    for (int page_no = first_unregistered; page_no < file_hdr_.num_pages; page_no++) {
+        RmPageHandle page_handle = fetch_page_handle(page_no);
+        fsm_->update(page_no, page_handle.page_hdr->num_records);
+        buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
+    }
+}
+
+/**
+ * @brief 将FSM刷盘并关闭.fsm文件，由RmManager::close_file()在关闭记录文件前调用
+ */
+void RmFileHandle::close_free_space_map() {
+    buffer_pool_manager_->FlushAllPages(fsm_->GetFd());
+    disk_manager_->close_file(fsm_->GetFd());
+    fsm_.reset();
 }
 
 /**
- * @brief 用于事务的rollback操作
+ * @brief 用于事务的rollback操作和恢复
  *
  * @param rid record的插入位置
  * @param buf record的内容
+ * @param context 回滚时传入正在回滚的事务，补偿操作同样写入日志
  */
-void RmFileHandle::insert_record(const Rid &rid, char *buf) {
-    if (rid.page_no < file_hdr_.num_pages) {
-        create_new_page_handle();
+void RmFileHandle::insert_record(const Rid &rid, char *buf, Context *context) {
+    leave_mmap_for_write();
+    while (rid.page_no >= file_hdr_.num_pages) {
+        RmPageHandle new_page_handle = create_new_page_handle();
+        if (new_page_handle.page == nullptr) {
+            throw InternalError("RmFileHandle::insert_record: no free frame in buffer pool");
+        }
+        buffer_pool_manager_->UnpinPage(new_page_handle.page->GetPageId(), true);
     }
     RmPageHandle pageHandle = fetch_page_handle(rid.page_no);
-    Bitmap::set(pageHandle.bitmap, rid.slot_no);
-    pageHandle.page_hdr->num_records++;
-    if (pageHandle.page_hdr->num_records == file_hdr_.num_records_per_page) {
-        file_hdr_.first_free_page_no = pageHandle.page_hdr->next_free_page_no;
+    if (need_log(context)) {  // WAL: 先写日志再修改页面
+        InsertLogRecord log_record(context->txn_->GetTransactionId(), RmRecord(file_hdr_.record_size, buf), rid,
+                                   disk_manager_->GetFileName(fd_));
+        append_log(context, &log_record, pageHandle.page);
     }
-
+    std::scoped_lock latch{page_latch(rid.page_no)};
     char *slot = pageHandle.get_slot(rid.slot_no);
     memcpy(slot, buf, file_hdr_.record_size);
+    Bitmap::set(pageHandle.bitmap, rid.slot_no);
+    pageHandle.page_hdr->num_records++;
+    fsm_->update(rid.page_no, pageHandle.page_hdr->num_records);
 
     buffer_pool_manager_->UnpinPage(pageHandle.page->GetPageId(), true);
 }
+
+/**
+ * @brief 只读模式：把记录文件整个只读映射到内存，读记录和扫描直接访问映射，不经过DiskManager和缓冲池
+ * 映射前先把缓冲池中该文件的脏页写回，保证映射看到的是最新内容；映射期间文件不能增长
+ *
+ * @param sequential 访问模式提示：true为MADV_SEQUENTIAL(内核加大预读、读过的页尽早回收)，false为MADV_RANDOM
+ */
+void RmFileHandle::enable_mmap(bool sequential) {
+    std::scoped_lock lock{mmap_latch_};
+    char *base = mmap_base_.load(std::memory_order_relaxed);
+    if (base == nullptr) {
+        if (!buffer_pool_manager_->FlushAllPages(fd_)) {
+            throw InternalError("RmFileHandle::enable_mmap: pages of the file are still pinned");
+        }
+        size_t size = static_cast<size_t>(file_hdr_.num_pages) * PAGE_SIZE;
+        struct stat stat_buf;
+        if (fstat(fd_, &stat_buf) != 0) {
+            throw UnixError();
+        }
+        if (static_cast<size_t>(stat_buf.st_size) < size) {  // 访问文件末尾之外的映射会收到SIGBUS
+            throw InternalError("RmFileHandle::enable_mmap: file is shorter than num_pages");
+        }
+        void *addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0);
+        if (addr == MAP_FAILED) {
+            throw UnixError();
+        }
+        base = static_cast<char *>(addr);
+        mmap_size_ = size;
+        mmap_base_.store(base, std::memory_order_release);
+    }
+    madvise(base, mmap_size_, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);  // 只是提示，失败不影响正确性
+}
+
+/**
+ * @brief 回到经过缓冲池的读写路径
+ * 其他线程可能还在读旧的映射，因此只是不再使用它，到句柄析构时才解除映射
+ */
+void RmFileHandle::disable_mmap() {
+    std::scoped_lock lock{mmap_latch_};
+    char *base = mmap_base_.exchange(nullptr, std::memory_order_acq_rel);
+    if (base != nullptr) {
+        retired_maps_.emplace_back(base, mmap_size_);
+    }
+}
+
+RmFileHandle::~RmFileHandle() {
+    disable_mmap();
+    for (auto &[base, size] : retired_maps_) {
+        munmap(base, size);
+    }
+}
+
+/**
+ * 只读表上的DML在执行器中就被拒绝，能走到这里的只有恢复和回滚；
+ * 它们在映射期间修改缓冲池中的页面会让映射读到旧数据，因此先退出只读映射
+ */
+void RmFileHandle::leave_mmap_for_write() {
+    if (mmap_base_.load(std::memory_order_relaxed) != nullptr) {
+        disable_mmap();
+    }
+}
+
+/**
+ * @brief 只读映射中指定页面的位图
+ * @return 没有映射时返回nullptr，调用者改用fetch_page_handle()
+ */
+const char *RmFileHandle::mapped_bitmap(int page_no) const {
+    const char *base = mmap_base_.load(std::memory_order_acquire);
+    if (base == nullptr) {
+        return nullptr;
+    }
+    if (page_no >= file_hdr_.num_pages) {
+        throw PageNotExistError(" ", page_no);
+    }
+    return base + static_cast<size_t>(page_no) * PAGE_SIZE + Page::OFFSET_PAGE_HDR + sizeof(RmPageHdr);
+}
+
+const char *RmFileHandle::mapped_slot(const char *bitmap, int slot_no) const {
+    return bitmap + file_hdr_.bitmap_size + slot_no * file_hdr_.record_size;
+}
@@ -0,0 +1,123 @@
+#include "rm_free_space_map.h"
+
+#include <functional>
+#include <thread>
+
+#include "rm_defs.h"
+
+/**
+ * @brief 查找一个还有空闲slot的数据页
+ * 每个线程从由其线程id决定的不同位置开始查找，到末尾后回绕，
+ * 使并发插入的线程分散到不同的数据页上，而不是都挤在空闲链表头的同一页
+ */
+page_id_t RmFreeSpaceMap::find_free_page(int num_pages) {
+    int num_data_pages = num_pages - RM_FIRST_RECORD_PAGE;
+    if (num_data_pages <= 0) {
+        return RM_NO_PAGE;
+    }
+    static thread_local size_t thread_hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+    int start = RM_FIRST_RECORD_PAGE + static_cast<int>(thread_hint % num_data_pages);
+
+    // 依次查找[start, num_pages)和[RM_FIRST_RECORD_PAGE, start)
+    int ranges[2][2] = {{start, num_pages}, {RM_FIRST_RECORD_PAGE, start}};
+    for (auto &range : ranges) {
+        int page_no = range[0];
+        while (page_no < range[1]) {
+            int fsm_page_no = page_no / FSM_ENTRIES_PER_PAGE;
+            int fsm_page_end = std::min((fsm_page_no + 1) * FSM_ENTRIES_PER_PAGE, range[1]);
+            Page *page = fetch_fsm_page(fsm_page_no);
+            const char *data = page->GetData() + Page::OFFSET_PAGE_HDR;
+            page_id_t found = RM_NO_PAGE;
+            {
+                std::scoped_lock lock{latches_[fsm_page_no % FSM_LATCH_NUM]};
+                for (; page_no < fsm_page_end; page_no++) {
+                    int idx = page_no % FSM_ENTRIES_PER_PAGE;
+                    // 一个字节内的4个页面都已满时整体跳过
+                    if (idx % FSM_ENTRIES_PER_BYTE == 0 && data[idx / FSM_ENTRIES_PER_BYTE] == 0 &&
+                        page_no + FSM_ENTRIES_PER_BYTE <= fsm_page_end) {
+                        page_no += FSM_ENTRIES_PER_BYTE - 1;
+                        continue;
+                    }
+                    if (get_entry(data, idx) != FSM_FULL) {
+                        found = page_no;
+                        break;
+                    }
+                }
+            }
+            buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+            if (found != RM_NO_PAGE) {
+                return found;
+            }
+        }
+    }
+    return RM_NO_PAGE;
+}
+
+/**
+ * @brief 数据页上的记录数变化后调用，更新该页在FSM中的空闲程度
+ */
+void RmFreeSpaceMap::update(page_id_t page_no, int num_records) {
+    int fsm_page_no = page_no / FSM_ENTRIES_PER_PAGE;
+    int idx = page_no % FSM_ENTRIES_PER_PAGE;
+    uint8_t value = category(num_records);
+    Page *page = fetch_fsm_page(fsm_page_no);
+    bool is_dirty = false;
+    {
+        std::scoped_lock lock{latches_[fsm_page_no % FSM_LATCH_NUM]};
+        char *data = page->GetData() + Page::OFFSET_PAGE_HDR;
+        if (get_entry(data, idx) != value) {
+            set_entry(data, idx, value);
+            is_dirty = true;
+        }
+    }
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), is_dirty);
+}
+
+RmFreeSpaceMap::FsmCategory RmFreeSpaceMap::category(int num_records) const {
+    int num_free = num_records_per_page_ - num_records;
+    if (num_free <= 0) {
+        return FSM_FULL;
+    } else if (num_free == num_records_per_page_) {
+        return FSM_EMPTY;
+    } else if (num_free * 2 >= num_records_per_page_) {
+        return FSM_HALF;
+    }
+    return FSM_LOW;
+}
+
+uint8_t RmFreeSpaceMap::get_entry(const char *data, int idx) const {
+    int shift = (idx % FSM_ENTRIES_PER_BYTE) * FSM_BITS_PER_PAGE;
+    return (static_cast<uint8_t>(data[idx / FSM_ENTRIES_PER_BYTE]) >> shift) & 0x3;
+}
+
+void RmFreeSpaceMap::set_entry(char *data, int idx, uint8_t value) {
+    int shift = (idx % FSM_ENTRIES_PER_BYTE) * FSM_BITS_PER_PAGE;
+    uint8_t byte = static_cast<uint8_t>(data[idx / FSM_ENTRIES_PER_BYTE]);
+    byte = (byte & ~(0x3 << shift)) | (value << shift);
+    data[idx / FSM_ENTRIES_PER_BYTE] = static_cast<char>(byte);
+}
+
+/**
+ * @brief 获取第fsm_page_no个FSM页
+ * FSM文件按需扩展：新建的FSM页全为0(FSM_FULL)，对应的数据页在首次update()时登记
+ * @note pin the page, remember to unpin it outside!
+ */
+Page *RmFreeSpaceMap::fetch_fsm_page(int fsm_page_no) {
+    if (fsm_page_no >= num_fsm_pages_) {
+        std::scoped_lock lock{extend_latch_};
+        while (fsm_page_no >= num_fsm_pages_) {
+            PageId page_id = {fd_, INVALID_PAGE_ID};
+            Page *page = buffer_pool_manager_->NewPage(&page_id);
+            if (page == nullptr) {
+                throw InternalError("RmFreeSpaceMap: no free frame in buffer pool");
+            }
+            buffer_pool_manager_->UnpinPage(page_id, true);
+            num_fsm_pages_++;
+        }
+    }
+    Page *page = buffer_pool_manager_->FetchPage({fd_, fsm_page_no});
+    if (page == nullptr) {
+        throw InternalError("RmFreeSpaceMap: no free frame in buffer pool");
+    }
+    return page;
+}
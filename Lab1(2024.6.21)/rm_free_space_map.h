@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "storage/buffer_pool_manager.h"
+
+/**
+ * @brief 记录文件的空闲空间映射(free space map, FSM)
+ * 每个数据页在FSM中占2 bit，表示该页的空闲程度(见FsmCategory)，FSM保存在与记录文件同名的.fsm文件中，
+ * 通过缓冲池读写，随FlushAllPages()落盘，因此重启后无需扫描记录文件即可恢复。
+ * 与原来以file_hdr_.first_free_page_no为头的空闲链表相比：
+ * 1. 插入时不再都去争用链表头的同一个页面，不同线程从不同位置开始查找空闲页；
+ * 2. 可以知道每个页面大致有多满。
+ */
+class RmFreeSpaceMap {
+   public:
+    /** 页面空闲程度，按空闲slot占比划分 */
+    enum FsmCategory : uint8_t { FSM_FULL = 0, FSM_LOW = 1, FSM_HALF = 2, FSM_EMPTY = 3 };
+
+    static constexpr int FSM_BITS_PER_PAGE = 2;
+    static constexpr int FSM_ENTRIES_PER_BYTE = 8 / FSM_BITS_PER_PAGE;
+    // 每个FSM页去掉页头(LSN)后可以记录的数据页数
+    static constexpr int FSM_ENTRIES_PER_PAGE = (PAGE_SIZE - Page::OFFSET_PAGE_HDR) * FSM_ENTRIES_PER_BYTE;
+    static constexpr int FSM_LATCH_NUM = 16;  // 按FSM页号分段加锁
+
+    /**
+     * @param fd 已打开的.fsm文件
+     * @param num_fsm_pages .fsm文件当前的页数
+     * @param num_records_per_page 数据页能存放的记录数
+     */
+    RmFreeSpaceMap(BufferPoolManager *buffer_pool_manager, int fd, int num_fsm_pages, int num_records_per_page)
+        : buffer_pool_manager_(buffer_pool_manager),
+          fd_(fd),
+          num_records_per_page_(num_records_per_page),
+          num_fsm_pages_(num_fsm_pages) {}
+
+    static std::string get_fsm_name(const std::string &filename) { return filename + ".fsm"; }
+
+    int GetFd() const { return fd_; }
+
+    /**
+     * @brief 查找一个还有空闲slot的数据页
+     * @param num_pages 记录文件当前的页数，只在[RM_FIRST_RECORD_PAGE, num_pages)中查找
+     * @return 空闲页的页号，没有空闲页返回RM_NO_PAGE
+     */
+    page_id_t find_free_page(int num_pages);
+
+    /**
+     * @brief 数据页上的记录数变化后调用，更新该页在FSM中的空闲程度
+     */
+    void update(page_id_t page_no, int num_records);
+
+    /** 根据记录数计算页面的空闲程度 */
+    FsmCategory category(int num_records) const;
+
+   private:
+    uint8_t get_entry(const char *data, int idx) const;
+
+    void set_entry(char *data, int idx, uint8_t value);
+
+    /** 获取第fsm_page_no个FSM页，不存在时在文件末尾创建(全部为FSM_FULL，即尚未登记) */
+    Page *fetch_fsm_page(int fsm_page_no);
+
+    BufferPoolManager *buffer_pool_manager_;
+    int fd_;                    // .fsm文件的fd
+    int num_records_per_page_;  // 数据页能存放的记录数
+    std::atomic<int> num_fsm_pages_;  // .fsm文件的页数
+    std::mutex latches_[FSM_LATCH_NUM];
+    std::mutex extend_latch_;  // 保护FSM文件的扩展
+};
@@ -30,10 +30,16 @@ void RmScan::next() {
     // Todo:
     // 找到文件中下一个存放了记录的非空闲位置，用rid_来指向这个位置
     while(this->rid_.page_no < file_handle_ -> file_hdr_.num_pages){
-        RmPageHandle page_handle = file_handle_->fetch_page_handle(this->rid_.page_no);
-        this->rid_.slot_no = Bitmap::next_bit(true, page_handle.bitmap,
-                                              file_handle_->file_hdr_.num_records_per_page,
-                                              this->rid_.slot_no);
+        if (const char *bitmap = file_handle_->mapped_bitmap(this->rid_.page_no)) {  // 只读映射，不经过缓冲池
+            this->rid_.slot_no = Bitmap::next_bit(true, bitmap, file_handle_->file_hdr_.num_records_per_page,
+                                                  this->rid_.slot_no);
+        } else {
+            RmPageHandle page_handle = file_handle_->fetch_page_handle(this->rid_.page_no);
+            this->rid_.slot_no = Bitmap::next_bit(true, page_handle.bitmap,
+                                                  file_handle_->file_hdr_.num_records_per_page,
+                                                  this->rid_.slot_no);
+            file_handle_->buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
+        }
         if(this->rid_.slot_no >= this->file_handle_->file_hdr_.num_records_per_page){  //本页没有
             if ((this->rid_.page_no + 1) == file_handle_ -> file_hdr_.num_pages){ // 遍历后续所有页，未找到
                 this->rid_ = Rid{RM_NO_PAGE, -1};
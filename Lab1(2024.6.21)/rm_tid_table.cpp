@@ -0,0 +1,98 @@
+#include "rm_tid_table.h"
+
+timestamp_t RmTidTable::read(const Rid &rid, Transaction *txn) const {
+    if (num_entries_.load(std::memory_order_acquire) == 0) {
+        return 0;
+    }
+    int64_t key = key_of(rid);
+    auto &partition = get_partition(key);
+    std::scoped_lock lock{partition.latch_};
+    auto iter = partition.tids_.find(key);
+    if (iter == partition.tids_.end()) {
+        return 0;
+    }
+    const RmTidEntry &entry = iter->second;
+    if (entry.writer != INVALID_TXN_ID && entry.writer != txn->GetTransactionId()) {
+        txn->SetState(TransactionState::ABORTED);
+        throw TransactionAbortException(txn->GetTransactionId(), AbortReason::WRITE_CONFLICT);
+    }
+    return visible_tid(entry.tid, txn);
+}
+
+bool RmTidTable::validate(const Rid &rid, Transaction *txn, timestamp_t tid) const {
+    if (num_entries_.load(std::memory_order_acquire) == 0) {
+        return tid == 0;
+    }
+    int64_t key = key_of(rid);
+    auto &partition = get_partition(key);
+    std::scoped_lock lock{partition.latch_};
+    auto iter = partition.tids_.find(key);
+    if (iter == partition.tids_.end()) {
+        return tid == 0;
+    }
+    const RmTidEntry &entry = iter->second;
+    if (entry.writer != INVALID_TXN_ID && entry.writer != txn->GetTransactionId()) {
+        return false;
+    }
+    return visible_tid(entry.tid, txn) == tid;
+}
+
+bool RmTidTable::lock(const Rid &rid, Transaction *txn) {
+    int64_t key = key_of(rid);
+    auto &partition = get_partition(key);
+    std::scoped_lock lock{partition.latch_};
+    auto [iter, inserted] = partition.tids_.try_emplace(key);
+    if (inserted) {
+        num_entries_.fetch_add(1, std::memory_order_release);
+    }
+    RmTidEntry &entry = iter->second;
+    if (entry.writer != INVALID_TXN_ID && entry.writer != txn->GetTransactionId()) {
+        txn->SetState(TransactionState::ABORTED);
+        throw TransactionAbortException(txn->GetTransactionId(), AbortReason::WRITE_CONFLICT);
+    }
+    bool newly_locked = entry.writer == INVALID_TXN_ID;
+    entry.writer = txn->GetTransactionId();
+    return newly_locked;
+}
+
+void RmTidTable::install(const Rid &rid, txn_id_t txn_id, timestamp_t commit_ts) {
+    int64_t key = key_of(rid);
+    auto &partition = get_partition(key);
+    std::scoped_lock lock{partition.latch_};
+    auto iter = partition.tids_.find(key);
+    if (iter == partition.tids_.end() || iter->second.writer != txn_id) {
+        return;
+    }
+    iter->second.writer = INVALID_TXN_ID;
+    iter->second.tid = commit_ts;
+}
+
+void RmTidTable::release(const Rid &rid, txn_id_t txn_id) {
+    int64_t key = key_of(rid);
+    auto &partition = get_partition(key);
+    std::scoped_lock lock{partition.latch_};
+    auto iter = partition.tids_.find(key);
+    if (iter != partition.tids_.end() && iter->second.writer == txn_id) {
+        iter->second.writer = INVALID_TXN_ID;
+    }
+}
+
+size_t RmTidTable::prune(timestamp_t watermark) {
+    if (num_entries_.load(std::memory_order_acquire) == 0) {
+        return 0;
+    }
+    size_t num_pruned = 0;
+    for (auto &partition : partitions_) {
+        std::scoped_lock lock{partition.latch_};
+        for (auto iter = partition.tids_.begin(); iter != partition.tids_.end();) {
+            if (iter->second.writer == INVALID_TXN_ID && iter->second.tid <= watermark) {
+                iter = partition.tids_.erase(iter);
+                num_pruned++;
+            } else {
+                ++iter;
+            }
+        }
+    }
+    num_entries_.fetch_sub(num_pruned, std::memory_order_release);
+    return num_pruned;
+}
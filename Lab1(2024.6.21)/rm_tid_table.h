@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#include "rm_defs.h"
+#include "transaction/transaction.h"
+
+/* 一条记录的TID(Silo中的TID word)，记录最近一次提交的修改及正在修改它的事务 */
+struct RmTidEntry {
+    txn_id_t writer = INVALID_TXN_ID;  // 已修改该记录但尚未结束的事务，相当于Silo中的lock bit
+    timestamp_t tid = 0;               // 最近一次提交修改该记录的事务的提交时间戳
+};
+
+/**
+ * @brief 记录文件的TID表，用于乐观并发控制(OCC)
+ * 乐观事务读记录时不加锁，只在读集中记下记录的TID，提交时验证这些TID没有变化且没有被其他事务修改；
+ * 所有事务修改记录时都在这里登记为writer，结束时清除，提交的修改同时把TID推进为提交时间戳。
+ * 从未被修改过的记录没有表项，TID视为0。
+ * 对事务txn而言，不大于txn->GetStartTs()的TID都在txn开始之前提交，统一视为0：
+ * 这样prune()回收这些表项时，正在运行的乐观事务的验证结果不受影响
+ */
+class RmTidTable {
+   public:
+    static constexpr int TID_TABLE_PARTITION_BITS = 6;
+    static constexpr int TID_TABLE_PARTITIONS = 1 << TID_TABLE_PARTITION_BITS;
+
+    /**
+     * @brief 乐观事务读取rid之前调用，返回rid当前的TID
+     * @throws TransactionAbortException 其他事务正在修改该记录(Silo中读到被锁住的TID时abort)
+     */
+    timestamp_t read(const Rid &rid, Transaction *txn) const;
+
+    /** 验证rid的TID仍为tid，且没有被其他事务修改 */
+    bool validate(const Rid &rid, Transaction *txn, timestamp_t tid) const;
+
+    /**
+     * @brief 修改rid之前调用，把txn登记为writer
+     * @return txn是否是本次才登记的；txn之前已经是writer时返回false
+     * @throws TransactionAbortException 其他事务正在修改该记录
+     */
+    bool lock(const Rid &rid, Transaction *txn);
+
+    /** 提交txn_id的修改，TID推进为commit_ts；writer不是txn_id时什么也不做 */
+    void install(const Rid &rid, txn_id_t txn_id, timestamp_t commit_ts);
+
+    /** 撤销修改之后调用，writer是txn_id时清除writer，TID保持不变 */
+    void release(const Rid &rid, txn_id_t txn_id);
+
+    /**
+     * @brief 回收没有writer且TID不大于watermark的表项
+     * @param watermark 活跃的乐观事务中最小的start_ts
+     * @return 回收的表项数
+     */
+    size_t prune(timestamp_t watermark);
+
+    /** 没有任何表项时返回true，此时文件句柄可以安全关闭 */
+    bool empty() const { return num_entries_.load(std::memory_order_acquire) == 0; }
+
+   private:
+    struct alignas(64) Partition {
+        mutable std::mutex latch_;
+        std::unordered_map<int64_t, RmTidEntry> tids_;  // key: (page_no << 32) | slot_no
+    };
+
+    static int64_t key_of(const Rid &rid) {
+        return (static_cast<int64_t>(rid.page_no) << 32) | static_cast<uint32_t>(rid.slot_no);
+    }
+
+    Partition &get_partition(int64_t key) const {
+        return partitions_[(static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL) >> (64 - TID_TABLE_PARTITION_BITS)];
+    }
+
+    /** txn开始之前提交的TID统一视为0 */
+    static timestamp_t visible_tid(timestamp_t tid, Transaction *txn) { return tid <= txn->GetStartTs() ? 0 : tid; }
+
+    mutable Partition partitions_[TID_TABLE_PARTITIONS];
+    std::atomic<size_t> num_entries_{0};  // 表项数，为0时读操作无需查找
+};
@@ -0,0 +1,181 @@
+#include "rm_version_store.h"
+
+#include <vector>
+
+/**
+ * @brief 按txn的快照读取rid处的记录
+ * 最新版本对txn可见的条件：由txn自己修改，或已提交且commit_ts <= start_ts；
+ * 否则沿版本链找到第一个ts <= start_ts的版本。
+ * 非快照隔离事务读取最新的已提交版本：快照隔离事务修改记录时不加X锁，最新版本是其他事务未提交的修改时
+ * 返回版本链中的第一个版本，不能读到未提交的数据
+ */
+std::unique_ptr<RmRecord> RmVersionStore::read(const Rid &rid, Transaction *txn, std::unique_ptr<RmRecord> heap) const {
+    if (num_entries_.load(std::memory_order_acquire) == 0) {
+        return heap;
+    }
+    int64_t key = key_of(rid);
+    auto &partition = get_partition(key);
+    std::scoped_lock lock{partition.latch_};
+    auto iter = partition.versions_.find(key);
+    if (iter == partition.versions_.end()) {
+        return heap;
+    }
+    const RmVersionInfo &info = iter->second;
+    if (txn != nullptr && info.writer != INVALID_TXN_ID && info.writer != txn->GetTransactionId() &&
+        txn->GetIsolationLevel() != IsolationLevel::SNAPSHOT_ISOLATION) {
+        const auto &committed = info.undo;  // 有writer时版本链的第一个版本就是修改之前的已提交版本
+        return committed->exists ? std::make_unique<RmRecord>(committed->image) : nullptr;
+    }
+    bool snapshot = txn != nullptr && txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION;
+    if (!snapshot || info.writer == txn->GetTransactionId() ||
+        (info.writer == INVALID_TXN_ID && info.commit_ts <= txn->GetStartTs())) {
+        return info.deleted ? nullptr : std::move(heap);
+    }
+    for (auto version = info.undo; version != nullptr; version = version->next) {
+        if (version->ts <= txn->GetStartTs()) {
+            return version->exists ? std::make_unique<RmRecord>(version->image) : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+bool RmVersionStore::before_write(const Rid &rid, Transaction *txn, const RmRecord *old_image, bool is_delete) {
+    int64_t key = key_of(rid);
+    auto &partition = get_partition(key);
+    std::scoped_lock lock{partition.latch_};
+    auto [iter, inserted] = partition.versions_.try_emplace(key);
+    if (inserted) {
+        num_entries_.fetch_add(1, std::memory_order_release);
+    }
+    RmVersionInfo &info = iter->second;
+    txn_id_t txn_id = txn->GetTransactionId();
+    if (info.purging) {
+        if (old_image != nullptr) {  // 正在回收的删除标记对任何事务都不可见，不会被正常地修改
+            txn->SetState(TransactionState::ABORTED);
+            throw TransactionAbortException(txn_id, AbortReason::WRITE_CONFLICT);
+        }
+        info = RmVersionInfo{};  // GC已经删除了记录，插入重用了这个slot
+    }
+    if (info.writer == txn_id) {
+        // 本事务已经修改过该记录，版本链中已有修改之前的版本
+        info.deleted = is_delete;
+        return false;
+    }
+    // 2PL和乐观事务的写写冲突已由X锁排除，这里只需发现不加锁的快照隔离事务未提交的修改
+    bool snapshot = txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION;
+    if (info.writer != INVALID_TXN_ID || (snapshot && info.commit_ts > txn->GetStartTs())) {
+        txn->SetState(TransactionState::ABORTED);
+        throw TransactionAbortException(txn_id, AbortReason::WRITE_CONFLICT);
+    }
+    auto version = std::make_shared<RmUndoVersion>();
+    version->ts = info.commit_ts;
+    version->exists = old_image != nullptr && !info.deleted;
+    if (version->exists) {
+        version->image = *old_image;
+    }
+    version->next = std::move(info.undo);
+    info.undo = std::move(version);
+    info.writer = txn_id;
+    info.deleted = is_delete;
+    return true;
+}
+
+void RmVersionStore::commit(const Rid &rid, txn_id_t txn_id, timestamp_t commit_ts) {
+    int64_t key = key_of(rid);
+    auto &partition = get_partition(key);
+    std::scoped_lock lock{partition.latch_};
+    auto iter = partition.versions_.find(key);
+    if (iter == partition.versions_.end() || iter->second.writer != txn_id) {
+        return;
+    }
+    iter->second.writer = INVALID_TXN_ID;
+    iter->second.commit_ts = commit_ts;
+}
+
+std::shared_ptr<RmUndoVersion> RmVersionStore::abort(const Rid &rid, txn_id_t txn_id) {
+    int64_t key = key_of(rid);
+    auto &partition = get_partition(key);
+    std::scoped_lock lock{partition.latch_};
+    auto iter = partition.versions_.find(key);
+    if (iter == partition.versions_.end() || iter->second.writer != txn_id) {
+        return nullptr;  // 其他事务的修改(本事务的写入在登记之前就失败了)不能撤销
+    }
+    RmVersionInfo &info = iter->second;
+    auto version = info.undo;
+    info.writer = INVALID_TXN_ID;
+    info.commit_ts = version->ts;
+    info.deleted = !version->exists;
+    info.undo = version->next;
+    if (info.undo == nullptr && !version->exists) {
+        // 撤销的是插入，记录文件中的记录由调用者删除
+        partition.versions_.erase(iter);
+        num_entries_.fetch_sub(1, std::memory_order_release);
+    }
+    return version->exists ? version : nullptr;
+}
+
+bool RmVersionStore::is_writer(const Rid &rid, txn_id_t txn_id) const {
+    int64_t key = key_of(rid);
+    auto &partition = get_partition(key);
+    std::scoped_lock lock{partition.latch_};
+    auto iter = partition.versions_.find(key);
+    return iter != partition.versions_.end() && iter->second.writer == txn_id;
+}
+
+/**
+ * @brief 回收旧版本
+ * 对start_ts >= watermark的快照，版本链中第一个ts <= watermark的版本之后的版本都不可能被读到；
+ * 如果最新版本已提交且commit_ts <= watermark，整条版本链都可以回收，该记录不再需要版本信息
+ */
+size_t RmVersionStore::garbage_collect(timestamp_t watermark, const std::function<void(const Rid &)> &purge) {
+    size_t num_collected = 0;
+    std::vector<Rid> tombstones;
+    auto count_chain = [](const std::shared_ptr<RmUndoVersion> &version) {
+        size_t num = 0;
+        for (auto cur = version; cur != nullptr; cur = cur->next) {
+            num++;
+        }
+        return num;
+    };
+    for (auto &partition : partitions_) {
+        std::scoped_lock lock{partition.latch_};
+        for (auto iter = partition.versions_.begin(); iter != partition.versions_.end();) {
+            RmVersionInfo &info = iter->second;
+            if (info.writer == INVALID_TXN_ID && info.commit_ts <= watermark) {
+                num_collected += count_chain(info.undo);
+                if (info.deleted) {
+                    // 记录从文件中删除之前保留删除标记，否则这段时间内记录会重新可见；
+                    // 上一次GC没有完成的删除标记(purging已为true)在这里重试
+                    info.undo = nullptr;
+                    info.purging = true;
+                    tombstones.push_back(Rid{static_cast<int>(iter->first >> 32), static_cast<int>(iter->first)});
+                    ++iter;
+                    continue;
+                }
+                iter = partition.versions_.erase(iter);
+                num_entries_.fetch_sub(1, std::memory_order_release);
+                continue;
+            }
+            for (auto version = info.undo; version != nullptr; version = version->next) {
+                if (version->ts <= watermark) {
+                    num_collected += count_chain(version->next);
+                    version->next = nullptr;
+                    break;
+                }
+            }
+            ++iter;
+        }
+    }
+    for (auto &rid : tombstones) {
+        purge(rid);
+        int64_t key = key_of(rid);
+        auto &partition = get_partition(key);
+        std::scoped_lock lock{partition.latch_};
+        auto iter = partition.versions_.find(key);
+        if (iter != partition.versions_.end() && iter->second.purging) {
+            partition.versions_.erase(iter);
+            num_entries_.fetch_sub(1, std::memory_order_release);
+        }
+    }
+    return num_collected;
+}
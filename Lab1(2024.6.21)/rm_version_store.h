@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "rm_defs.h"
+#include "transaction/transaction.h"
+
+/* 一个旧版本(undo版本)，按时间从新到旧链接 */
+struct RmUndoVersion {
+    timestamp_t ts;   // 该版本的提交时间戳，即它对start_ts >= ts的快照可见
+    bool exists;      // 该版本中记录是否存在，插入之前/删除之后的版本为false
+    RmRecord image;   // exists为true时记录的内容
+    std::shared_ptr<RmUndoVersion> next;
+};
+
+/* 一条记录的版本信息，记录文件中存放的是它的最新版本(可能尚未提交) */
+struct RmVersionInfo {
+    txn_id_t writer = INVALID_TXN_ID;  // 正在修改最新版本且尚未提交的事务
+    timestamp_t commit_ts = 0;         // 最新版本的提交时间戳，writer有效时无意义
+    bool deleted = false;              // 最新版本是否是删除标记(tombstone)，记录在GC时才真正从文件中删除
+    bool purging = false;              // 删除标记正在被GC从记录文件中删除，删除完成后才移除版本信息
+    std::shared_ptr<RmUndoVersion> undo;
+};
+
+/**
+ * @brief 记录文件的多版本存储(MVCC)，实现快照隔离(IsolationLevel::SNAPSHOT_ISOLATION)
+ * 记录文件中原地存放最新版本，被覆盖的旧版本作为undo版本保存在内存中，按rid组织成版本链；
+ * 所有隔离级别的事务的修改都在这里登记，快照读因此不会读到2PL事务未提交的修改；
+ * 没有版本信息的记录(从未修改过或已被回收)，其文件中的版本对所有快照可见。
+ * 快照读不加锁，只在读取版本链时持有所在分区的latch；写写冲突按first-updater-wins处理。
+ * 旧版本在没有任何活跃快照需要它之后由garbage_collect()回收。
+ */
+class RmVersionStore {
+   public:
+    static constexpr int VERSION_STORE_PARTITION_BITS = 6;
+    static constexpr int VERSION_STORE_PARTITIONS = 1 << VERSION_STORE_PARTITION_BITS;
+
+    /**
+     * @brief 按txn的快照读取rid处的记录
+     * @param heap 记录文件中的最新版本，记录不存在时为nullptr
+     * @return 对txn可见的版本，不可见返回nullptr
+     * @note txn为空时读取最新的版本，只过滤掉删除标记；不是快照隔离事务时读取最新的已提交版本
+     */
+    std::unique_ptr<RmRecord> read(const Rid &rid, Transaction *txn, std::unique_ptr<RmRecord> heap) const;
+
+    /**
+     * @brief 事务修改rid处的记录之前调用，检查写写冲突并把当前版本保存到版本链中
+     * @param old_image 修改前的最新版本，插入时为nullptr
+     * @param is_delete 本次修改是否为删除，删除只留下删除标记，不从记录文件中删除
+     * @return 是否新保存了一个版本；txn之前已经修改过该记录时返回false
+     * @throws TransactionAbortException 其他事务正在修改该记录，或txn是快照隔离事务且在其快照之后有事务提交了修改
+     */
+    bool before_write(const Rid &rid, Transaction *txn, const RmRecord *old_image, bool is_delete);
+
+    /** 提交txn_id的修改，最新版本对start_ts >= commit_ts的快照可见；writer不是txn_id时什么也不做 */
+    void commit(const Rid &rid, txn_id_t txn_id, timestamp_t commit_ts);
+
+    /**
+     * @brief 撤销txn_id的修改，恢复修改之前的版本信息
+     * @return 修改之前的版本，调用者据此恢复记录文件；修改之前记录不存在，或该记录的writer不是txn_id时返回nullptr
+     */
+    std::shared_ptr<RmUndoVersion> abort(const Rid &rid, txn_id_t txn_id);
+
+    /** rid的最新版本是否是txn_id尚未提交的修改 */
+    bool is_writer(const Rid &rid, txn_id_t txn_id) const;
+
+    /**
+     * @brief 回收所有start_ts >= watermark的快照都不再需要的旧版本
+     * 已提交的删除标记对所有快照都可见时，调用purge把记录从记录文件(和索引)中真正删除；
+     * purge期间删除标记的版本信息仍然保留，记录对所有事务不可见，也不能被修改
+     * @return 回收的版本数
+     */
+    size_t garbage_collect(timestamp_t watermark, const std::function<void(const Rid &)> &purge);
+
+    /** 没有任何版本信息时返回true，此时文件句柄可以安全关闭 */
+    bool empty() const { return num_entries_.load(std::memory_order_acquire) == 0; }
+
+   private:
+    struct alignas(64) Partition {
+        mutable std::mutex latch_;
+        std::unordered_map<int64_t, RmVersionInfo> versions_;  // key: (page_no << 32) | slot_no
+    };
+
+    static int64_t key_of(const Rid &rid) {
+        return (static_cast<int64_t>(rid.page_no) << 32) | static_cast<uint32_t>(rid.slot_no);
+    }
+
+    Partition &get_partition(int64_t key) const {
+        return partitions_[(static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL) >> (64 - VERSION_STORE_PARTITION_BITS)];
+    }
+
+    mutable Partition partitions_[VERSION_STORE_PARTITIONS];
+    std::atomic<size_t> num_entries_{0};  // 有版本信息的记录数，为0时读操作无需查找版本链
+};
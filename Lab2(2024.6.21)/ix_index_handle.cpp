@@ -1,6 +1,7 @@
 #include "ix_index_handle.h"
 
 #include "ix_scan.h"
+#include "storage/metrics.h"
 
 IxIndexHandle::IxIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd)
     : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), fd_(fd) {
@@ -50,6 +51,7 @@ bool IxIndexHandle::GetValue(const char *key, std::vector<Rid> *result, Transact
     // 3. 把rid存入result参数中
     // 提示：使用完buffer_pool提供的page之后，记得unpin page；记得处理并发的上锁
     std::scoped_lock lock{root_latch_};
+    MetricsRegistry::add(Metric::INDEX_LOOKUPS);
 
     IxNodeHandle* leaf_node = FindLeafPage(key, Operation::FIND, transaction);
     Rid* rid;
@@ -75,6 +77,7 @@ bool IxIndexHandle::insert_entry(const char *key, const Rid &value, Transaction
     // 3. 如果结点已满，分裂结点，并把新结点的相关信息插入父节点
     // 提示：记得unpin page；若当前叶子节点是最右叶子节点，则需要更新file_hdr_.last_leaf；记得处理并发的上锁
     std::scoped_lock lock{root_latch_};
+    MetricsRegistry::add(Metric::INDEX_INSERTS);
 
     IxNodeHandle* leaf_node = FindLeafPage(key, Operation::INSERT, transaction);
     int size0 = leaf_node->GetSize();
@@ -211,6 +214,7 @@ bool IxIndexHandle::delete_entry(const char *key, Transaction *transaction) {
     // 3. 如果删除成功需要调用CoalesceOrRedistribute来进行合并或重分配操作，并根据函数返回结果判断是否有结点需要删除
     // 4. 如果需要并发，并且需要删除叶子结点，则需要在事务的delete_page_set中添加删除结点的对应页面；记得处理并发的上锁
     std::scoped_lock lock{root_latch_};
+    MetricsRegistry::add(Metric::INDEX_DELETES);
 
     IxNodeHandle* node = FindLeafPage(key,Operation::FIND,transaction);
     int old_size = node->GetSize();
@@ -515,6 +519,7 @@ Iid IxIndexHandle::lower_bound(const char *key) {
     // int int_key = *(int *)key;
     // printf("my_lower_bound key=%d\n", int_key);
 
+    MetricsRegistry::add(Metric::INDEX_LOOKUPS);  // 范围扫描的起点
     IxNodeHandle *node = FindLeafPage(key, Operation::FIND, nullptr);
     int key_idx = node->lower_bound(key);
 
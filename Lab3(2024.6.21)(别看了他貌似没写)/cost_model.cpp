@@ -0,0 +1,174 @@
+#include "cost_model.h"
+
+#include <cmath>
+#include <cstdio>
+
+/**
+ * 估计列中小于value的值所占的比例
+ * value落在第k个桶(上界为histogram[k])内时，前k个桶全部计入，第k个桶按数值在桶内的位置线性插值，字符串取桶的一半
+ */
+static double fraction_below(const ColStats &stats, const ColMeta &col, const char *value) {
+    if (stats.histogram.empty()) {
+        return CostModel::DEFAULT_RANGE_SEL;
+    }
+    if (ix_compare(value, stats.min_value.data(), col.type, col.len) <= 0) {
+        return 0;
+    }
+    if (ix_compare(value, stats.max_value.data(), col.type, col.len) > 0) {
+        return 1;
+    }
+    auto &bounds = stats.histogram;
+    size_t k = std::partition_point(bounds.begin(), bounds.end(),
+                                    [&](const std::string &bound) {
+                                        return ix_compare(bound.data(), value, col.type, col.len) < 0;
+                                    }) -
+               bounds.begin();
+    if (k == bounds.size()) {
+        return 1;
+    }
+    const char *lower = k == 0 ? stats.min_value.data() : bounds[k - 1].data();
+    const char *upper = bounds[k].data();
+    double in_bucket = 0.5;
+    if (col.type == TYPE_INT || col.type == TYPE_FLOAT) {
+        auto to_double = [&](const char *data) {
+            return col.type == TYPE_INT ? static_cast<double>(*reinterpret_cast<const int *>(data))
+                                        : static_cast<double>(*reinterpret_cast<const float *>(data));
+        };
+        double width = to_double(upper) - to_double(lower);
+        if (width > 0) {
+            in_bucket = (to_double(value) - to_double(lower)) / width;
+        }
+    }
+    return (k + in_bucket) / bounds.size();
+}
+
+double CostModel::estimate_rows(const std::string &tab_name) {
+    RmFileHdr file_hdr = sm_manager_->get_file_handle(tab_name)->get_file_hdr();
+    int num_data_pages = std::max(file_hdr.num_pages - RM_FIRST_RECORD_PAGE, 0);
+    auto stats = sm_manager_->get_table_stats(tab_name);
+    int analyzed_pages = stats == nullptr ? 0 : stats->num_pages - RM_FIRST_RECORD_PAGE;
+    if (analyzed_pages <= 0) {
+        return static_cast<double>(num_data_pages) * file_hdr.num_records_per_page;
+    }
+    // ANALYZE之后表可能增长或收缩，按ANALYZE时每页的平均记录数和当前页数推算
+    return stats->num_rows / analyzed_pages * num_data_pages;
+}
+
+double CostModel::column_ndv(const std::string &tab_name, const std::string &col_name) {
+    auto &tab = sm_manager_->db_.get_table(tab_name);
+    size_t col_idx = tab.get_col(col_name) - tab.cols.begin();
+    auto stats = sm_manager_->get_table_stats(tab_name);
+    if (stats == nullptr || col_idx >= stats->cols.size() || stats->cols[col_idx].num_distinct <= 0) {
+        return std::max(estimate_rows(tab_name), 1.0);
+    }
+    return stats->cols[col_idx].num_distinct;
+}
+
+double CostModel::index_height(double rows, int key_len) {
+    double fanout = std::max<double>((PAGE_SIZE - sizeof(IxPageHdr)) / (key_len + sizeof(Rid)), 2);
+    return std::max(1.0, std::ceil(std::log(std::max(rows, 1.0)) / std::log(fanout)));
+}
+
+double CostModel::selectivity(const std::string &tab_name, const Condition &cond) {
+    double default_sel = cond.op == OP_EQ ? DEFAULT_EQ_SEL : cond.op == OP_NE ? 1 - DEFAULT_EQ_SEL : DEFAULT_RANGE_SEL;
+    if (!cond.is_rhs_val || cond.rhs_val.raw == nullptr) {
+        return default_sel;
+    }
+    auto &tab = sm_manager_->db_.get_table(tab_name);
+    auto col = tab.get_col(cond.lhs_col.col_name);
+    size_t col_idx = col - tab.cols.begin();
+    auto stats = sm_manager_->get_table_stats(tab_name);
+    if (stats == nullptr || stats->num_rows == 0 || col_idx >= stats->cols.size() ||
+        stats->cols[col_idx].histogram.empty()) {
+        return default_sel;
+    }
+    auto &col_stats = stats->cols[col_idx];
+    const char *value = cond.rhs_val.raw->data;
+    double eq_sel = 1 / std::max(col_stats.num_distinct, 1.0);
+    if (ix_compare(value, col_stats.min_value.data(), col->type, col->len) < 0 ||
+        ix_compare(value, col_stats.max_value.data(), col->type, col->len) > 0) {
+        eq_sel = 0;
+    }
+    double below = fraction_below(col_stats, *col, value);
+    double sel;
+    switch (cond.op) {
+        case OP_EQ:
+            sel = eq_sel;
+            break;
+        case OP_NE:
+            sel = 1 - eq_sel;
+            break;
+        case OP_LT:
+            sel = below;
+            break;
+        case OP_LE:
+            sel = below + eq_sel;
+            break;
+        case OP_GT:
+            sel = 1 - below - eq_sel;
+            break;
+        case OP_GE:
+            sel = 1 - below;
+            break;
+        default:
+            throw InternalError("Unexpected op type");
+    }
+    return std::min(std::max(sel, 0.0), 1.0);
+}
+
+/**
+ * 顺序扫描：顺序读全部数据页，每条记录计算一次全部条件。
+ * 索引扫描：从根到叶随机读height页，顺序读范围内的叶子页，每条命中的记录回表随机读一页(假设同一页只读一次)，
+ * 再对回表的记录计算全部条件。与IndexScanExecutor::make_index_scan()一致，每个索引只用第一个落在其列上的条件确定范围
+ */
+AccessPath CostModel::choose_access_path(const std::string &tab_name, const std::vector<Condition> &conds) {
+    auto &tab = sm_manager_->db_.get_table(tab_name);
+    RmFileHdr file_hdr = sm_manager_->get_file_handle(tab_name)->get_file_hdr();
+    double num_data_pages = std::max(file_hdr.num_pages - RM_FIRST_RECORD_PAGE, 0);
+    double rows = estimate_rows(tab_name);
+    double sel = 1;
+    for (auto &cond : conds) {
+        sel *= selectivity(tab_name, cond);
+    }
+    double cpu_per_tuple = CPU_TUPLE_COST + conds.size() * CPU_OPERATOR_COST;
+
+    AccessPath best;
+    best.est_rows = rows * sel;
+    best.cost = num_data_pages * SEQ_PAGE_COST + rows * cpu_per_tuple;
+
+    std::vector<bool> costed(tab.cols.size(), false);
+    for (auto &cond : conds) {
+        if (!cond.is_rhs_val || cond.op == OP_NE) {
+            continue;
+        }
+        auto col = tab.get_col(cond.lhs_col.col_name);
+        size_t index_no = col - tab.cols.begin();
+        if (!col->index || costed[index_no]) {
+            continue;
+        }
+        costed[index_no] = true;
+        double fetched = rows * selectivity(tab_name, cond);
+        double keys_per_leaf = std::max<double>((PAGE_SIZE - sizeof(IxPageHdr)) / (col->len + sizeof(Rid)), 2);
+        double height = index_height(rows, col->len);
+        double leaf_pages = std::ceil(fetched / keys_per_leaf);
+        double heap_pages = std::min(fetched, num_data_pages);
+        double cost = height * RANDOM_PAGE_COST + leaf_pages * SEQ_PAGE_COST + heap_pages * RANDOM_PAGE_COST +
+                      fetched * (CPU_INDEX_TUPLE_COST + cpu_per_tuple);
+        if (cost < best.cost) {
+            best.method = AccessMethod::INDEX_SCAN;
+            best.index_no = static_cast<int>(index_no);
+            best.cost = cost;
+        }
+    }
+    return best;
+}
+
+std::string CostModel::explain(const std::string &tab_name, const AccessPath &path, size_t actual_rows) {
+    std::string target = tab_name;
+    if (path.method == AccessMethod::INDEX_SCAN) {
+        target += "." + sm_manager_->db_.get_table(tab_name).cols.at(path.index_no).name;
+    }
+    char buf[128];
+    snprintf(buf, sizeof(buf), " cost=%.2f rows=%.0f actual_rows=%zu", path.cost, path.est_rows, actual_rows);
+    return (path.method == AccessMethod::SEQ_SCAN ? "SeqScan(" : "IndexScan(") + target + ")" + buf;
+}
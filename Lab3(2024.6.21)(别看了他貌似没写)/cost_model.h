@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "common/common.h"
+#include "system/sm.h"
+
+/** 单表的访问方式 */
+enum class AccessMethod { SEQ_SCAN, INDEX_SCAN };
+
+/** 优化器为一张表选出的访问路径 */
+struct AccessPath {
+    AccessMethod method = AccessMethod::SEQ_SCAN;
+    int index_no = -1;    // INDEX_SCAN使用的索引列下标
+    double est_rows = 0;  // 估计满足全部条件的行数
+    double cost = 0;      // 估计代价，单位为顺序读一页的代价
+};
+
+/**
+ * @brief 基于页数、索引高度和ANALYZE统计信息的代价模型
+ * 代价单位与PostgreSQL相同：顺序读一页为1，随机读一页为RANDOM_PAGE_COST，处理一条元组为CPU_TUPLE_COST。
+ * 表没有统计信息时，行数按数据页全满估计，选择率使用固定的默认值
+ */
+class CostModel {
+   public:
+    static constexpr double SEQ_PAGE_COST = 1.0;
+    static constexpr double RANDOM_PAGE_COST = 4.0;
+    static constexpr double CPU_TUPLE_COST = 0.01;
+    static constexpr double CPU_INDEX_TUPLE_COST = 0.005;
+    static constexpr double CPU_OPERATOR_COST = 0.0025;
+    static constexpr double DEFAULT_EQ_SEL = 0.005;
+    static constexpr double DEFAULT_RANGE_SEL = 1.0 / 3;
+
+    explicit CostModel(SmManager *sm_manager) : sm_manager_(sm_manager) {}
+
+    SmManager *sm_manager() const { return sm_manager_; }
+
+    /** 估计表的行数 */
+    double estimate_rows(const std::string &tab_name);
+
+    /** 估计列的不同值个数，没有统计信息时假设各行的值互不相同 */
+    double column_ndv(const std::string &tab_name, const std::string &col_name);
+
+    /** 按键长估计B+树的扇出，进而估计rows个键的索引高度 */
+    static double index_height(double rows, int key_len);
+
+    /**
+     * @brief 估计单个条件的选择率
+     * 只有右侧为常量的条件能利用统计信息：等值用1/不同值个数，范围用等深直方图；其余条件使用默认值
+     */
+    double selectivity(const std::string &tab_name, const Condition &cond);
+
+    /**
+     * @brief 在顺序扫描和各可用索引的索引扫描中选出代价最小的访问路径
+     * @param conds 只涉及tab_name的条件(连接条件在此不参与选择率估计)
+     */
+    AccessPath choose_access_path(const std::string &tab_name, const std::vector<Condition> &conds);
+
+    /** EXPLAIN中一个扫描算子的输出：访问方式、估计代价、估计行数和实际行数 */
+    std::string explain(const std::string &tab_name, const AccessPath &path, size_t actual_rows);
+
+   private:
+    SmManager *sm_manager_;
+};
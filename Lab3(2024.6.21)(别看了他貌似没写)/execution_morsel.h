@@ -0,0 +1,231 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "execution_defs.h"
+#include "record/rm.h"
+#include "system/sm.h"
+
+/**
+ * @brief morsel: 流水线调度的最小工作单元
+ * 对于顺序扫描是一段连续的数据页[page_begin, page_end)
+ * 对于索引扫描是一段连续的rid下标[page_begin, page_end)
+ */
+struct Morsel {
+    int page_begin;
+    int page_end;
+};
+
+/**
+ * @brief 固定大小的工作线程池，每个线程绑定到一个核上
+ * run()会让所有worker执行同一个任务，并在所有worker完成后返回，
+ * 因此每次run()的返回点天然就是一个流水线中断点(pipeline breaker)的同步点
+ */
+class MorselWorkerPool {
+   public:
+    explicit MorselWorkerPool(size_t num_workers = std::thread::hardware_concurrency()) {
+        if (num_workers == 0) {
+            num_workers = 1;
+        }
+        size_t num_cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        for (size_t i = 0; i < num_workers; i++) {
+            workers_.emplace_back([this, i] { worker_loop(static_cast<int>(i)); });
+            // 将第i个worker绑定到第(i % 核数)个核上，绑核失败不影响正确性
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(i % num_cores, &cpuset);
+            pthread_setaffinity_np(workers_.back().native_handle(), sizeof(cpu_set_t), &cpuset);
+        }
+    }
+
+    ~MorselWorkerPool() {
+        {
+            std::unique_lock<std::mutex> lock(latch_);
+            shutdown_ = true;
+        }
+        start_cv_.notify_all();
+        for (auto &worker : workers_) {
+            worker.join();
+        }
+    }
+
+    size_t num_workers() const { return workers_.size(); }
+
+    /**
+     * @brief 所有worker并行执行task(worker_id)，阻塞直到全部完成
+     * @note task中抛出的第一个异常会在run()返回时重新抛出；
+     *       多个会话共享同一个线程池时，并发的run()按调用顺序依次执行，task中不能再调用run()
+     */
+    void run(const std::function<void(int)> &task) {
+        std::scoped_lock run_lock{run_latch_};
+        std::unique_lock<std::mutex> lock(latch_);
+        task_ = &task;
+        error_ = nullptr;
+        running_ = workers_.size();
+        epoch_++;
+        start_cv_.notify_all();
+        done_cv_.wait(lock, [&] { return running_ == 0; });
+        task_ = nullptr;
+        if (error_ != nullptr) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+   private:
+    void worker_loop(int worker_id) {
+        size_t seen_epoch = 0;
+        while (true) {
+            const std::function<void(int)> *task;
+            {
+                std::unique_lock<std::mutex> lock(latch_);
+                start_cv_.wait(lock, [&] { return shutdown_ || epoch_ != seen_epoch; });
+                if (shutdown_) {
+                    return;
+                }
+                seen_epoch = epoch_;
+                task = task_;
+            }
+            std::exception_ptr error = nullptr;
+            try {
+                (*task)(worker_id);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::unique_lock<std::mutex> lock(latch_);
+            if (error != nullptr && error_ == nullptr) {
+                error_ = error;
+            }
+            if (--running_ == 0) {
+                done_cv_.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex run_latch_;  // 同一时刻只执行一个run()，保证task_在所有worker完成前不被覆盖
+    std::mutex latch_;
+    std::condition_variable start_cv_;  // 通知worker有新任务
+    std::condition_variable done_cv_;   // 通知run()所有worker已完成
+    const std::function<void(int)> *task_ = nullptr;
+    std::exception_ptr error_ = nullptr;
+    size_t running_ = 0;
+    size_t epoch_ = 0;  // 每次run()自增，worker据此判断是否有新任务
+    bool shutdown_ = false;
+};
+
+/**
+ * @brief 流水线的数据源，把输入切分成若干morsel
+ */
+class PipelineSource {
+   public:
+    virtual ~PipelineSource() = default;
+
+    virtual const std::vector<ColMeta> &cols() const = 0;
+
+    virtual size_t tupleLen() const = 0;
+
+    /** 在一次流水线执行开始前调用(单线程)，返回本次需要处理的morsel总数 */
+    virtual size_t prepare(size_t morsel_size) = 0;
+
+    /** 扫描第morsel_idx个morsel，对每条满足条件的记录调用emit(线程安全) */
+    virtual void scan_morsel(size_t morsel_idx, const std::function<void(std::unique_ptr<RmRecord>)> &emit) = 0;
+};
+
+/**
+ * @brief 流水线中间算子(filter/projection/probe)，逐条处理元组，不打断流水线
+ */
+class PipelineStage {
+   public:
+    virtual ~PipelineStage() = default;
+
+    virtual const std::vector<ColMeta> &cols() const = 0;
+
+    virtual size_t tupleLen() const = 0;
+
+    /**
+     * @brief 处理一条元组，把0条(过滤)、1条(投影)或多条(连接探测)结果交给emit
+     */
+    virtual void execute(std::unique_ptr<RmRecord> rec, int worker_id,
+                         const std::function<void(std::unique_ptr<RmRecord>)> &emit) = 0;
+};
+
+/**
+ * @brief 流水线的终点，即pipeline breaker(hash build / sort / aggregate / 物化)
+ * consume()由各worker并发调用，通常写入worker私有的局部状态；
+ * finalize()在所有worker完成后单线程调用，负责合并局部状态
+ */
+class PipelineSink {
+   public:
+    virtual ~PipelineSink() = default;
+
+    /** 在流水线开始前调用，sink据此为每个worker分配局部状态 */
+    virtual void init(size_t num_workers) = 0;
+
+    virtual void consume(std::unique_ptr<RmRecord> rec, int worker_id) = 0;
+
+    virtual void finalize() = 0;
+};
+
+/**
+ * @brief 一条流水线: source -> stages... -> sink
+ */
+struct Pipeline {
+    PipelineSource *source;
+    std::vector<PipelineStage *> stages;
+    PipelineSink *sink;
+};
+
+/**
+ * @brief morsel-driven调度器
+ * 流水线按依赖顺序依次执行；同一条流水线内，各worker通过原子计数器动态领取morsel，
+ * 从而在数据倾斜时也能保持负载均衡。流水线之间以sink->finalize()为同步点。
+ */
+class MorselScheduler {
+   public:
+    explicit MorselScheduler(MorselWorkerPool *pool, size_t morsel_size = DEFAULT_MORSEL_SIZE)
+        : pool_(pool), morsel_size_(morsel_size) {}
+
+    static constexpr size_t DEFAULT_MORSEL_SIZE = 16;  // 每个morsel包含的页数(或rid数/页)
+
+    void execute(const std::vector<Pipeline> &pipelines) {
+        for (auto &pipeline : pipelines) {
+            execute_pipeline(pipeline);
+        }
+    }
+
+    void execute_pipeline(const Pipeline &pipeline) {
+        size_t num_morsels = pipeline.source->prepare(morsel_size_);
+        pipeline.sink->init(pool_->num_workers());
+        std::atomic<size_t> next_morsel{0};
+        pool_->run([&](int worker_id) {
+            // 把元组从第stage_idx个算子开始推到流水线末端
+            std::function<void(std::unique_ptr<RmRecord>, size_t)> push = [&](std::unique_ptr<RmRecord> rec,
+                                                                               size_t stage_idx) {
+                if (stage_idx == pipeline.stages.size()) {
+                    pipeline.sink->consume(std::move(rec), worker_id);
+                    return;
+                }
+                pipeline.stages[stage_idx]->execute(std::move(rec), worker_id, [&](std::unique_ptr<RmRecord> out) {
+                    push(std::move(out), stage_idx + 1);
+                });
+            };
+            auto emit = [&](std::unique_ptr<RmRecord> rec) { push(std::move(rec), 0); };
+            for (size_t idx = next_morsel.fetch_add(1); idx < num_morsels; idx = next_morsel.fetch_add(1)) {
+                pipeline.source->scan_morsel(idx, emit);
+            }
+        });
+        // 所有worker已完成，合并局部状态
+        pipeline.sink->finalize();
+    }
+
+   private:
+    MorselWorkerPool *pool_;
+    size_t morsel_size_;
+};
@@ -20,7 +20,8 @@ class DeleteExecutor : public AbstractExecutor {
         sm_manager_ = sm_manager;
         tab_name_ = tab_name;
         tab_ = sm_manager_->db_.get_table(tab_name);
-        fh_ = sm_manager_->fhs_.at(tab_name).get();
+        sm_manager_->check_writable(tab_name);
+        fh_ = sm_manager_->get_file_handle(tab_name);
         conds_ = conds;
         rids_ = rids;
         context_ = context;
@@ -32,20 +33,34 @@ class DeleteExecutor : public AbstractExecutor {
             if (tab_.cols[col_i].index) {
                 // lab3 task3 Todo
                 // 获取需要的索引句柄,填充vector ihs
+                ihs[col_i] = sm_manager_->get_index_handle(tab_name_, col_i);
                 // lab3 task3 Todo end
             }
         }
+        // 事务的删除在记录文件中只留下删除标记；快照隔离下旧快照仍可能通过索引读到这条记录，
+        // 索引项在删除标记被回收时才删除(见TransactionManager::GarbageCollect)，其他隔离级别立即删除索引项
+        Transaction *txn = context_ == nullptr ? nullptr : context_->txn_;
+        bool snapshot = txn != nullptr && txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION;
         // Delete each rid from record file and index file
+        // 先删除记录：delete_record()抛出异常时索引和撤销缓冲区都还没有改动
         for (auto &rid : rids_) {
             auto rec = fh_->get_record(rid, context_);
             // lab3 task3 Todo
-            // Delete from index file
             // Delete from record file
-            // lab3 task3 Todo end
+            fh_->delete_record(rid, context_);
 
             // record a delete operation into the transaction
-            RmRecord delete_record{rec->size};
-            memcpy(delete_record.data, rec->data, rec->size);
+            if (txn != nullptr) {
+                txn->GetUndoBuffer()->append(fh_->GetFd(), rid, WType::DELETE_TUPLE);
+            }
+
+            // Delete from index file
+            for (size_t col_i = 0; col_i < tab_.cols.size() && !snapshot; col_i++) {
+                if (ihs[col_i] != nullptr) {
+                    ihs[col_i]->delete_entry(rec->data + tab_.cols[col_i].offset, txn);
+                }
+            }
+            // lab3 task3 Todo end
         }
         return nullptr;
     }
@@ -0,0 +1,198 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "index/ix.h"
+#include "storage/metrics.h"
+#include "system/sm.h"
+
+/**
+ * @brief 低开销计时：x86上直接读取时间戳计数器(rdtsc，约20个周期)，其他平台退化为steady_clock
+ * 周期数到时间的换算在输出时进行：第一次使用时记下(周期数, 时间)作为起点，输出时用经过的周期数除以经过的时间
+ */
+class CycleClock {
+   public:
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    /** 记下换算起点，在开始计时之前调用 */
+    static void calibrate() { anchor(); }
+
+    static double cycles_to_ms(uint64_t cycles) {
+        auto &[start_cycles, start_time] = anchor();
+        // 距起点太近时误差较大，至少等待1ms
+        std::chrono::steady_clock::duration elapsed;
+        while ((elapsed = std::chrono::steady_clock::now() - start_time) < std::chrono::milliseconds(1)) {
+        }
+        double elapsed_ms = std::chrono::duration<double, std::milli>(elapsed).count();
+        return cycles * elapsed_ms / static_cast<double>(now() - start_cycles);
+    }
+
+   private:
+    static std::pair<uint64_t, std::chrono::steady_clock::time_point> &anchor() {
+        static std::pair<uint64_t, std::chrono::steady_clock::time_point> anchor{now(),
+                                                                                  std::chrono::steady_clock::now()};
+        return anchor;
+    }
+};
+
+/**
+ * @brief EXPLAIN ANALYZE：包装一个算子，统计它输出的行数、各接口的耗时、缓冲池命中/缺页次数、等待I/O的时间和输出的字节数
+ * 计划中的每个算子都用一个ExplainAnalyzeExecutor包装即可，不需要修改各算子。
+ * 算子之间的父子关系在运行时确定：一个包装器的接口被调用时，若当前线程正在执行另一个包装器的接口，
+ * 后者就是它的父结点。耗时和缓冲池计数都包含子算子，自身耗时 = 总耗时 - 子算子耗时。
+ * 每次调用只多两次rdtsc和几次线程局部变量的读写，可以对生产环境中抽样的查询开启
+ * @note 流水线执行时工作线程中的扫描不经过算子接口，其耗时计入PipelineResultExecutor自身
+ */
+class ExplainAnalyzeExecutor : public AbstractExecutor {
+   private:
+    std::unique_ptr<AbstractExecutor> child_;
+    std::string type_;
+    double estimated_rows_ = -1;  // 优化器估计的行数，小于0表示没有估计
+
+    uint64_t rows_ = 0;
+    uint64_t bytes_ = 0;         // Next()返回的记录字节数
+    uint64_t begin_cycles_ = 0;  // beginTuple()
+    uint64_t next_cycles_ = 0;   // nextTuple()
+    uint64_t fetch_cycles_ = 0;  // Next()
+    uint64_t child_cycles_ = 0;  // 以上接口中调用子算子所花的时间
+    uint64_t page_hits_ = 0;
+    uint64_t page_misses_ = 0;
+    uint64_t io_stall_ns_ = 0;  // 缓冲池等待读盘、写回脏页和日志落盘的时间
+
+    ExplainAnalyzeExecutor *parent_ = nullptr;
+    std::vector<const ExplainAnalyzeExecutor *> children_;
+
+    static inline thread_local ExplainAnalyzeExecutor *active_ = nullptr;  // 当前线程正在执行的包装器
+
+    /** 一次接口调用的计时范围，结束时把耗时和缓冲池计数的增量记到本算子上，并从父算子的自身耗时中扣除 */
+    class Scope {
+       public:
+        Scope(ExplainAnalyzeExecutor *exec, uint64_t *cycles)
+            : exec_(exec),
+              cycles_(cycles),
+              prev_(active_),
+              hits_(MetricsRegistry::thread_value(Metric::BUFFER_POOL_HITS)),
+              misses_(MetricsRegistry::thread_value(Metric::BUFFER_POOL_MISSES)),
+              io_stall_ns_(io_stall_ns()) {
+            if (prev_ != nullptr && exec_->parent_ == nullptr && prev_ != exec_) {
+                exec_->parent_ = prev_;
+                prev_->children_.push_back(exec_);
+            }
+            active_ = exec_;
+            start_ = CycleClock::now();
+        }
+
+        ~Scope() {
+            uint64_t elapsed = CycleClock::now() - start_;
+            *cycles_ += elapsed;
+            exec_->page_hits_ += MetricsRegistry::thread_value(Metric::BUFFER_POOL_HITS) - hits_;
+            exec_->page_misses_ += MetricsRegistry::thread_value(Metric::BUFFER_POOL_MISSES) - misses_;
+            exec_->io_stall_ns_ += io_stall_ns() - io_stall_ns_;
+            if (prev_ != nullptr) {
+                prev_->child_cycles_ += elapsed;
+            }
+            active_ = prev_;
+        }
+
+       private:
+        static uint64_t io_stall_ns() {
+            return MetricsRegistry::thread_value(Metric::BUFFER_POOL_READ_STALL_NS) +
+                   MetricsRegistry::thread_value(Metric::BUFFER_POOL_WRITEBACK_STALL_NS) +
+                   MetricsRegistry::thread_value(Metric::BUFFER_POOL_WAL_STALL_NS);
+        }
+
+        ExplainAnalyzeExecutor *exec_;
+        uint64_t *cycles_;
+        ExplainAnalyzeExecutor *prev_;
+        uint64_t hits_;
+        uint64_t misses_;
+        uint64_t io_stall_ns_;
+        uint64_t start_;
+    };
+
+   public:
+    explicit ExplainAnalyzeExecutor(std::unique_ptr<AbstractExecutor> child, double estimated_rows = -1) {
+        CycleClock::calibrate();
+        child_ = std::move(child);
+        type_ = child_->getType();
+        context_ = child_->context_;
+        estimated_rows_ = estimated_rows;
+    }
+
+    /** 每sample_rate条查询返回一次true，用于只对抽样的查询开启EXPLAIN ANALYZE；sample_rate为0时从不抽样 */
+    static bool should_sample(uint64_t sample_rate) {
+        static std::atomic<uint64_t> num_queries{0};
+        return sample_rate != 0 && num_queries.fetch_add(1, std::memory_order_relaxed) % sample_rate == 0;
+    }
+
+    std::string getType() override { return type_; }
+
+    size_t tupleLen() const override { return child_->tupleLen(); }
+
+    const std::vector<ColMeta> &cols() const override { return child_->cols(); }
+
+    void beginTuple() override {
+        Scope scope(this, &begin_cycles_);
+        child_->beginTuple();
+        rows_ += !child_->is_end();
+    }
+
+    void nextTuple() override {
+        Scope scope(this, &next_cycles_);
+        child_->nextTuple();
+        rows_ += !child_->is_end();
+    }
+
+    bool is_end() const override { return child_->is_end(); }
+
+    std::unique_ptr<RmRecord> Next() override {
+        Scope scope(this, &fetch_cycles_);
+        auto rec = child_->Next();
+        if (rec != nullptr) {
+            bytes_ += rec->size;
+        }
+        return rec;
+    }
+
+    void feed(const std::map<TabCol, Value> &feed_dict) override { child_->feed(feed_dict); }
+
+    Rid &rid() override { return child_->rid(); }
+
+    /** 以本算子为根输出带统计信息的算子树 */
+    std::string to_string(int depth = 0) const {
+        uint64_t total_cycles = begin_cycles_ + next_cycles_ + fetch_cycles_;
+        std::string est;
+        if (estimated_rows_ >= 0) {
+            est = " est_rows=" + std::to_string(static_cast<uint64_t>(estimated_rows_));
+        }
+        char buf[320];
+        snprintf(buf, sizeof(buf),
+                 "%s rows=%" PRIu64 " time=%.3fms self=%.3fms (begin=%.3fms next=%.3fms fetch=%.3fms) "
+                 "pages: hit=%" PRIu64 " miss=%" PRIu64 " io_stall=%.3fms bytes=%" PRIu64 "\n",
+                 est.c_str(), rows_, CycleClock::cycles_to_ms(total_cycles),
+                 CycleClock::cycles_to_ms(total_cycles - std::min(child_cycles_, total_cycles)),
+                 CycleClock::cycles_to_ms(begin_cycles_), CycleClock::cycles_to_ms(next_cycles_),
+                 CycleClock::cycles_to_ms(fetch_cycles_), page_hits_, page_misses_, io_stall_ns_ / 1e6, bytes_);
+        std::string str = std::string(depth * 2, ' ') + type_ + buf;
+        for (auto child : children_) {
+            str += child->to_string(depth + 1);
+        }
+        return str;
+    }
+};
@@ -2,6 +2,7 @@
 
 #include "execution_defs.h"
 #include "execution_manager.h"
+#include "execution_morsel.h"
 #include "executor_abstract.h"
 #include "index/ix.h"
 #include "system/sm.h"
@@ -22,12 +23,37 @@ class IndexScanExecutor : public AbstractExecutor {
 
     SmManager *sm_manager_;
 
+    std::atomic<size_t> num_output_rows_{0};  // 实际输出的行数，用于EXPLAIN对照估计行数
+
    public:
     IndexScanExecutor(SmManager *sm_manager, std::string tab_name, std::vector<Condition> conds, int index_no,
                       Context *context) {
         // lab3 task2 todo
         // 参考seqscan作法,实现indexscan构造方法
-        // lab3 task2 todo
+        sm_manager_ = sm_manager;
+        tab_name_ = std::move(tab_name);
+        conds_ = std::move(conds);
+        index_no_ = index_no;
+        TabMeta &tab = sm_manager_->db_.get_table(tab_name_);
+        fh_ = sm_manager_->get_file_handle(tab_name_);
+        cols_ = tab.cols;
+        len_ = cols_.back().offset + cols_.back().len;
+        context_ = context;
+        std::map<CompOp, CompOp> swap_op = {
+            {OP_EQ, OP_EQ}, {OP_NE, OP_NE}, {OP_LT, OP_GT}, {OP_GT, OP_LT}, {OP_LE, OP_GE}, {OP_GE, OP_LE},
+        };
+
+        for (auto &cond : conds_) {
+            if (cond.lhs_col.tab_name != tab_name_) {
+                // lhs is on other table, now rhs must be on this table
+                assert(!cond.is_rhs_val && cond.rhs_col.tab_name == tab_name_);
+                // swap lhs and rhs
+                std::swap(cond.lhs_col, cond.rhs_col);
+                cond.op = swap_op.at(cond.op);
+            }
+        }
+        fed_conds_ = conds_;
+        // lab3 task2 todo end
     }
 
     std::string getType() { return "indexScan"; }
@@ -35,8 +61,25 @@ class IndexScanExecutor : public AbstractExecutor {
     void beginTuple() {
         check_runtime_conds();
 
+        scan_ = make_index_scan();
+        // Get the first record
+        while (!scan_->is_end()) {
+            rid_ = scan_->rid();
+            auto rec = fh_->get_visible_record(rid_, context_);
+            if (rec != nullptr && eval_conds(cols_, fed_conds_, rec.get())) {
+                num_output_rows_++;
+                break;
+            }
+            scan_->next();
+        }
+    }
+
+    /**
+     * @brief 根据fed_conds_中索引列上的条件确定[lower, upper)，构造索引迭代器
+     */
+    std::unique_ptr<RecScan> make_index_scan() {
         // index is available, scan index
-        auto ih = sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index_no_)).get();
+        auto ih = sm_manager_->get_index_handle(tab_name_, index_no_);
         Iid lower = ih->leaf_begin();
         Iid upper = ih->leaf_end();
         auto &index_col = cols_[index_no_];
@@ -46,39 +89,21 @@ class IndexScanExecutor : public AbstractExecutor {
                 if (cond.op == OP_EQ) {
                     lower = ih->lower_bound(rhs_key);
                     upper = ih->upper_bound(rhs_key);
+                } else if (cond.op == OP_GT) {
+                    lower = ih->upper_bound(rhs_key);
+                } else if (cond.op == OP_GE) {
+                    lower = ih->lower_bound(rhs_key);
+                } else if (cond.op == OP_LT) {
+                    upper = ih->lower_bound(rhs_key);
+                } else if (cond.op == OP_LE) {
+                    upper = ih->upper_bound(rhs_key);
+                } else {
+                    throw InternalError("Unexpected op type");
                 }
-
-                // lab3 task2 todo
-                /**
-                 * else if(cond.op == ?){
-                 *
-                 * }else if(){
-                 * ...
-                 * }else if(){
-                 * ...
-                 * }
-                 * ...
-                 * else{
-                 *  throw InternalError("Unexpected op type");
-                 * }
-                 *
-                 *
-                 */
-                // 利用cond 进行索引扫描
-                // lab3 task2 todo end
-                break;
-            }
-        }
-        scan_ = std::make_unique<IxScan>(ih, lower, upper, sm_manager_->get_bpm());
-        // Get the first record
-        while (!scan_->is_end()) {
-            rid_ = scan_->rid();
-            auto rec = fh_->get_record(rid_, context_);
-            if (eval_conds(cols_, fed_conds_, rec.get())) {
                 break;
             }
-            scan_->next();
         }
+        return std::make_unique<IxScan>(ih, lower, upper, sm_manager_->get_bpm());
     }
 
     void nextTuple() {
@@ -86,6 +111,14 @@ class IndexScanExecutor : public AbstractExecutor {
         assert(!is_end());
         // lab3 task2 todo
         // 扫描到下一个满足条件的记录,赋rid_,中止循环
+        for (scan_->next(); !scan_->is_end(); scan_->next()) {
+            rid_ = scan_->rid();
+            auto rec = fh_->get_visible_record(rid_, context_);
+            if (rec != nullptr && eval_conds(cols_, fed_conds_, rec.get())) {
+                num_output_rows_++;
+                break;
+            }
+        }
         // lab3 task2 todo end
     }
 
@@ -97,7 +130,7 @@ class IndexScanExecutor : public AbstractExecutor {
 
     std::unique_ptr<RmRecord> Next() override {
         assert(!is_end());
-        return fh_->get_record(rid_, context_);
+        return fh_->get_visible_record(rid_, context_);
     }
 
     void feed(const std::map<TabCol, Value> &feed_dict) override {
@@ -105,6 +138,11 @@ class IndexScanExecutor : public AbstractExecutor {
         for (auto &cond : fed_conds_) {
             // lab3 task2 todo
             // 参考seqscan
+            // 连接条件的另一侧来自外表，代入外表当前记录的值，make_index_scan()据此在索引上定位
+            if (!cond.is_rhs_val && cond.rhs_col.tab_name != tab_name_) {
+                cond.is_rhs_val = true;
+                cond.rhs_val = feed_dict.at(cond.rhs_col);
+            }
             // lab3 task2 todo end
         }
         check_runtime_conds();
@@ -112,6 +150,48 @@ class IndexScanExecutor : public AbstractExecutor {
 
     Rid &rid() override { return rid_; }
 
+    size_t num_output_rows() const { return num_output_rows_.load(); }
+
+    /**
+     * @brief 本算子的输出是否已按col升序排列
+     * 为真时优化器可以用LimitExecutor直接替代ORDER BY col LIMIT n的TopNExecutor，省去排序
+     */
+    bool is_ordered_on(const TabCol &col) const {
+        auto &index_col = cols_[index_no_];
+        return col.tab_name == tab_name_ && col.col_name == index_col.name;
+    }
+
+    /**
+     * @brief 作为流水线数据源时使用：只遍历索引叶子，按键序收集范围内的rid，不访问记录
+     */
+    void collect_rids(std::vector<Rid> *rids) {
+        check_runtime_conds();
+        for (auto scan = make_index_scan(); !scan->is_end(); scan->next()) {
+            rids->push_back(scan->rid());
+        }
+    }
+
+    /** 并行回表开始前调用(单线程)，在表上加锁，scan_morsel()中不再逐条加锁 */
+    void lock_for_scan() { fh_->lock_for_scan(context_); }
+
+    /**
+     * @brief 读取rids[morsel.page_begin, morsel.page_end)对应的记录，对满足fed_conds_的记录调用emit
+     * @note 可被多个worker并发调用，调用前须先调用lock_for_scan()
+     */
+    void scan_morsel(const std::vector<Rid> &rids, const Morsel &morsel,
+                     const std::function<void(std::unique_ptr<RmRecord>)> &emit) {
+        Transaction *txn = context_ == nullptr ? nullptr : context_->txn_;
+        size_t num_rows = 0;
+        for (int i = morsel.page_begin; i < morsel.page_end; i++) {
+            auto rec = fh_->read_visible_record(rids[i], txn);
+            if (rec != nullptr && eval_conds(cols_, fed_conds_, rec.get())) {
+                num_rows++;
+                emit(std::move(rec));
+            }
+        }
+        num_output_rows_ += num_rows;
+    }
+
     void check_runtime_conds() {
         for (auto &cond : fed_conds_) {
             assert(cond.lhs_col.tab_name == tab_name_);
@@ -8,33 +8,113 @@
 class InsertExecutor : public AbstractExecutor {
    private:
     TabMeta tab_;
-    std::vector<Value> values_;
+    std::vector<std::vector<Value>> rows_;  // 多行INSERT的每一行，单行INSERT时只有一行
     RmFileHandle *fh_;
     std::string tab_name_;
     Rid rid_;
     SmManager *sm_manager_;
 
    public:
-    InsertExecutor(SmManager *sm_manager, const std::string &tab_name, std::vector<Value> values, Context *context) {
+    InsertExecutor(SmManager *sm_manager, const std::string &tab_name, std::vector<Value> values, Context *context)
+        : InsertExecutor(sm_manager, tab_name, std::vector<std::vector<Value>>{std::move(values)}, context) {}
+
+    InsertExecutor(SmManager *sm_manager, const std::string &tab_name, std::vector<std::vector<Value>> rows,
+                   Context *context) {
         sm_manager_ = sm_manager;
         tab_ = sm_manager_->db_.get_table(tab_name);
-        values_ = values;
+        rows_ = std::move(rows);
         tab_name_ = tab_name;
-        if (values.size() != tab_.cols.size()) {
-            throw InvalidValueCountError();
+        for (auto &values : rows_) {
+            if (values.size() != tab_.cols.size()) {
+                throw InvalidValueCountError();
+            }
         }
+        sm_manager_->check_writable(tab_name);
         // Get record file handle
-        fh_ = sm_manager_->fhs_.at(tab_name).get();
+        fh_ = sm_manager_->get_file_handle(tab_name);
         context_ = context;
     };
 
     std::unique_ptr<RmRecord> Next() override {
-        // lab3 task3 Todo
-        // Make record buffer
-        // Insert into record file
-        // Insert into index
-        // lab3 task3 Todo end
+        if (rows_.empty()) {
+            return nullptr;
+        }
+        // Make record buffer，所有行连续存放
+        size_t record_size = fh_->get_file_hdr().record_size;
+        std::vector<char> bufs(record_size * rows_.size());
+        for (size_t row = 0; row < rows_.size(); row++) {
+            char *buf = bufs.data() + row * record_size;
+            for (size_t i = 0; i < rows_[row].size(); i++) {
+                auto &col = tab_.cols[i];
+                auto &val = rows_[row][i];
+                if (col.type != val.type) {
+                    throw IncompatibleTypeError(coltype2str(col.type), coltype2str(val.type));
+                }
+                val.init_raw(col.len);
+                memcpy(buf + col.offset, val.raw->data, col.len);
+            }
+        }
+        auto rids = bulk_insert(sm_manager_, tab_, fh_, bufs.data(), static_cast<int>(rows_.size()), context_);
+        rid_ = rids.back();
         return nullptr;
     }
+
     Rid &rid() override { return rid_; }
+
+    /**
+     * @brief 批量插入num_records条连续存放的记录，并维护该表上的所有索引
+     * 记录文件通过RmFileHandle::insert_records()按页填充；索引维护推迟到记录全部写入之后，
+     * 每个索引上的(key, rid)先按key排序再插入，使相邻插入落在同一叶子上，减少B+树页面的换入换出。
+     * 某个键已存在(包括同一批中的重复键)时先撤销本批已插入的索引项：
+     * 事务中的记录已登记在撤销缓冲区中，抛出TransactionAbortException使事务回滚并删除它们；
+     * 没有事务时在这里直接删除本批记录，然后抛出InternalError
+     * @note 也被LoadExecutor复用
+     */
+    static std::vector<Rid> bulk_insert(SmManager *sm_manager, const TabMeta &tab, RmFileHandle *fh,
+                                        const char *bufs, int num_records, Context *context) {
+        // Insert into record file
+        std::vector<Rid> rids = fh->insert_records(bufs, num_records, context);
+        size_t record_size = fh->get_file_hdr().record_size;
+        Transaction *txn = context == nullptr ? nullptr : context->txn_;
+        if (txn != nullptr) {
+            auto undo_buffer = txn->GetUndoBuffer();
+            for (auto &rid : rids) {
+                undo_buffer->append(fh->GetFd(), rid, WType::INSERT_TUPLE);
+            }
+        }
+        // Insert into index
+        std::vector<std::pair<IxIndexHandle *, const char *>> inserted;  // 失败时需要撤销的索引项
+        std::vector<int> order(num_records);
+        for (size_t col_i = 0; col_i < tab.cols.size(); col_i++) {
+            auto &col = tab.cols[col_i];
+            if (!col.index) {
+                continue;
+            }
+            auto ih = sm_manager->get_index_handle(tab.name, col_i);
+            auto key_of = [&](int i) { return bufs + (size_t)i * record_size + col.offset; };
+            for (int i = 0; i < num_records; i++) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+                return ix_compare(key_of(a), key_of(b), col.type, col.len) < 0;
+            });
+            for (int i : order) {
+                if (!ih->insert_entry(key_of(i), rids[i], txn)) {
+                    for (auto it = inserted.rbegin(); it != inserted.rend(); ++it) {
+                        it->first->delete_entry(it->second, txn);
+                    }
+                    if (txn != nullptr) {
+                        txn->SetState(TransactionState::ABORTED);
+                        throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DUPLICATE_KEY);
+                    }
+                    for (auto &rid : rids) {
+                        fh->delete_record(rid, context);
+                    }
+                    throw InternalError("InsertExecutor::bulk_insert: duplicate key on index of column " + col.name);
+                }
+                inserted.emplace_back(ih, key_of(i));
+            }
+        }
+        return rids;
+    }
 };
\ No newline at end of file
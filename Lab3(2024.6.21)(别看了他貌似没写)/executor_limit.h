@@ -0,0 +1,63 @@
+#pragma once
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief LIMIT/OFFSET算子
+ * 只在需要时才推进子算子：跳过offset条之后最多再取limit条，取满后不再调用prev_->nextTuple()，
+ * 因此SeqScan/IndexScan等子算子在得到足够的结果后不会继续扫描剩余的页面
+ */
+class LimitExecutor : public AbstractExecutor {
+   private:
+    std::unique_ptr<AbstractExecutor> prev_;
+    size_t limit_;
+    size_t offset_;
+    size_t count_ = 0;  // 已经输出的元组数
+
+   public:
+    LimitExecutor(std::unique_ptr<AbstractExecutor> prev, size_t limit, size_t offset = 0) {
+        prev_ = std::move(prev);
+        limit_ = limit;
+        offset_ = offset;
+    }
+
+    std::string getType() override { return "Limit"; }
+
+    size_t tupleLen() const override { return prev_->tupleLen(); }
+
+    const std::vector<ColMeta> &cols() const override { return prev_->cols(); }
+
+    void beginTuple() override {
+        count_ = 0;
+        if (limit_ == 0) {
+            return;
+        }
+        prev_->beginTuple();
+        for (size_t skipped = 0; skipped < offset_ && !prev_->is_end(); skipped++) {
+            prev_->nextTuple();
+        }
+    }
+
+    void nextTuple() override {
+        assert(!is_end());
+        count_++;
+        // 最后一条已经输出，不再推进子算子
+        if (count_ < limit_) {
+            prev_->nextTuple();
+        }
+    }
+
+    bool is_end() const override { return count_ >= limit_ || prev_->is_end(); }
+
+    std::unique_ptr<RmRecord> Next() override {
+        assert(!is_end());
+        return prev_->Next();
+    }
+
+    void feed(const std::map<TabCol, Value> &feed_dict) override { prev_->feed(feed_dict); }
+
+    Rid &rid() override { return prev_->rid(); }
+};
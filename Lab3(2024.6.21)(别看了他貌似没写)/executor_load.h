@@ -0,0 +1,107 @@
+#pragma once
+#include <fstream>
+#include <sstream>
+
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "executor_insert.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief LOAD DATA 'file' INTO table 的CSV批量导入算子
+ * 每行一条记录，列之间以','分隔，列的顺序与建表顺序一致；
+ * 每攒满LOAD_BATCH_ROWS行调用一次InsertExecutor::bulk_insert()，记录和索引均按批写入
+ */
+class LoadExecutor : public AbstractExecutor {
+   private:
+    TabMeta tab_;
+    RmFileHandle *fh_;
+    std::string tab_name_;
+    std::string file_name_;
+    SmManager *sm_manager_;
+    size_t num_loaded_ = 0;
+
+    static constexpr int LOAD_BATCH_ROWS = 4096;
+
+   public:
+    LoadExecutor(SmManager *sm_manager, const std::string &tab_name, const std::string &file_name, Context *context) {
+        sm_manager_ = sm_manager;
+        tab_ = sm_manager_->db_.get_table(tab_name);
+        tab_name_ = tab_name;
+        file_name_ = file_name;
+        sm_manager_->check_writable(tab_name);
+        fh_ = sm_manager_->get_file_handle(tab_name);
+        context_ = context;
+    }
+
+    std::string getType() override { return "Load"; }
+
+    std::unique_ptr<RmRecord> Next() override {
+        std::ifstream ifs(file_name_);
+        if (!ifs.is_open()) {
+            throw FileNotFoundError(file_name_);
+        }
+        size_t record_size = fh_->get_file_hdr().record_size;
+        std::vector<char> bufs(record_size * LOAD_BATCH_ROWS);
+        int num_rows = 0;
+        std::string line;
+        while (std::getline(ifs, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty()) {
+                continue;
+            }
+            parse_line(line, bufs.data() + (size_t)num_rows * record_size);
+            if (++num_rows == LOAD_BATCH_ROWS) {
+                InsertExecutor::bulk_insert(sm_manager_, tab_, fh_, bufs.data(), num_rows, context_);
+                num_loaded_ += num_rows;
+                num_rows = 0;
+            }
+        }
+        if (num_rows > 0) {
+            InsertExecutor::bulk_insert(sm_manager_, tab_, fh_, bufs.data(), num_rows, context_);
+            num_loaded_ += num_rows;
+        }
+        return nullptr;
+    }
+
+    /** 已导入的行数 */
+    size_t num_loaded() const { return num_loaded_; }
+
+    Rid &rid() override { return _abstract_rid; }
+
+   private:
+    /** 把一行CSV解析为一条记录，写入buf */
+    void parse_line(const std::string &line, char *buf) {
+        std::stringstream ss(line);
+        std::string field;
+        memset(buf, 0, fh_->get_file_hdr().record_size);
+        for (size_t i = 0; i < tab_.cols.size(); i++) {
+            if (!std::getline(ss, field, ',')) {
+                throw InvalidValueCountError();
+            }
+            auto &col = tab_.cols[i];
+            Value val;
+            try {
+                if (col.type == TYPE_INT) {
+                    val.set_int(std::stoi(field));
+                } else if (col.type == TYPE_FLOAT) {
+                    val.set_float(std::stof(field));
+                } else {
+                    val.set_str(field);
+                }
+            } catch (std::logic_error &e) {
+                // std::stoi/std::stof解析失败
+                throw IncompatibleTypeError(coltype2str(col.type), field);
+            }
+            val.init_raw(col.len);
+            memcpy(buf + col.offset, val.raw->data, col.len);
+        }
+        if (std::getline(ss, field, ',')) {
+            throw InvalidValueCountError();
+        }
+    }
+};
@@ -0,0 +1,568 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "execution_morsel.h"
+#include "executor_abstract.h"
+#include "executor_index_scan.h"
+#include "executor_projection.h"
+#include "executor_seq_scan.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief 以SeqScanExecutor作为流水线数据源，按数据页切分morsel
+ * prepare()时先在表上加锁，worker读取记录时不再访问事务的锁集和读集
+ */
+class SeqScanSource : public PipelineSource {
+   private:
+    SeqScanExecutor *scan_;
+    size_t morsel_size_ = 0;
+    int num_pages_ = 0;
+
+   public:
+    explicit SeqScanSource(SeqScanExecutor *scan) : scan_(scan) {}
+
+    const std::vector<ColMeta> &cols() const override { return scan_->cols(); }
+
+    size_t tupleLen() const override { return scan_->tupleLen(); }
+
+    size_t prepare(size_t morsel_size) override {
+        scan_->lock_for_scan();
+        morsel_size_ = morsel_size;
+        num_pages_ = scan_->num_pages();
+        return (num_pages_ + morsel_size_ - 1) / morsel_size_;
+    }
+
+    void scan_morsel(size_t morsel_idx, const std::function<void(std::unique_ptr<RmRecord>)> &emit) override {
+        int page_begin = static_cast<int>(morsel_idx * morsel_size_);
+        int page_end = std::min(page_begin + static_cast<int>(morsel_size_), num_pages_);
+        scan_->scan_morsel({page_begin, page_end}, emit);
+    }
+};
+
+/**
+ * @brief 以IndexScanExecutor作为流水线数据源
+ * prepare()时单线程遍历索引叶子得到rid序列，之后按rid下标切分morsel并行回表
+ */
+class IndexScanSource : public PipelineSource {
+   private:
+    IndexScanExecutor *scan_;
+    std::vector<Rid> rids_;
+    size_t morsel_size_ = 0;
+
+   public:
+    explicit IndexScanSource(IndexScanExecutor *scan) : scan_(scan) {}
+
+    const std::vector<ColMeta> &cols() const override { return scan_->cols(); }
+
+    size_t tupleLen() const override { return scan_->tupleLen(); }
+
+    size_t prepare(size_t morsel_size) override {
+        // 一个morsel包含的rid数与一页能容纳的记录数同量级
+        morsel_size_ = morsel_size * std::max<size_t>(PAGE_SIZE / std::max<size_t>(scan_->tupleLen(), 1), 1);
+        scan_->lock_for_scan();
+        rids_.clear();
+        scan_->collect_rids(&rids_);
+        return (rids_.size() + morsel_size_ - 1) / morsel_size_;
+    }
+
+    void scan_morsel(size_t morsel_idx, const std::function<void(std::unique_ptr<RmRecord>)> &emit) override {
+        int begin = static_cast<int>(morsel_idx * morsel_size_);
+        int end = static_cast<int>(std::min(begin + morsel_size_, rids_.size()));
+        scan_->scan_morsel(rids_, {begin, end}, emit);
+    }
+};
+
+/**
+ * @brief 以上一条流水线物化的结果作为数据源(用于pipeline breaker之后的流水线)
+ */
+class MaterializedSource : public PipelineSource {
+   private:
+    std::vector<ColMeta> cols_;
+    size_t len_;
+    const std::vector<std::unique_ptr<RmRecord>> *rows_;
+    size_t morsel_size_ = 0;
+
+   public:
+    MaterializedSource(std::vector<ColMeta> cols, size_t len, const std::vector<std::unique_ptr<RmRecord>> *rows)
+        : cols_(std::move(cols)), len_(len), rows_(rows) {}
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    size_t tupleLen() const override { return len_; }
+
+    size_t prepare(size_t morsel_size) override {
+        morsel_size_ = morsel_size * std::max<size_t>(PAGE_SIZE / std::max<size_t>(len_, 1), 1);
+        return (rows_->size() + morsel_size_ - 1) / morsel_size_;
+    }
+
+    void scan_morsel(size_t morsel_idx, const std::function<void(std::unique_ptr<RmRecord>)> &emit) override {
+        size_t begin = morsel_idx * morsel_size_;
+        size_t end = std::min(begin + morsel_size_, rows_->size());
+        for (size_t i = begin; i < end; i++) {
+            auto rec = std::make_unique<RmRecord>(len_);
+            memcpy(rec->data, (*rows_)[i]->data, len_);
+            emit(std::move(rec));
+        }
+    }
+};
+
+/**
+ * @brief 过滤算子，对元组计算conds(合取)
+ */
+class FilterStage : public PipelineStage {
+   private:
+    std::vector<ColMeta> cols_;
+    size_t len_;
+    std::vector<Condition> conds_;
+
+   public:
+    FilterStage(std::vector<ColMeta> cols, size_t len, std::vector<Condition> conds)
+        : cols_(std::move(cols)), len_(len), conds_(std::move(conds)) {}
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    size_t tupleLen() const override { return len_; }
+
+    void execute(std::unique_ptr<RmRecord> rec, int worker_id,
+                 const std::function<void(std::unique_ptr<RmRecord>)> &emit) override {
+        for (auto &cond : conds_) {
+            if (!eval_cond(cond, rec.get())) {
+                return;
+            }
+        }
+        emit(std::move(rec));
+    }
+
+   private:
+    const ColMeta &find_col(const TabCol &target) const {
+        for (auto &col : cols_) {
+            if (col.tab_name == target.tab_name && col.name == target.col_name) {
+                return col;
+            }
+        }
+        throw ColumnNotFoundError(target.tab_name + '.' + target.col_name);
+    }
+
+    bool eval_cond(const Condition &cond, const RmRecord *rec) const {
+        auto &lhs_col = find_col(cond.lhs_col);
+        char *lhs = rec->data + lhs_col.offset;
+        char *rhs = cond.is_rhs_val ? cond.rhs_val.raw->data : rec->data + find_col(cond.rhs_col).offset;
+        int cmp = ix_compare(lhs, rhs, lhs_col.type, lhs_col.len);
+        switch (cond.op) {
+            case OP_EQ: return cmp == 0;
+            case OP_NE: return cmp != 0;
+            case OP_LT: return cmp < 0;
+            case OP_GT: return cmp > 0;
+            case OP_LE: return cmp <= 0;
+            case OP_GE: return cmp >= 0;
+            default: throw InternalError("Unexpected op type");
+        }
+    }
+};
+
+/**
+ * @brief 以ProjectionExecutor作为流水线算子，只复用其列信息与project()，不驱动其子算子
+ */
+class ProjectionStage : public PipelineStage {
+   private:
+    ProjectionExecutor *proj_;
+
+   public:
+    explicit ProjectionStage(ProjectionExecutor *proj) : proj_(proj) {}
+
+    const std::vector<ColMeta> &cols() const override { return proj_->cols(); }
+
+    size_t tupleLen() const override { return proj_->tupleLen(); }
+
+    void execute(std::unique_ptr<RmRecord> rec, int worker_id,
+                 const std::function<void(std::unique_ptr<RmRecord>)> &emit) override {
+        emit(proj_->project(rec.get()));
+    }
+};
+
+/**
+ * @brief 物化sink，也是最终结果的收集点
+ */
+class MaterializeSink : public PipelineSink {
+   private:
+    std::vector<std::vector<std::unique_ptr<RmRecord>>> local_rows_;  // 每个worker的局部结果
+    std::vector<std::unique_ptr<RmRecord>> rows_;
+
+   public:
+    void init(size_t num_workers) override {
+        local_rows_.clear();
+        local_rows_.resize(num_workers);
+        rows_.clear();
+    }
+
+    void consume(std::unique_ptr<RmRecord> rec, int worker_id) override {
+        local_rows_[worker_id].push_back(std::move(rec));
+    }
+
+    void finalize() override {
+        for (auto &local : local_rows_) {
+            for (auto &rec : local) {
+                rows_.push_back(std::move(rec));
+            }
+        }
+        local_rows_.clear();
+    }
+
+    std::vector<std::unique_ptr<RmRecord>> &rows() { return rows_; }
+};
+
+/**
+ * @brief hash join的build端(pipeline breaker)：各worker先建局部哈希表，finalize时合并成一张
+ */
+class HashBuildSink : public PipelineSink {
+   private:
+    std::vector<ColMeta> cols_;
+    size_t len_;
+    ColMeta key_col_;
+    std::vector<std::unordered_multimap<std::string, std::unique_ptr<RmRecord>>> local_tables_;
+    std::unordered_multimap<std::string, std::unique_ptr<RmRecord>> table_;
+
+   public:
+    HashBuildSink(std::vector<ColMeta> cols, size_t len, const ColMeta &key_col)
+        : cols_(std::move(cols)), len_(len), key_col_(key_col) {}
+
+    const std::vector<ColMeta> &cols() const { return cols_; }
+
+    size_t tupleLen() const { return len_; }
+
+    const ColMeta &key_col() const { return key_col_; }
+
+    void init(size_t num_workers) override {
+        local_tables_.clear();
+        local_tables_.resize(num_workers);
+        table_.clear();
+    }
+
+    void consume(std::unique_ptr<RmRecord> rec, int worker_id) override {
+        std::string key(rec->data + key_col_.offset, key_col_.len);
+        local_tables_[worker_id].emplace(std::move(key), std::move(rec));
+    }
+
+    void finalize() override {
+        size_t total = 0;
+        for (auto &local : local_tables_) {
+            total += local.size();
+        }
+        table_.reserve(total);
+        for (auto &local : local_tables_) {
+            for (auto &entry : local) {
+                table_.emplace(entry.first, std::move(entry.second));
+            }
+        }
+        local_tables_.clear();
+    }
+
+    /** finalize之后只读，可被probe端并发访问 */
+    const std::unordered_multimap<std::string, std::unique_ptr<RmRecord>> &table() const { return table_; }
+};
+
+/**
+ * @brief hash join的probe端：输出(probe元组, build元组)拼接结果，列顺序与NestedLoopJoinExecutor一致(左=probe)
+ */
+class HashProbeStage : public PipelineStage {
+   private:
+    const HashBuildSink *build_;
+    ColMeta probe_col_;
+    size_t probe_len_;
+    std::vector<ColMeta> cols_;
+    size_t len_;
+
+   public:
+    HashProbeStage(const HashBuildSink *build, const std::vector<ColMeta> &probe_cols, size_t probe_len,
+                   const ColMeta &probe_col)
+        : build_(build), probe_col_(probe_col), probe_len_(probe_len) {
+        cols_ = probe_cols;
+        for (auto col : build_->cols()) {
+            col.offset += probe_len_;
+            cols_.push_back(col);
+        }
+        len_ = probe_len_ + build_->tupleLen();
+    }
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    size_t tupleLen() const override { return len_; }
+
+    void execute(std::unique_ptr<RmRecord> rec, int worker_id,
+                 const std::function<void(std::unique_ptr<RmRecord>)> &emit) override {
+        std::string key(rec->data + probe_col_.offset, probe_col_.len);
+        auto range = build_->table().equal_range(key);
+        for (auto it = range.first; it != range.second; ++it) {
+            auto joined = std::make_unique<RmRecord>(len_);
+            memcpy(joined->data, rec->data, probe_len_);
+            memcpy(joined->data + probe_len_, it->second->data, build_->tupleLen());
+            emit(std::move(joined));
+        }
+    }
+};
+
+enum class AggType { COUNT, SUM, MIN, MAX, AVG };
+
+struct AggExpr {
+    AggType type;
+    TabCol col;  // COUNT时可以不指定列
+    std::string alias;
+};
+
+/**
+ * @brief 分组聚合(pipeline breaker)：各worker维护局部哈希聚合表，finalize时合并
+ * 输出列为分组列 + 各聚合列(COUNT为int，其余为float)
+ */
+class AggregateSink : public PipelineSink {
+   private:
+    struct AggState {
+        double sum = 0;
+        double min = 0;
+        double max = 0;
+        int count = 0;
+    };
+
+    std::vector<ColMeta> in_cols_;
+    std::vector<ColMeta> group_cols_;  // 输入中的分组列
+    std::vector<AggExpr> aggs_;
+    std::vector<const ColMeta *> agg_in_cols_;  // 每个聚合对应的输入列，COUNT(*)为nullptr
+    std::vector<ColMeta> cols_;                 // 输出列
+    size_t len_ = 0;
+    std::vector<std::unordered_map<std::string, std::vector<AggState>>> local_groups_;
+    std::vector<std::unique_ptr<RmRecord>> rows_;
+
+   public:
+    AggregateSink(const std::vector<ColMeta> &in_cols, const std::vector<TabCol> &group_by,
+                  std::vector<AggExpr> aggs)
+        : in_cols_(in_cols), aggs_(std::move(aggs)) {
+        for (auto &target : group_by) {
+            auto &col = find_col(target);
+            group_cols_.push_back(col);
+            ColMeta out = col;
+            out.offset = len_;
+            len_ += out.len;
+            cols_.push_back(out);
+        }
+        for (auto &agg : aggs_) {
+            agg_in_cols_.push_back(agg.col.col_name.empty() ? nullptr : &find_col(agg.col));
+            ColMeta out = {.tab_name = "",
+                           .name = agg.alias,
+                           .type = agg.type == AggType::COUNT ? TYPE_INT : TYPE_FLOAT,
+                           .len = agg.type == AggType::COUNT ? (int)sizeof(int) : (int)sizeof(float),
+                           .offset = (int)len_,
+                           .index = false};
+            len_ += out.len;
+            cols_.push_back(out);
+        }
+    }
+
+    const std::vector<ColMeta> &cols() const { return cols_; }
+
+    size_t tupleLen() const { return len_; }
+
+    void init(size_t num_workers) override {
+        local_groups_.clear();
+        local_groups_.resize(num_workers);
+        rows_.clear();
+    }
+
+    void consume(std::unique_ptr<RmRecord> rec, int worker_id) override {
+        std::string key;
+        for (auto &col : group_cols_) {
+            key.append(rec->data + col.offset, col.len);
+        }
+        auto &states = local_groups_[worker_id][key];
+        if (states.empty()) {
+            states.resize(aggs_.size());
+        }
+        for (size_t i = 0; i < aggs_.size(); i++) {
+            auto &state = states[i];
+            if (agg_in_cols_[i] == nullptr) {
+                state.count++;
+                continue;
+            }
+            double val = get_numeric(*agg_in_cols_[i], rec.get());
+            state.min = state.count == 0 ? val : std::min(state.min, val);
+            state.max = state.count == 0 ? val : std::max(state.max, val);
+            state.sum += val;
+            state.count++;
+        }
+    }
+
+    void finalize() override {
+        // 将所有worker的局部聚合结果合并到第0个worker
+        auto &merged = local_groups_[0];
+        for (size_t w = 1; w < local_groups_.size(); w++) {
+            for (auto &entry : local_groups_[w]) {
+                auto it = merged.find(entry.first);
+                if (it == merged.end()) {
+                    merged.emplace(entry.first, std::move(entry.second));
+                    continue;
+                }
+                for (size_t i = 0; i < aggs_.size(); i++) {
+                    auto &dst = it->second[i];
+                    auto &src = entry.second[i];
+                    if (src.count == 0) {
+                        continue;
+                    }
+                    dst.min = dst.count == 0 ? src.min : std::min(dst.min, src.min);
+                    dst.max = dst.count == 0 ? src.max : std::max(dst.max, src.max);
+                    dst.sum += src.sum;
+                    dst.count += src.count;
+                }
+            }
+        }
+        if (group_cols_.empty() && merged.empty()) {
+            // 没有GROUP BY时输入为空也输出一行：COUNT为0，其余聚合没有NULL可用，输出0
+            merged[""].resize(aggs_.size());
+        }
+        for (auto &entry : merged) {
+            auto rec = std::make_unique<RmRecord>(len_);
+            memcpy(rec->data, entry.first.data(), entry.first.size());
+            for (size_t i = 0; i < aggs_.size(); i++) {
+                auto &state = entry.second[i];
+                auto &out = cols_[group_cols_.size() + i];
+                if (aggs_[i].type == AggType::COUNT) {
+                    *(int *)(rec->data + out.offset) = state.count;
+                    continue;
+                }
+                double val = 0;
+                if (aggs_[i].type == AggType::SUM) {
+                    val = state.sum;
+                } else if (aggs_[i].type == AggType::MIN) {
+                    val = state.min;
+                } else if (aggs_[i].type == AggType::MAX) {
+                    val = state.max;
+                } else if (aggs_[i].type == AggType::AVG) {
+                    val = state.count == 0 ? 0 : state.sum / state.count;
+                }
+                *(float *)(rec->data + out.offset) = static_cast<float>(val);
+            }
+            rows_.push_back(std::move(rec));
+        }
+        local_groups_.clear();
+    }
+
+    std::vector<std::unique_ptr<RmRecord>> &rows() { return rows_; }
+
+   private:
+    const ColMeta &find_col(const TabCol &target) const {
+        for (auto &col : in_cols_) {
+            if (col.tab_name == target.tab_name && col.name == target.col_name) {
+                return col;
+            }
+        }
+        throw ColumnNotFoundError(target.tab_name + '.' + target.col_name);
+    }
+
+    static double get_numeric(const ColMeta &col, const RmRecord *rec) {
+        if (col.type == TYPE_INT) {
+            return *(int *)(rec->data + col.offset);
+        } else if (col.type == TYPE_FLOAT) {
+            return *(float *)(rec->data + col.offset);
+        }
+        throw IncompatibleTypeError(coltype2str(col.type), "numeric");
+    }
+};
+
+/**
+ * @brief 排序(pipeline breaker)：各worker收集局部run，finalize时排序后归并
+ */
+class SortSink : public PipelineSink {
+   private:
+    std::vector<ColMeta> sort_cols_;
+    bool is_desc_;
+    std::vector<std::vector<std::unique_ptr<RmRecord>>> local_runs_;
+    std::vector<std::unique_ptr<RmRecord>> rows_;
+
+   public:
+    SortSink(const std::vector<ColMeta> &in_cols, const std::vector<TabCol> &order_by, bool is_desc)
+        : is_desc_(is_desc) {
+        for (auto &target : order_by) {
+            auto pos = std::find_if(in_cols.begin(), in_cols.end(), [&](const ColMeta &col) {
+                return col.tab_name == target.tab_name && col.name == target.col_name;
+            });
+            if (pos == in_cols.end()) {
+                throw ColumnNotFoundError(target.tab_name + '.' + target.col_name);
+            }
+            sort_cols_.push_back(*pos);
+        }
+    }
+
+    void init(size_t num_workers) override {
+        local_runs_.clear();
+        local_runs_.resize(num_workers);
+        rows_.clear();
+    }
+
+    void consume(std::unique_ptr<RmRecord> rec, int worker_id) override {
+        local_runs_[worker_id].push_back(std::move(rec));
+    }
+
+    void finalize() override {
+        auto less = [&](const std::unique_ptr<RmRecord> &a, const std::unique_ptr<RmRecord> &b) {
+            for (auto &col : sort_cols_) {
+                int cmp = ix_compare(a->data + col.offset, b->data + col.offset, col.type, col.len);
+                if (cmp != 0) {
+                    return is_desc_ ? cmp > 0 : cmp < 0;
+                }
+            }
+            return false;
+        };
+        // 逐个run排序后与已有结果归并
+        for (auto &run : local_runs_) {
+            std::sort(run.begin(), run.end(), less);
+            size_t mid = rows_.size();
+            for (auto &rec : run) {
+                rows_.push_back(std::move(rec));
+            }
+            std::inplace_merge(rows_.begin(), rows_.begin() + mid, rows_.end(), less);
+        }
+        local_runs_.clear();
+    }
+
+    std::vector<std::unique_ptr<RmRecord>> &rows() { return rows_; }
+};
+
+/**
+ * @brief 把流水线最终物化的结果包装成普通的AbstractExecutor，以便接入现有的执行/输出流程
+ */
+class PipelineResultExecutor : public AbstractExecutor {
+   private:
+    std::vector<ColMeta> cols_;
+    size_t len_;
+    std::vector<std::unique_ptr<RmRecord>> rows_;
+    size_t pos_ = 0;
+
+   public:
+    PipelineResultExecutor(std::vector<ColMeta> cols, size_t len, std::vector<std::unique_ptr<RmRecord>> rows)
+        : cols_(std::move(cols)), len_(len), rows_(std::move(rows)) {}
+
+    std::string getType() override { return "PipelineResult"; }
+
+    size_t tupleLen() const override { return len_; }
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    void beginTuple() override { pos_ = 0; }
+
+    void nextTuple() override {
+        assert(!is_end());
+        pos_++;
+    }
+
+    bool is_end() const override { return pos_ >= rows_.size(); }
+
+    std::unique_ptr<RmRecord> Next() override {
+        assert(!is_end());
+        auto rec = std::make_unique<RmRecord>(len_);
+        memcpy(rec->data, rows_[pos_]->data, len_);
+        return rec;
+    }
+
+    Rid &rid() override { return _abstract_rid; }
+};
@@ -46,17 +46,22 @@ class ProjectionExecutor : public AbstractExecutor {
 
     std::unique_ptr<RmRecord> Next() override {
         assert(!is_end());
-        auto &prev_cols = prev_->cols();
         auto prev_rec = prev_->Next();
+        return project(prev_rec.get());
+    }
+
+    /**
+     * @brief 从子算子输出的一条记录中投影出目标列，不推进子算子，可作为流水线算子并发调用
+     */
+    std::unique_ptr<RmRecord> project(const RmRecord *prev_rec) const {
+        auto &prev_cols = prev_->cols();
         auto &proj_cols = cols_;
         auto proj_rec = std::make_unique<RmRecord>(len_);
         for (size_t proj_idx = 0; proj_idx < proj_cols.size(); proj_idx++) {
             size_t prev_idx = sel_idxs_[proj_idx];
             auto &prev_col = prev_cols[prev_idx];
             auto &proj_col = proj_cols[proj_idx];
-            // lab3 task2 Todo
-            // 利用memcpy生成proj_rec
-            // lab3 task2 Todo End
+            memcpy(proj_rec->data + proj_col.offset, prev_rec->data + prev_col.offset, proj_col.len);
         }
         return proj_rec;
     }
@@ -2,6 +2,7 @@
 
 #include "execution_defs.h"
 #include "execution_manager.h"
+#include "execution_morsel.h"
 #include "executor_abstract.h"
 #include "index/ix.h"
 #include "system/sm.h"
@@ -20,13 +21,15 @@ class SeqScanExecutor : public AbstractExecutor {
 
     SmManager *sm_manager_;
 
+    std::atomic<size_t> num_output_rows_{0};  // 实际输出的行数，用于EXPLAIN对照估计行数
+
    public:
     SeqScanExecutor(SmManager *sm_manager, std::string tab_name, std::vector<Condition> conds, Context *context) {
         sm_manager_ = sm_manager;
         tab_name_ = std::move(tab_name);
         conds_ = std::move(conds);
         TabMeta &tab = sm_manager_->db_.get_table(tab_name_);
-        fh_ = sm_manager_->fhs_.at(tab_name_).get();
+        fh_ = sm_manager_->get_file_handle(tab_name_);
         cols_ = tab.cols;
         len_ = cols_.back().offset + cols_.back().len;
         context_ = context;
@@ -61,10 +64,15 @@ class SeqScanExecutor : public AbstractExecutor {
         while (!scan_->is_end()) {
             rid_ = scan_->rid();
             try {
-                auto rec = fh_->get_record(rid_, context_);  // TableHeap->GetTuple() 当前扫描到的记录
+                // TableHeap->GetTuple() 当前扫描到的记录中对本事务可见的版本
+                auto rec = fh_->get_visible_record(rid_, context_);
                 // lab3 task2 todo
                 // 利用eval_conds判断是否当前记录(rec.get())满足谓词条件
                 // 满足则中止循环
+                if (rec != nullptr && eval_conds(cols_, fed_conds_, rec.get())) {
+                    num_output_rows_++;
+                    break;
+                }
                 // lab3 task2 todo end
             } catch (RecordNotFoundError &e) {
                 std::cerr << e.what() << std::endl;
@@ -82,6 +90,12 @@ class SeqScanExecutor : public AbstractExecutor {
             // 获取当前记录(参考beginTuple())赋给算子成员rid_
             // 利用eval_conds判断是否当前记录(rec.get())满足谓词条件
             // 满足则中止循环
+            rid_ = scan_->rid();
+            auto rec = fh_->get_visible_record(rid_, context_);
+            if (rec != nullptr && eval_conds(cols_, fed_conds_, rec.get())) {
+                num_output_rows_++;
+                break;
+            }
             // lab3 task2 todo End
         }
     }
@@ -95,6 +109,7 @@ class SeqScanExecutor : public AbstractExecutor {
     std::unique_ptr<RmRecord> Next() override {
         // lab3 task2 todo
         // 利用fh_得到记录record
+        return fh_->get_visible_record(rid_, context_);
         // lab3 task2 todo end
     }
 
@@ -116,6 +131,40 @@ class SeqScanExecutor : public AbstractExecutor {
 
     Rid &rid() override { return rid_; }
 
+    size_t num_output_rows() const { return num_output_rows_.load(); }
+
+    /** 记录文件中的数据页数(含文件头页)，用于morsel切分 */
+    int num_pages() const { return fh_->get_file_hdr().num_pages; }
+
+    /** 并行扫描开始前调用(单线程)，在表上加锁，scan_morsel()中不再逐条加锁 */
+    void lock_for_scan() { fh_->lock_for_scan(context_); }
+
+    /**
+     * @brief 作为流水线数据源时使用：扫描[morsel.page_begin, morsel.page_end)内的所有记录，
+     * 对满足fed_conds_的记录调用emit。不修改rid_/scan_，可被多个worker并发调用
+     * @note 调用前须先调用lock_for_scan()
+     */
+    void scan_morsel(const Morsel &morsel, const std::function<void(std::unique_ptr<RmRecord>)> &emit) {
+        int num_slots = fh_->get_file_hdr().num_records_per_page;
+        Transaction *txn = context_ == nullptr ? nullptr : context_->txn_;
+        size_t num_rows = 0;
+        for (int page_no = std::max(morsel.page_begin, RM_FIRST_RECORD_PAGE); page_no < morsel.page_end; page_no++) {
+            RmPageHandle page_handle = fh_->fetch_page_handle(page_no);
+            for (int slot_no = Bitmap::first_bit(true, page_handle.bitmap, num_slots); slot_no < num_slots;
+                 slot_no = Bitmap::next_bit(true, page_handle.bitmap, num_slots, slot_no)) {
+                auto rec = std::make_unique<RmRecord>(len_);
+                memcpy(rec->data, page_handle.get_slot(slot_no), len_);
+                rec = fh_->get_version_store()->read(Rid{page_no, slot_no}, txn, std::move(rec));
+                if (rec != nullptr && eval_conds(cols_, fed_conds_, rec.get())) {
+                    num_rows++;
+                    emit(std::move(rec));
+                }
+            }
+            sm_manager_->get_bpm()->UnpinPage(page_handle.page->GetPageId(), false);
+        }
+        num_output_rows_ += num_rows;
+    }
+
     void check_runtime_conds() {
         for (auto &cond : fed_conds_) {
             assert(cond.lhs_col.tab_name == tab_name_);
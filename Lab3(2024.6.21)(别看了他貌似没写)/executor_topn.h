@@ -0,0 +1,110 @@
+#pragma once
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "executor_index_scan.h"
+#include "executor_limit.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief ORDER BY ... LIMIT n [OFFSET m] 的Top-N算子
+ * 从子算子拉取元组时只维护一个大小为n+m的堆(堆顶为当前保留元组中排序最靠后的一条)，
+ * 内存占用为O(n+m)而不是O(表大小)，比较次数为O(N log(n+m))
+ */
+class TopNExecutor : public AbstractExecutor {
+   private:
+    std::unique_ptr<AbstractExecutor> prev_;
+    std::vector<ColMeta> order_cols_;  // 排序列(在子算子输出中的位置)
+    bool is_desc_;
+    size_t limit_;
+    size_t offset_;
+
+    std::vector<std::unique_ptr<RmRecord>> heap_;  // beginTuple()后为按序排列的结果
+    size_t pos_ = 0;
+
+   public:
+    TopNExecutor(std::unique_ptr<AbstractExecutor> prev, const std::vector<TabCol> &order_cols, bool is_desc,
+                 size_t limit, size_t offset = 0) {
+        prev_ = std::move(prev);
+        for (auto &order_col : order_cols) {
+            order_cols_.push_back(*get_col(prev_->cols(), order_col));
+        }
+        is_desc_ = is_desc;
+        limit_ = limit;
+        offset_ = offset;
+    }
+
+    std::string getType() override { return "TopN"; }
+
+    size_t tupleLen() const override { return prev_->tupleLen(); }
+
+    const std::vector<ColMeta> &cols() const override { return prev_->cols(); }
+
+    void beginTuple() override {
+        heap_.clear();
+        size_t capacity = limit_ + offset_;
+        if (limit_ > 0) {
+            auto less = [&](const std::unique_ptr<RmRecord> &a, const std::unique_ptr<RmRecord> &b) {
+                return compare(a.get(), b.get()) < 0;
+            };
+            heap_.reserve(capacity);
+            for (prev_->beginTuple(); !prev_->is_end(); prev_->nextTuple()) {
+                auto rec = prev_->Next();
+                if (heap_.size() < capacity) {
+                    heap_.push_back(std::move(rec));
+                    std::push_heap(heap_.begin(), heap_.end(), less);
+                } else if (compare(rec.get(), heap_.front().get()) < 0) {
+                    // 比当前保留的最后一名更靠前，替换堆顶
+                    std::pop_heap(heap_.begin(), heap_.end(), less);
+                    heap_.back() = std::move(rec);
+                    std::push_heap(heap_.begin(), heap_.end(), less);
+                }
+            }
+            std::sort_heap(heap_.begin(), heap_.end(), less);
+        }
+        pos_ = offset_;
+    }
+
+    void nextTuple() override {
+        assert(!is_end());
+        pos_++;
+    }
+
+    bool is_end() const override { return pos_ >= heap_.size(); }
+
+    std::unique_ptr<RmRecord> Next() override {
+        assert(!is_end());
+        auto &rec = heap_[pos_];
+        return std::make_unique<RmRecord>(rec->size, rec->data);
+    }
+
+    Rid &rid() override { return _abstract_rid; }
+
+   private:
+    /** @return <0表示a应排在b之前 */
+    int compare(const RmRecord *a, const RmRecord *b) const {
+        for (auto &col : order_cols_) {
+            int cmp = ix_compare(a->data + col.offset, b->data + col.offset, col.type, col.len);
+            if (cmp != 0) {
+                return is_desc_ ? -cmp : cmp;
+            }
+        }
+        return 0;
+    }
+};
+
+/**
+ * @brief 为ORDER BY ... LIMIT构造执行算子
+ * 如果子算子是在单个排序列上有序的IndexScan并且为升序，则直接用LimitExecutor截断，
+ * 既不需要排序也能在取满limit条后停止扫描；否则使用TopNExecutor
+ */
+inline std::unique_ptr<AbstractExecutor> make_order_by_limit(std::unique_ptr<AbstractExecutor> prev,
+                                                             const std::vector<TabCol> &order_cols, bool is_desc,
+                                                             size_t limit, size_t offset = 0) {
+    auto index_scan = dynamic_cast<IndexScanExecutor *>(prev.get());
+    if (index_scan != nullptr && !is_desc && order_cols.size() == 1 && index_scan->is_ordered_on(order_cols[0])) {
+        return std::make_unique<LimitExecutor>(std::move(prev), limit, offset);
+    }
+    return std::make_unique<TopNExecutor>(std::move(prev), order_cols, is_desc, limit, offset);
+}
@@ -22,7 +22,8 @@ class UpdateExecutor : public AbstractExecutor {
         tab_name_ = tab_name;
         set_clauses_ = set_clauses;
         tab_ = sm_manager_->db_.get_table(tab_name);
-        fh_ = sm_manager_->fhs_.at(tab_name).get();
+        sm_manager_->check_writable(tab_name);
+        fh_ = sm_manager_->get_file_handle(tab_name);
         conds_ = conds;
         rids_ = rids;
         context_ = context;
@@ -36,26 +37,48 @@ class UpdateExecutor : public AbstractExecutor {
                 size_t lhs_col_idx = lhs_col - tab_.cols.begin();
                 // lab3 task3 Todo
                 // 获取需要的索引句柄,填充vector ihs
+                ihs[lhs_col_idx] = sm_manager_->get_index_handle(tab_name_, lhs_col_idx);
                 // lab3 task3 Todo end
             }
         }
+        // 类型检查提前到修改任何记录之前
+        for (auto &set_clause : set_clauses_) {
+            auto lhs_col = tab_.get_col(set_clause.lhs.col_name);
+            if (lhs_col->type != set_clause.rhs.type) {
+                throw IncompatibleTypeError(coltype2str(lhs_col->type), coltype2str(set_clause.rhs.type));
+            }
+        }
         // Update each rid from record file and index file
+        // 先修改记录文件：update_record()可能因写写冲突或记录不存在而抛出异常，此时索引和撤销缓冲区都还没有改动；
+        // 修改成功后立即登记撤销条目，之后再维护索引，回滚时据此同时恢复记录和索引
         for (auto &rid : rids_) {
             auto rec = fh_->get_record(rid, context_);
+            Transaction *txn = context_ == nullptr ? nullptr : context_->txn_;
             // lab3 task3 Todo
-            // Remove old entry from index
+            // Update record in record file
+            auto new_rec = std::make_unique<RmRecord>(*rec);
+            for (auto &set_clause : set_clauses_) {
+                auto lhs_col = tab_.get_col(set_clause.lhs.col_name);
+                auto &val = set_clause.rhs;
+                val.init_raw(lhs_col->len);
+                memcpy(new_rec->data + lhs_col->offset, val.raw->data, lhs_col->len);
+            }
+            fh_->update_record(rid, new_rec->data, context_);
             // lab3 task3 Todo end
 
             // record a update operation into the transaction
-            RmRecord update_record{rec->size};
-            memcpy(update_record.data, rec->data, rec->size);
-
-            // lab3 task3 Todo
-            // Update record in record file
-            // lab3 task3 Todo end
+            if (txn != nullptr) {
+                txn->GetUndoBuffer()->append(fh_->GetFd(), rid, WType::UPDATE_TUPLE);
+            }
 
             // lab3 task3 Todo
-            // Insert new entry into index
+            // Remove old entry from index, insert new entry into index
+            for (size_t col_i = 0; col_i < tab_.cols.size(); col_i++) {
+                if (ihs[col_i] != nullptr) {
+                    ihs[col_i]->delete_entry(rec->data + tab_.cols[col_i].offset, txn);
+                    ihs[col_i]->insert_entry(new_rec->data + tab_.cols[col_i].offset, rid, txn);
+                }
+            }
             // lab3 task3 Todo end
         }
         return nullptr;
@@ -0,0 +1,238 @@
+#include "join_order.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+std::string JoinPlan::to_string(const std::vector<std::string> &tab_names, int depth) const {
+    std::string name;
+    if (is_leaf()) {
+        name = (access.method == AccessMethod::SEQ_SCAN ? "SeqScan(" : "IndexScan(") + tab_names[table] + ")";
+    } else {
+        name = algorithm == JoinAlgorithm::HASH_JOIN           ? "HashJoin"
+               : algorithm == JoinAlgorithm::INDEX_NESTED_LOOP ? "IndexNestedLoopJoin"
+                                                               : "NestedLoopJoin";
+    }
+    char buf[96];
+    snprintf(buf, sizeof(buf), " cost=%.2f rows=%.0f\n", cost, est_rows);
+    std::string str = std::string(depth * 2, ' ') + name + buf;
+    if (!is_leaf()) {
+        str += left->to_string(tab_names, depth + 1);
+        str += right->to_string(tab_names, depth + 1);
+    }
+    return str;
+}
+
+std::shared_ptr<const JoinPlan> JoinOrderOptimizer::make_leaf(int table, const std::vector<Condition> &conds) {
+    auto leaf = std::make_shared<JoinPlan>();
+    leaf->table = table;
+    leaf->tables = 1u << table;
+    leaf->access = cost_model_->choose_access_path(tab_names_[table], conds);
+    leaf->est_rows = leaf->access.est_rows;
+    leaf->cost = leaf->access.cost;
+    return leaf;
+}
+
+double JoinOrderOptimizer::join_col_ndv(const JoinPlan &plan, const TabCol &col) {
+    return std::max(std::min(cost_model_->column_ndv(col.tab_name, col.col_name), plan.est_rows), 1.0);
+}
+
+/**
+ * 结果行数 = 两侧行数之积 * 各连接条件的选择率，等值条件的选择率为1/max(两侧连接列的不同值个数)。
+ * 对两种内外顺序分别估计：
+ * hash join的代价为两侧代价 + build端建表 + probe端查找；
+ * nested loop总是可行：outer每行都要把inner重新执行一次，inner为连接子树时同样整棵重新执行，
+ * 因此代价为outer行数 * inner代价，连接图不连通时也靠它做笛卡尔积；
+ * 只有inner为单表且连接列有索引时才考虑index nested loop，每行outer做一次索引等值查找
+ */
+std::shared_ptr<const JoinPlan> JoinOrderOptimizer::make_join(const std::shared_ptr<const JoinPlan> &lhs,
+                                                              const std::shared_ptr<const JoinPlan> &rhs) {
+    std::vector<Condition> conds;
+    double sel = 1;
+    for (auto &edge : edges_) {
+        uint32_t edge_tables = (1u << edge.lhs_table) | (1u << edge.rhs_table);
+        if ((edge_tables & lhs->tables) == 0 || (edge_tables & rhs->tables) == 0) {
+            continue;
+        }
+        conds.push_back(edge.cond);
+        const JoinPlan &lhs_side = (lhs->tables >> edge.lhs_table) & 1 ? *lhs : *rhs;
+        const JoinPlan &rhs_side = (lhs->tables >> edge.lhs_table) & 1 ? *rhs : *lhs;
+        double eq_sel =
+            1 / std::max(join_col_ndv(lhs_side, edge.cond.lhs_col), join_col_ndv(rhs_side, edge.cond.rhs_col));
+        sel *= edge.cond.op == OP_EQ   ? eq_sel
+               : edge.cond.op == OP_NE ? 1 - eq_sel
+                                       : CostModel::DEFAULT_RANGE_SEL;
+    }
+    bool has_equi_join =
+        std::any_of(conds.begin(), conds.end(), [](const Condition &cond) { return cond.op == OP_EQ; });
+    double out_rows = lhs->est_rows * rhs->est_rows * sel;
+    double out_cost = out_rows * CostModel::CPU_TUPLE_COST;
+
+    auto best = std::make_shared<JoinPlan>();
+    best->tables = lhs->tables | rhs->tables;
+    best->conds = conds;
+    best->est_rows = out_rows;
+    best->cost = -1;
+    auto consider = [&](const std::shared_ptr<const JoinPlan> &outer, const std::shared_ptr<const JoinPlan> &inner,
+                        JoinAlgorithm algorithm, double cost) {
+        if (best->cost < 0 || cost < best->cost) {
+            best->left = outer;
+            best->right = inner;
+            best->algorithm = algorithm;
+            best->cost = cost;
+        }
+    };
+    for (auto &[outer, inner] : {std::make_pair(lhs, rhs), std::make_pair(rhs, lhs)}) {
+        double outer_rows = std::max(outer->est_rows, 1.0);
+        if (has_equi_join) {
+            consider(outer, inner, JoinAlgorithm::HASH_JOIN,
+                     outer->cost + inner->cost + inner->est_rows * HASH_BUILD_COST + outer->est_rows * HASH_PROBE_COST +
+                         out_cost);
+        }
+        consider(outer, inner, JoinAlgorithm::NESTED_LOOP, outer->cost + outer_rows * inner->cost + out_cost);
+        if (!inner->is_leaf()) {
+            continue;
+        }
+        const std::string &inner_tab = tab_names_[inner->table];
+        auto &tab = cost_model_->sm_manager()->db_.get_table(inner_tab);
+        for (auto &cond : conds) {
+            const TabCol &inner_col = cond.lhs_col.tab_name == inner_tab ? cond.lhs_col : cond.rhs_col;
+            auto col = tab.get_col(inner_col.col_name);
+            if (cond.op != OP_EQ || !col->index) {
+                continue;
+            }
+            double inner_rows = cost_model_->estimate_rows(inner_tab);
+            double matches = inner_rows / std::max(cost_model_->column_ndv(inner_tab, inner_col.col_name), 1.0);
+            double probe_cost = CostModel::index_height(inner_rows, col->len) * CostModel::RANDOM_PAGE_COST +
+                                matches * (CostModel::RANDOM_PAGE_COST + CostModel::CPU_TUPLE_COST);
+            consider(outer, inner, JoinAlgorithm::INDEX_NESTED_LOOP, outer->cost + outer_rows * probe_cost + out_cost);
+        }
+    }
+    return best;
+}
+
+std::shared_ptr<const JoinPlan> JoinOrderOptimizer::optimize(const std::vector<std::string> &tab_names,
+                                                             const std::vector<Condition> &conds) {
+    int n = static_cast<int>(tab_names.size());
+    if (n == 0) {
+        return nullptr;
+    }
+    if (n > 32) {
+        throw InternalError("Too many tables in one query");
+    }
+    tab_names_ = tab_names;
+    edges_.clear();
+    leaves_.clear();
+    std::unordered_map<std::string, int> tab_idx;
+    for (int i = 0; i < n; i++) {
+        tab_idx[tab_names[i]] = i;
+    }
+    // 单表条件下推到叶子，涉及两张表的条件作为连接图的边
+    std::vector<std::vector<Condition>> local_conds(n);
+    std::vector<uint32_t> adj(n, 0);
+    for (auto &cond : conds) {
+        int lhs = tab_idx.at(cond.lhs_col.tab_name);
+        if (cond.is_rhs_val || cond.rhs_col.tab_name == cond.lhs_col.tab_name) {
+            local_conds[lhs].push_back(cond);
+            continue;
+        }
+        int rhs = tab_idx.at(cond.rhs_col.tab_name);
+        edges_.push_back({lhs, rhs, cond});
+        adj[lhs] |= 1u << rhs;
+        adj[rhs] |= 1u << lhs;
+    }
+    for (int i = 0; i < n; i++) {
+        leaves_.push_back(make_leaf(i, local_conds[i]));
+    }
+    auto connected = [&](uint32_t a, uint32_t b) {
+        for (int i = 0; i < n; i++) {
+            if ((a >> i & 1) && (adj[i] & b)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if (n > MAX_DP_TABLES) {
+        // 贪心：优先连接有连接条件且结果最小的一对子树
+        std::vector<std::shared_ptr<const JoinPlan>> plans = leaves_;
+        while (plans.size() > 1) {
+            std::shared_ptr<const JoinPlan> best;
+            size_t best_i = 0, best_j = 0;
+            bool best_connected = false;
+            for (size_t i = 0; i < plans.size(); i++) {
+                for (size_t j = i + 1; j < plans.size(); j++) {
+                    bool is_connected = connected(plans[i]->tables, plans[j]->tables);
+                    if (best_connected && !is_connected) {
+                        continue;
+                    }
+                    auto plan = make_join(plans[i], plans[j]);
+                    if (best == nullptr || (is_connected && !best_connected) || plan->est_rows < best->est_rows) {
+                        best = plan;
+                        best_i = i;
+                        best_j = j;
+                        best_connected = is_connected;
+                    }
+                }
+            }
+            plans[best_i] = best;
+            plans.erase(plans.begin() + best_j);
+        }
+        return plans[0];
+    }
+
+    // best[mask]: 表集合mask的最优计划，只为连通的表集合生成
+    uint32_t full = (1u << n) - 1;
+    std::vector<std::shared_ptr<const JoinPlan>> best(full + 1);
+    for (int i = 0; i < n; i++) {
+        best[1u << i] = leaves_[i];
+    }
+    for (uint32_t mask = 1; mask <= full; mask++) {
+        if (__builtin_popcount(mask) < 2) {
+            continue;
+        }
+        for (uint32_t sub = (mask - 1) & mask; sub > 0; sub = (sub - 1) & mask) {
+            uint32_t other = mask ^ sub;
+            // make_join会考虑两种内外顺序，每个二分只需枚举一次
+            if (sub < other || best[sub] == nullptr || best[other] == nullptr || !connected(sub, other)) {
+                continue;
+            }
+            auto plan = make_join(best[sub], best[other]);
+            if (best[mask] == nullptr || plan->cost < best[mask]->cost) {
+                best[mask] = plan;
+            }
+        }
+    }
+    if (best[full] != nullptr) {
+        return best[full];
+    }
+
+    // 连接图不连通：各连通分量按估计行数从小到大做笛卡尔积
+    std::vector<std::shared_ptr<const JoinPlan>> components;
+    uint32_t visited = 0;
+    for (int i = 0; i < n; i++) {
+        if (visited >> i & 1) {
+            continue;
+        }
+        uint32_t component = 1u << i;
+        for (uint32_t frontier = component; frontier != 0;) {
+            uint32_t next = 0;
+            for (int j = 0; j < n; j++) {
+                if (frontier >> j & 1) {
+                    next |= adj[j];
+                }
+            }
+            frontier = next & ~component;
+            component |= next;
+        }
+        visited |= component;
+        components.push_back(best[component]);
+    }
+    std::sort(components.begin(), components.end(),
+              [](const auto &a, const auto &b) { return a->est_rows < b->est_rows; });
+    auto plan = components[0];
+    for (size_t i = 1; i < components.size(); i++) {
+        plan = make_join(plan, components[i]);
+    }
+    return plan;
+}
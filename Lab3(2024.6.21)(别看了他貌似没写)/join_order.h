@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cost_model.h"
+
+/**
+ * @brief 连接算法
+ * NESTED_LOOP: NestedLoopJoinExecutor，对outer的每一行把连接列的值feed给inner并重新执行inner；
+ *              inner可以是单表也可以是连接子树，feed沿子树传到各叶子的扫描
+ * INDEX_NESTED_LOOP: 同上，inner必须是单表且在连接列上有索引，每次只做一次索引等值查找
+ * HASH_JOIN: 流水线中的HashBuildSink/HashProbeStage，以right为build端、left为probe端
+ */
+enum class JoinAlgorithm { NESTED_LOOP, INDEX_NESTED_LOOP, HASH_JOIN };
+
+/** 连接树的结点，叶子为单表扫描，内部结点为两棵子树的连接 */
+struct JoinPlan {
+    int table = -1;                         // 叶子: 表在tab_names中的下标；内部结点为-1
+    AccessPath access;                      // 叶子: 单表访问路径
+    std::shared_ptr<const JoinPlan> left;   // outer / probe端
+    std::shared_ptr<const JoinPlan> right;  // inner / build端
+    JoinAlgorithm algorithm = JoinAlgorithm::NESTED_LOOP;
+    std::vector<Condition> conds;  // 在本结点计算的连接条件
+    uint32_t tables = 0;           // 子树包含的表集合，第i位对应tab_names[i]
+    double est_rows = 0;
+    double cost = 0;
+
+    bool is_leaf() const { return table >= 0; }
+
+    /** 缩进的树形输出，用于EXPLAIN */
+    std::string to_string(const std::vector<std::string> &tab_names, int depth = 0) const;
+};
+
+/**
+ * @brief 基于动态规划的连接顺序选择
+ * 表数不超过MAX_DP_TABLES时按表集合从小到大枚举所有连通子集的二分(DPsub)，每个子集只保留代价最小的计划，
+ * 因此也会考虑bushy树；连接图不连通时最后按估计行数从小到大用笛卡尔积连接各连通分量。
+ * 表更多时退化为贪心：每次连接结果行数最小的一对子树
+ */
+class JoinOrderOptimizer {
+   public:
+    static constexpr int MAX_DP_TABLES = 12;
+    static constexpr double HASH_BUILD_COST = 0.02;  // build端每行插入哈希表的代价
+    static constexpr double HASH_PROBE_COST = 0.01;  // probe端每行查找哈希表的代价
+
+    explicit JoinOrderOptimizer(CostModel *cost_model) : cost_model_(cost_model) {}
+
+    /**
+     * @brief 为多表查询选择连接顺序、每个连接的算法和左右两侧
+     * @param tab_names FROM中的表
+     * @param conds WHERE中的全部条件，按涉及的表分为单表条件和连接条件
+     */
+    std::shared_ptr<const JoinPlan> optimize(const std::vector<std::string> &tab_names,
+                                             const std::vector<Condition> &conds);
+
+   private:
+    struct JoinEdge {
+        int lhs_table;
+        int rhs_table;
+        Condition cond;
+    };
+
+    std::shared_ptr<const JoinPlan> make_leaf(int table, const std::vector<Condition> &conds);
+
+    /** 连接两棵子树的最优计划，两侧之间没有连接条件时为笛卡尔积 */
+    std::shared_ptr<const JoinPlan> make_join(const std::shared_ptr<const JoinPlan> &lhs,
+                                              const std::shared_ptr<const JoinPlan> &rhs);
+
+    /** 单表的连接列在过滤后的不同值个数 */
+    double join_col_ndv(const JoinPlan &leaf_or_tree, const TabCol &col);
+
+    CostModel *cost_model_;
+    std::vector<std::string> tab_names_;
+    std::vector<JoinEdge> edges_;
+    std::vector<std::shared_ptr<const JoinPlan>> leaves_;
+};
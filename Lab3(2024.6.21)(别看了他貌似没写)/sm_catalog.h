@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "errors.h"
+
+/**
+ * @brief 二进制系统目录(catalog)的文件格式
+ * | CatalogHeader | 表目录: num_tables个CatalogDirEntry，每项后跟表名 | 各表的TabMeta |
+ * 表目录记录每张表的TabMeta在文件中的偏移和长度，读取时按目录逐项解析；
+ * 每项TabMeta自带长度，同一版本内在末尾追加的字段可以被旧代码跳过。
+ * 整个文件先写临时文件再rename，checksum覆盖header之后的全部内容。
+ * 版本2起每个TabMeta之后跟一个标志字节，非0时紧跟ANALYZE生成的TabStats；
+ * 版本3起最后再跟一个表选项字节(CATALOG_TAB_*)
+ */
+static const std::string DB_CATALOG_NAME = "db.catalog";
+
+static constexpr char CATALOG_MAGIC[8] = {'R', 'M', 'D', 'B', 'C', 'A', 'T', '\0'};
+static constexpr uint32_t CATALOG_VERSION = 3;
+
+static constexpr uint8_t CATALOG_TAB_READ_ONLY = 0x1;  // 只读表，记录文件通过mmap读取
+
+struct CatalogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_tables;
+    uint64_t checksum;  // header之后全部内容的FNV-1a
+};
+
+struct CatalogDirEntry {
+    uint64_t offset;    // TabMeta相对文件开头的偏移
+    uint32_t length;    // TabMeta的长度
+    uint32_t name_len;  // 紧跟在本项之后的表名长度
+};
+
+/** FNV-1a 64位哈希，用于检测目录文件损坏 */
+static inline uint64_t catalog_checksum(const char *data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/** 向缓冲区末尾追加定长字段和带长度前缀的字符串 */
+class CatalogWriter {
+   public:
+    template <typename T>
+    void put(const T &value) {
+        const char *bytes = reinterpret_cast<const char *>(&value);
+        buf_.insert(buf_.end(), bytes, bytes + sizeof(T));
+    }
+
+    void put_bytes(const std::string &str) { buf_.insert(buf_.end(), str.begin(), str.end()); }
+
+    void put_string(const std::string &str) {
+        put(static_cast<uint32_t>(str.size()));
+        put_bytes(str);
+    }
+
+    /** 在pos处覆盖写入定长字段，用于回填偏移和长度 */
+    template <typename T>
+    void put_at(size_t pos, const T &value) {
+        memcpy(buf_.data() + pos, &value, sizeof(T));
+    }
+
+    size_t size() const { return buf_.size(); }
+
+    std::vector<char> &buffer() { return buf_; }
+
+   private:
+    std::vector<char> buf_;
+};
+
+/** 按顺序读取CatalogWriter写入的字段，越界说明文件损坏 */
+class CatalogReader {
+   public:
+    CatalogReader(const char *data, size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    T get() {
+        check(sizeof(T));
+        T value;
+        memcpy(&value, data_ + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return value;
+    }
+
+    std::string get_bytes(size_t len) {
+        check(len);
+        std::string str(data_ + pos_, len);
+        pos_ += len;
+        return str;
+    }
+
+    std::string get_string() { return get_bytes(get<uint32_t>()); }
+
+    size_t pos() const { return pos_; }
+
+   private:
+    void check(size_t len) const {
+        if (pos_ + len > size_) {
+            throw InternalError("Catalog file is truncated or corrupted");
+        }
+    }
+
+    const char *data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
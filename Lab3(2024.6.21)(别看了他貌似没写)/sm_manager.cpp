@@ -1,13 +1,20 @@
 #include "sm_manager.h"
 
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 #include <fstream>
+#include <random>
+#include <unordered_set>
 
 #include "index/ix.h"
 #include "record/rm.h"
 #include "record_printer.h"
+#include "sm_catalog.h"
+#include "sm_stats.h"
+#include "storage/io_latency.h"
+#include "storage/metrics.h"
 
 bool SmManager::is_dir(const std::string &db_name) {
     struct stat st;
@@ -39,25 +46,320 @@ void SmManager::open_db(const std::string &db_name) {
         throw UnixError();
     }
     // Load meta
-    // 打开一个名为DB_META_NAME的文件
-    std::ifstream ifs(DB_META_NAME);
-    // 将ofs打开的DB_META_NAME文件中的信息，按照定义好的operator>>操作符，读出到db_中
-    ifs >> db_;  // 注意：此处重载了操作符>>
-    // Open all record files & index files
+    load_meta(db_name);
+    // 记录文件和索引文件不在这里打开，第一次通过get_file_handle()/get_index_handle()访问时才打开
+}
+
+static void write_tab_stats(CatalogWriter &writer, const TabStats &stats) {
+    writer.put(stats.num_rows);
+    writer.put(static_cast<int32_t>(stats.num_pages));
+    writer.put(static_cast<int32_t>(stats.sampled_pages));
+    writer.put(static_cast<uint32_t>(stats.cols.size()));
+    for (auto &col : stats.cols) {
+        writer.put_string(col.min_value);
+        writer.put_string(col.max_value);
+        writer.put(col.num_distinct);
+        writer.put(static_cast<uint32_t>(col.histogram.size()));
+        for (auto &bound : col.histogram) {
+            writer.put_string(bound);
+        }
+        auto &registers = col.sketch.registers();
+        writer.put_bytes(std::string(registers.begin(), registers.end()));
+    }
+}
+
+static TabStats read_tab_stats(CatalogReader &reader) {
+    TabStats stats;
+    stats.num_rows = reader.get<double>();
+    stats.num_pages = reader.get<int32_t>();
+    stats.sampled_pages = reader.get<int32_t>();
+    stats.cols.resize(reader.get<uint32_t>());
+    for (auto &col : stats.cols) {
+        col.min_value = reader.get_string();
+        col.max_value = reader.get_string();
+        col.num_distinct = reader.get<double>();
+        col.histogram.resize(reader.get<uint32_t>());
+        for (auto &bound : col.histogram) {
+            bound = reader.get_string();
+        }
+        auto registers = reader.get_bytes(HyperLogLog::HLL_REGISTERS);
+        col.sketch.registers().assign(registers.begin(), registers.end());
+    }
+    return stats;
+}
+
+/**
+ * @brief 读取系统目录到db_中
+ * 优先读取二进制目录DB_CATALOG_NAME；不存在时读取旧的文本格式DB_META_NAME，并立即转换为二进制目录
+ */
+void SmManager::load_meta(const std::string &db_name) {
+    if (!disk_manager_->is_file(DB_CATALOG_NAME)) {
+        if (disk_manager_->is_file(DB_META_NAME)) {
+            std::ifstream ifs(DB_META_NAME);
+            ifs >> db_;  // 注意：此处重载了操作符>>
+            flush_meta();
+        } else {
+            db_.name_ = db_name;
+        }
+        return;
+    }
+    std::vector<char> buf(disk_manager_->GetFileSize(DB_CATALOG_NAME));
+    std::ifstream ifs(DB_CATALOG_NAME, std::ios::binary);
+    if (!ifs.read(buf.data(), buf.size())) {
+        throw UnixError();
+    }
+    CatalogReader reader(buf.data(), buf.size());
+    auto hdr = reader.get<CatalogHeader>();
+    if (memcmp(hdr.magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0) {
+        throw InternalError("Not a catalog file: " + DB_CATALOG_NAME);
+    }
+    if (hdr.version > CATALOG_VERSION) {
+        throw InternalError("Unsupported catalog version " + std::to_string(hdr.version));
+    }
+    if (catalog_checksum(buf.data() + sizeof(CatalogHeader), buf.size() - sizeof(CatalogHeader)) != hdr.checksum) {
+        throw InternalError("Catalog checksum mismatch");
+    }
+    db_.name_ = reader.get_string();
+    db_.tabs_.clear();
+    table_stats_.clear();
+    read_only_tabs_.clear();
+    // 按表目录逐项解析TabMeta，只读取当前版本已知的字段
+    for (uint32_t i = 0; i < hdr.num_tables; i++) {
+        auto dir_entry = reader.get<CatalogDirEntry>();
+        if (dir_entry.offset + dir_entry.length > buf.size()) {
+            throw InternalError("Catalog file is truncated or corrupted");
+        }
+        CatalogReader tab_reader(buf.data() + dir_entry.offset, dir_entry.length);
+        TabMeta tab;
+        tab.name = tab_reader.get_string();
+        auto num_cols = tab_reader.get<uint32_t>();
+        for (uint32_t j = 0; j < num_cols; j++) {
+            ColMeta col;
+            col.tab_name = tab.name;
+            col.name = tab_reader.get_string();
+            col.type = static_cast<ColType>(tab_reader.get<int32_t>());
+            col.len = tab_reader.get<int32_t>();
+            col.offset = tab_reader.get<int32_t>();
+            col.index = tab_reader.get<uint8_t>() != 0;
+            tab.cols.push_back(col);
+        }
+        if (hdr.version >= 2 && tab_reader.get<uint8_t>() != 0) {
+            table_stats_[tab.name] = std::make_shared<const TabStats>(read_tab_stats(tab_reader));
+        }
+        if (hdr.version >= 3 && (tab_reader.get<uint8_t>() & CATALOG_TAB_READ_ONLY)) {
+            read_only_tabs_.insert(tab.name);
+        }
+        // 表名紧跟在目录项之后，与TabMeta中的表名相同
+        reader.get_bytes(dir_entry.name_len);
+        db_.tabs_.emplace(tab.name, std::move(tab));
+    }
+}
+
+/**
+ * @brief 把db_写入二进制目录
+ * 先写入临时文件并fsync，再rename覆盖原文件，崩溃时磁盘上总有一份完整的目录
+ */
+void SmManager::flush_meta() {
+    CatalogWriter writer;
+    CatalogHeader hdr;
+    memcpy(hdr.magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+    hdr.version = CATALOG_VERSION;
+    hdr.num_tables = db_.tabs_.size();
+    hdr.checksum = 0;
+    writer.put(hdr);
+    writer.put_string(db_.name_);
+    std::unordered_set<std::string> read_only_tabs;
+    {
+        std::scoped_lock lock{handles_latch_};
+        read_only_tabs = read_only_tabs_;
+    }
+    // 表目录，偏移和长度在写完TabMeta后回填
+    std::vector<size_t> dir_pos;
+    for (auto &[tab_name, tab] : db_.tabs_) {
+        dir_pos.push_back(writer.size());
+        writer.put(CatalogDirEntry{0, 0, static_cast<uint32_t>(tab_name.size())});
+        writer.put_bytes(tab_name);
+    }
+    size_t i = 0;
+    for (auto &[tab_name, tab] : db_.tabs_) {
+        size_t offset = writer.size();
+        writer.put_string(tab.name);
+        writer.put(static_cast<uint32_t>(tab.cols.size()));
+        for (auto &col : tab.cols) {
+            writer.put_string(col.name);
+            writer.put(static_cast<int32_t>(col.type));
+            writer.put(static_cast<int32_t>(col.len));
+            writer.put(static_cast<int32_t>(col.offset));
+            writer.put(static_cast<uint8_t>(col.index));
+        }
+        auto stats = get_table_stats(tab_name);
+        writer.put(static_cast<uint8_t>(stats != nullptr));
+        if (stats != nullptr) {
+            write_tab_stats(writer, *stats);
+        }
+        writer.put(static_cast<uint8_t>(read_only_tabs.count(tab_name) ? CATALOG_TAB_READ_ONLY : 0));
+        writer.put_at(dir_pos[i++], CatalogDirEntry{offset, static_cast<uint32_t>(writer.size() - offset),
+                                                    static_cast<uint32_t>(tab_name.size())});
+    }
+    auto &buf = writer.buffer();
+    hdr.checksum = catalog_checksum(buf.data() + sizeof(CatalogHeader), buf.size() - sizeof(CatalogHeader));
+    writer.put_at(0, hdr);
+
+    std::string tmp_name = DB_CATALOG_NAME + ".tmp";
+    int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        throw UnixError();
+    }
+    bool ok = write(fd, buf.data(), buf.size()) == static_cast<ssize_t>(buf.size()) && fsync(fd) == 0;
+    if (close(fd) < 0 || !ok || rename(tmp_name.c_str(), DB_CATALOG_NAME.c_str()) < 0) {
+        throw UnixError();
+    }
+}
+
+/**
+ * 打开的记录文件和索引文件按最近访问的顺序排在handle_lru_中(表头为最近访问)，
+ * 同时记下访问时的handle_epoch_，evict_handles()据此判断句柄是否可能还被活跃事务使用。调用者持有handles_latch_
+ */
+void SmManager::touch_handle(const std::string &file_name, bool is_index) {
+    uint64_t epoch = handle_epoch_.load(std::memory_order_relaxed);
+    auto iter = open_handles_.find(file_name);
+    if (iter == open_handles_.end()) {
+        handle_lru_.push_front(file_name);
+        open_handles_.emplace(file_name, OpenHandle{handle_lru_.begin(), epoch, is_index});
+        return;
+    }
+    if (iter->second.lru_pos != handle_lru_.begin()) {
+        handle_lru_.splice(handle_lru_.begin(), handle_lru_, iter->second.lru_pos);
+    }
+    iter->second.epoch = epoch;
+}
+
+RmFileHandle *SmManager::get_file_handle(const std::string &tab_name) {
+    std::scoped_lock lock{handles_latch_};
+    auto iter = fhs_.find(tab_name);
+    if (iter == fhs_.end()) {
+        if (!db_.is_table(tab_name)) {
+            throw TableNotFoundError(tab_name);
+        }
+        iter = fhs_.emplace(tab_name, rm_manager_->open_file(tab_name)).first;
+        if (read_only_tabs_.count(tab_name)) {
+            iter->second->enable_mmap();
+        }
+    }
+    touch_handle(tab_name, false);
+    return iter->second.get();
+}
+
+IxIndexHandle *SmManager::get_index_handle(const std::string &tab_name, int col_idx) {
+    auto index_name = ix_manager_->get_index_name(tab_name, col_idx);
+    std::scoped_lock lock{handles_latch_};
+    auto iter = ihs_.find(index_name);
+    if (iter == ihs_.end()) {
+        auto &col = db_.get_table(tab_name).cols.at(col_idx);
+        if (!col.index) {
+            throw IndexNotFoundError(tab_name, col.name);
+        }
+        iter = ihs_.emplace(index_name, ix_manager_->open_index(tab_name, col_idx)).first;
+    }
+    touch_handle(index_name, true);
+    return iter->second.get();
+}
+
+std::vector<std::pair<std::string, RmFileHandle *>> SmManager::get_open_file_handles() {
+    std::scoped_lock lock{handles_latch_};
+    std::vector<std::pair<std::string, RmFileHandle *>> handles;
+    handles.reserve(fhs_.size());
+    for (auto &[tab_name, fh] : fhs_) {
+        handles.emplace_back(tab_name, fh.get());
+    }
+    return handles;
+}
+
+std::vector<std::string> SmManager::get_table_names() {
+    std::vector<std::string> tab_names;
+    tab_names.reserve(db_.tabs_.size());
     for (auto &entry : db_.tabs_) {
-        auto &tab = entry.second;
-        // fhs_[tab.name] = rm_manager_->open_file(tab.name);
-        fhs_.emplace(tab.name, rm_manager_->open_file(tab.name));
-        for (size_t i = 0; i < tab.cols.size(); i++) {
-            auto &col = tab.cols[i];
-            if (col.index) {
-                auto index_name = ix_manager_->get_index_name(tab.name, i);
-                assert(ihs_.count(index_name) == 0);
-                // ihs_[index_name] = ix_manager_->open_index(tab.name, i);
-                ihs_.emplace(index_name, ix_manager_->open_index(tab.name, i));
+        tab_names.push_back(entry.first);
+    }
+    return tab_names;
+}
+
+void SmManager::advance_handle_epoch(uint64_t epoch) {
+    uint64_t curr = handle_epoch_.load(std::memory_order_relaxed);
+    while (curr < epoch && !handle_epoch_.compare_exchange_weak(curr, epoch, std::memory_order_relaxed)) {
+    }
+}
+
+/**
+ * @brief 关闭一个打开的文件句柄，调用者持有handles_latch_
+ * 记录文件上还有版本信息或TID表项时不能关闭，否则重新打开后会丢失这些内存中的状态；
+ * 缓冲池中还有被pin住的页面时也不能关闭
+ * @return 是否关闭成功
+ */
+bool SmManager::close_handle(const std::string &file_name, bool is_index) {
+    if (is_index) {
+        auto iter = ihs_.find(file_name);
+        if (iter != ihs_.end()) {
+            if (!buffer_pool_manager_->DeleteAllPages(disk_manager_->GetFileFd(file_name))) {
+                return false;
             }
+            ix_manager_->close_index(iter->second.get());
+            ihs_.erase(iter);
         }
+        return true;
     }
+    auto iter = fhs_.find(file_name);
+    if (iter != fhs_.end()) {
+        RmFileHandle *fh = iter->second.get();
+        if (!fh->get_version_store()->empty() || !fh->get_tid_table()->empty() ||
+            !buffer_pool_manager_->DeleteAllPages(fh->GetFd())) {
+            return false;
+        }
+        rm_manager_->close_file(fh);
+        fhs_.erase(iter);
+    }
+    return true;
+}
+
+/**
+ * @brief 打开的文件数超过max_open_files_时，从LRU表尾开始关闭句柄
+ * 只关闭最后一次访问早于min_active_epoch的句柄：活跃事务都在此之后开始，不会再持有这些句柄的指针。
+ * 与其他访问句柄的操作通过handles_latch_互斥，由GarbageCollect()周期性调用
+ * @param min_active_epoch 活跃事务中最小的事务id，没有活跃事务时为下一个事务id
+ * @return 关闭的句柄数
+ */
+size_t SmManager::evict_handles(uint64_t min_active_epoch) {
+    std::scoped_lock lock{handles_latch_};
+    size_t num_evicted = 0;
+    for (auto iter = handle_lru_.end(); iter != handle_lru_.begin() && open_handles_.size() > max_open_files_;) {
+        --iter;
+        auto pos = open_handles_.find(*iter);
+        if (pos->second.epoch >= min_active_epoch || !close_handle(*iter, pos->second.is_index)) {
+            continue;
+        }
+        open_handles_.erase(pos);
+        iter = handle_lru_.erase(iter);
+        num_evicted++;
+    }
+    return num_evicted;
+}
+
+/** 关闭索引文件句柄(如果已打开)，用于删除或重建索引文件之前 */
+void SmManager::close_index_handle(const std::string &index_name) {
+    std::scoped_lock lock{handles_latch_};
+    auto pos = open_handles_.find(index_name);
+    if (pos == open_handles_.end()) {
+        return;
+    }
+    // 与close_handle()一样把页面移出缓冲池，否则重建的索引复用同一个fd时会读到旧索引的页面
+    if (!buffer_pool_manager_->DeleteAllPages(disk_manager_->GetFileFd(index_name))) {
+        throw InternalError("SmManager::close_index_handle: index pages are still pinned");
+    }
+    auto iter = ihs_.find(index_name);
+    ix_manager_->close_index(iter->second.get());
+    ihs_.erase(iter);
+    handle_lru_.erase(pos->second.lru_pos);
+    open_handles_.erase(pos);
 }
 
 void SmManager::close_db() {
@@ -98,6 +400,38 @@ void SmManager::desc_table(const std::string &tab_name, Context *context) {
     printer.print_separator(context);
 }
 
+/**
+ * @brief SHOW STATUS：输出缓冲池、磁盘I/O、日志和索引的运行指标，来自MetricsRegistry
+ */
+void SmManager::show_status(Context *context) {
+    std::vector<std::string> captions = {"Variable_name", "Value"};
+    RecordPrinter printer(captions.size());
+    printer.print_separator(context);
+    printer.print_record(captions, context);
+    printer.print_separator(context);
+    for (auto &[name, value] : MetricsRegistry::snapshot()) {
+        printer.print_record({name, value}, context);
+    }
+    printer.print_separator(context);
+}
+
+/**
+ * @brief 按文件和操作类型输出磁盘I/O的延迟分位数，单位微秒
+ */
+void SmManager::show_io_latency(Context *context) {
+    std::vector<std::string> captions = {"File", "Op", "Count", "p50_us", "p99_us", "p999_us", "max_us"};
+    RecordPrinter printer(captions.size());
+    printer.print_separator(context);
+    printer.print_record(captions, context);
+    printer.print_separator(context);
+    for (auto &s : IoLatency::summaries()) {
+        printer.print_record({s.file, IoLatency::op_name(s.op), std::to_string(s.count), std::to_string(s.p50_us),
+                              std::to_string(s.p99_us), std::to_string(s.p999_us), std::to_string(s.max_us)},
+                             context);
+    }
+    printer.print_separator(context);
+}
+
 void SmManager::create_table(const std::string &tab_name, const std::vector<ColDef> &col_defs, Context *context) {
     if (db_.is_table(tab_name)) {
         throw TableExistsError(tab_name);
@@ -120,8 +454,7 @@ void SmManager::create_table(const std::string &tab_name, const std::vector<ColD
     int record_size = curr_offset;  // record_size就是col meta所占的大小（表的元数据也是以记录的形式进行存储的）
     rm_manager_->create_file(tab_name, record_size);
     db_.tabs_[tab_name] = tab;
-    // fhs_[tab_name] = rm_manager_->open_file(tab_name);
-    fhs_.emplace(tab_name, rm_manager_->open_file(tab_name));
+    flush_meta();
 }
 
 void SmManager::drop_table(const std::string &tab_name, Context *context) {
@@ -141,10 +474,12 @@ void SmManager::create_index(const std::string &tab_name, const std::string &col
     // Create index file
     int col_idx = col - tab.cols.begin();
     ix_manager_->create_index(tab_name, col_idx, col->type, col->len);  // 这里调用了
+    // Mark column index as created
+    col->index = true;
     // Open index file
-    auto ih = ix_manager_->open_index(tab_name, col_idx);
+    auto ih = get_index_handle(tab_name, col_idx);
     // Get record file handle
-    auto file_handle = fhs_.at(tab_name).get();
+    auto file_handle = get_file_handle(tab_name);
     // Index all records into index
     for (RmScan rm_scan(file_handle); !rm_scan.is_end(); rm_scan.next()) {
         auto rec = file_handle->get_record(rm_scan.rid(), context);  // rid是record的存储位置，作为value插入到索引里
@@ -152,13 +487,7 @@ void SmManager::create_index(const std::string &tab_name, const std::string &col
         // record data里以各个属性的offset进行分隔，属性的长度为col len，record里面每个属性的数据作为key插入索引里
         ih->insert_entry(key, rm_scan.rid(), context->txn_);
     }
-    // Store index handle
-    auto index_name = ix_manager_->get_index_name(tab_name, col_idx);
-    assert(ihs_.count(index_name) == 0);
-    // ihs_[index_name] = std::move(ih);
-    ihs_.emplace(index_name, std::move(ih));
-    // Mark column index as created
-    col->index = true;
+    flush_meta();
 }
 
 void SmManager::drop_index(const std::string &tab_name, const std::string &col_name, Context *context) {
@@ -169,8 +498,122 @@ void SmManager::drop_index(const std::string &tab_name, const std::string &col_n
     }
     int col_idx = col - tab.cols.begin();
     auto index_name = ix_manager_->get_index_name(tab_name, col_idx);
-    ix_manager_->close_index(ihs_.at(index_name).get());
+    close_index_handle(index_name);
     ix_manager_->destroy_index(tab_name, col_idx);
-    ihs_.erase(index_name);
     col->index = false;
+    flush_meta();
+}
+
+/**
+ * @brief 收集表的统计信息(ANALYZE)，保存到系统目录中供优化器使用
+ * 随机抽取sample_pages个数据页(按页号顺序读取)，用其中的全部记录构建各列的统计信息，
+ * 记录数按 样本记录数 * 数据页数 / 采样页数 推算。采样页数固定，因此耗时与表的大小无关；
+ * 数据页数不超过sample_pages时读取全表，统计是精确的(不同值个数除外)
+ * @param sample_pages 采样的数据页数
+ */
+void SmManager::analyze_table(const std::string &tab_name, Context *context, int sample_pages) {
+    TabMeta &tab = db_.get_table(tab_name);
+    RmFileHandle *fh = get_file_handle(tab_name);
+    RmFileHdr file_hdr = fh->get_file_hdr();
+    int num_data_pages = file_hdr.num_pages - RM_FIRST_RECORD_PAGE;
+
+    // Floyd算法从num_data_pages个数据页中不重复地抽取sample_pages个
+    std::vector<int> pages;
+    if (num_data_pages <= sample_pages) {
+        for (int i = 0; i < num_data_pages; i++) {
+            pages.push_back(RM_FIRST_RECORD_PAGE + i);
+        }
+    } else {
+        std::mt19937_64 rng(std::random_device{}());
+        std::unordered_set<int> chosen;
+        for (int j = num_data_pages - sample_pages; j < num_data_pages; j++) {
+            int t = std::uniform_int_distribution<int>(0, j)(rng);
+            chosen.insert(chosen.count(t) ? j : t);
+        }
+        for (int page : chosen) {
+            pages.push_back(RM_FIRST_RECORD_PAGE + page);
+        }
+        std::sort(pages.begin(), pages.end());
+    }
+
+    // 把样本记录复制出来，之后按列排序时只排指针
+    std::vector<char> rows;
+    size_t num_rows = 0;
+    int num_slots = file_hdr.num_records_per_page;
+    for (int page_no : pages) {
+        RmPageHandle page_handle = fh->fetch_page_handle(page_no);
+        for (int slot_no = Bitmap::first_bit(true, page_handle.bitmap, num_slots); slot_no < num_slots;
+             slot_no = Bitmap::next_bit(true, page_handle.bitmap, num_slots, slot_no)) {
+            rows.insert(rows.end(), page_handle.get_slot(slot_no), page_handle.get_slot(slot_no) + file_hdr.record_size);
+            num_rows++;
+        }
+        buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
+    }
+
+    TabStats stats;
+    stats.num_pages = file_hdr.num_pages;
+    stats.sampled_pages = pages.size();
+    stats.num_rows = pages.empty() ? 0 : static_cast<double>(num_rows) * num_data_pages / pages.size();
+    std::vector<const char *> values(num_rows);
+    for (auto &col : tab.cols) {
+        for (size_t i = 0; i < num_rows; i++) {
+            values[i] = rows.data() + i * file_hdr.record_size + col.offset;
+        }
+        stats.cols.push_back(ColStats::build(values, col, stats.num_rows));
+    }
+    {
+        std::scoped_lock lock{stats_latch_};
+        table_stats_[tab_name] = std::make_shared<const TabStats>(std::move(stats));
+    }
+    flush_meta();
+}
+
+/**
+ * @brief 把表标记为只读或取消标记，标记持久化在目录中
+ * 只读表拒绝DML，记录文件只读映射到内存，扫描和按Rid读取直接访问映射而不经过缓冲池，适合只读的冷数据。
+ * 标记时表上不能有未完成的写入
+ */
+void SmManager::set_table_read_only(const std::string &tab_name, bool read_only) {
+    if (!db_.is_table(tab_name)) {
+        throw TableNotFoundError(tab_name);
+    }
+    {
+        std::scoped_lock lock{handles_latch_};
+        auto iter = fhs_.find(tab_name);
+        if (read_only) {
+            if (iter != fhs_.end()) {
+                RmFileHandle *fh = iter->second.get();
+                if (!fh->get_version_store()->empty() || !fh->get_tid_table()->empty()) {
+                    throw InternalError("Table " + tab_name + " has uncommitted writes");
+                }
+                fh->enable_mmap();
+            }
+            read_only_tabs_.insert(tab_name);
+        } else {
+            if (iter != fhs_.end()) {
+                iter->second->disable_mmap();
+            }
+            read_only_tabs_.erase(tab_name);
+        }
+    }
+    flush_meta();
+}
+
+bool SmManager::is_table_read_only(const std::string &tab_name) {
+    std::scoped_lock lock{handles_latch_};
+    return read_only_tabs_.count(tab_name) != 0;
+}
+
+/** DML执行器在开始修改表之前调用 */
+void SmManager::check_writable(const std::string &tab_name) {
+    if (is_table_read_only(tab_name)) {
+        throw InternalError("Table " + tab_name + " is read-only");
+    }
+}
+
+/** 返回表的统计信息，没有执行过ANALYZE时返回nullptr */
+std::shared_ptr<const TabStats> SmManager::get_table_stats(const std::string &tab_name) {
+    std::scoped_lock lock{stats_latch_};
+    auto iter = table_stats_.find(tab_name);
+    return iter == table_stats_.end() ? nullptr : iter->second;
 }
@@ -0,0 +1,85 @@
+#include "sm_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+/** FNV-1a之后再做一次splitmix64混合，使哈希值的高位足够均匀 */
+static uint64_t hash_bytes(const char *data, int len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < len; i++) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ULL;
+    }
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+/**
+ * 哈希值的高HLL_PRECISION位选择寄存器，其余位中第一个1的位置作为rank，寄存器保存见过的最大rank
+ */
+void HyperLogLog::add(const char *data, int len) {
+    uint64_t hash = hash_bytes(data, len);
+    size_t idx = hash >> (64 - HLL_PRECISION);
+    uint64_t rest = hash << HLL_PRECISION;
+    uint8_t rank = rest == 0 ? 64 - HLL_PRECISION + 1 : __builtin_clzll(rest) + 1;
+    registers_[idx] = std::max(registers_[idx], rank);
+}
+
+void HyperLogLog::merge(const HyperLogLog &other) {
+    for (size_t i = 0; i < registers_.size(); i++) {
+        registers_[i] = std::max(registers_[i], other.registers_[i]);
+    }
+}
+
+double HyperLogLog::estimate() const {
+    double sum = 0;
+    int num_zeros = 0;
+    for (auto reg : registers_) {
+        sum += std::ldexp(1.0, -reg);
+        num_zeros += reg == 0;
+    }
+    double m = HLL_REGISTERS;
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    // 基数较小时很多寄存器仍为0，改用linear counting
+    if (estimate <= 2.5 * m && num_zeros > 0) {
+        estimate = m * std::log(m / num_zeros);
+    }
+    return estimate;
+}
+
+/**
+ * 排序后的样本直接给出最小值、最大值和等深直方图的桶边界；
+ * 全表的不同值个数用Haas-Stokes的Duj1估计量 n*d / (n - f1 + f1*n/N) 从样本推算，
+ * 其中d是样本中的不同值个数(由草图估计)，f1是样本中只出现一次的值的个数，n和N分别是样本和全表的记录数
+ */
+ColStats ColStats::build(std::vector<const char *> &values, const ColMeta &col, double num_rows) {
+    ColStats stats;
+    if (values.empty()) {
+        return stats;
+    }
+    auto less = [&](const char *a, const char *b) { return ix_compare(a, b, col.type, col.len) < 0; };
+    std::sort(values.begin(), values.end(), less);
+    size_t n = values.size();
+    stats.min_value.assign(values.front(), col.len);
+    stats.max_value.assign(values.back(), col.len);
+    int num_buckets = static_cast<int>(std::min<size_t>(HISTOGRAM_BUCKETS, n));
+    for (int i = 1; i <= num_buckets; i++) {
+        stats.histogram.emplace_back(values[i * n / num_buckets - 1], col.len);
+    }
+
+    double f1 = 0;
+    for (size_t i = 0, j; i < n; i = j) {
+        stats.sketch.add(values[i], col.len);
+        for (j = i + 1; j < n && ix_compare(values[i], values[j], col.type, col.len) == 0; j++) {
+        }
+        f1 += j - i == 1;
+    }
+    double d = std::min(std::max(stats.sketch.estimate(), 1.0), static_cast<double>(n));
+    num_rows = std::max(num_rows, static_cast<double>(n));
+    stats.num_distinct = n * d / (n - f1 + f1 * n / num_rows);
+    stats.num_distinct = std::min(std::max(stats.num_distinct, d), num_rows);
+    return stats;
+}
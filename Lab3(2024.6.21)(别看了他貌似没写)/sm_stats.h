@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "index/ix.h"
+#include "sm_meta.h"
+
+static constexpr int ANALYZE_DEFAULT_SAMPLE_PAGES = 1024;  // ANALYZE默认采样的数据页数
+static constexpr int HISTOGRAM_BUCKETS = 32;               // 等深直方图的桶数
+
+/**
+ * @brief HyperLogLog不同值计数草图
+ * 2^HLL_PRECISION个寄存器，标准误差约1.04/sqrt(2^HLL_PRECISION)≈3%；草图可以合并，持久化时只保存寄存器
+ */
+class HyperLogLog {
+   public:
+    static constexpr int HLL_PRECISION = 10;
+    static constexpr int HLL_REGISTERS = 1 << HLL_PRECISION;
+
+    HyperLogLog() : registers_(HLL_REGISTERS, 0) {}
+
+    void add(const char *data, int len);
+
+    void merge(const HyperLogLog &other);
+
+    /** 估计加入过的不同值个数 */
+    double estimate() const;
+
+    std::vector<uint8_t> &registers() { return registers_; }
+    const std::vector<uint8_t> &registers() const { return registers_; }
+
+   private:
+    std::vector<uint8_t> registers_;
+};
+
+/**
+ * @brief 一列的统计信息，值都以列的原始字节(长度为col.len)保存，比较时使用ix_compare
+ * 本存储格式中没有NULL值，因此不统计空值个数
+ */
+struct ColStats {
+    std::string min_value;               // 样本中的最小值，表为空时为空串
+    std::string max_value;               // 样本中的最大值
+    std::vector<std::string> histogram;  // 等深直方图各桶的上界，每个桶包含约num_rows/histogram.size()条记录
+    HyperLogLog sketch;                  // 样本中的不同值草图
+    double num_distinct = 0;             // 估计的全表不同值个数
+
+    /**
+     * @brief 从样本构建一列的统计信息
+     * @param values 样本中该列的值，会被排序
+     * @param num_rows 估计的全表记录数
+     */
+    static ColStats build(std::vector<const char *> &values, const ColMeta &col, double num_rows);
+};
+
+/** 一张表的统计信息，由ANALYZE采样生成并保存在系统目录中 */
+struct TabStats {
+    double num_rows = 0;    // 估计的记录数
+    int num_pages = 0;      // ANALYZE时记录文件的页数(含文件头页)
+    int sampled_pages = 0;  // 实际采样的数据页数
+    std::vector<ColStats> cols;
+};
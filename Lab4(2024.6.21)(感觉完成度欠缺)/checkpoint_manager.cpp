@@ -0,0 +1,84 @@
+#include "checkpoint_manager.h"
+
+void CheckpointManager::StartCheckpointThread(std::chrono::milliseconds interval) {
+    StopCheckpointThread();
+    {
+        std::scoped_lock lock{thread_latch_};
+        checkpoint_interval_ = interval;
+        checkpoint_enabled_ = true;
+    }
+    checkpoint_thread_ = std::thread(&CheckpointManager::RunCheckpointThread, this);
+}
+
+void CheckpointManager::StopCheckpointThread() {
+    {
+        std::scoped_lock lock{thread_latch_};
+        checkpoint_enabled_ = false;
+    }
+    thread_cv_.notify_all();
+    if (checkpoint_thread_.joinable()) {
+        checkpoint_thread_.join();
+    }
+}
+
+void CheckpointManager::RunCheckpointThread() {
+    std::unique_lock<std::mutex> lock(thread_latch_);
+    while (!thread_cv_.wait_for(lock, checkpoint_interval_, [&] { return !checkpoint_enabled_; })) {
+        lock.unlock();
+        CreateCheckpoint();
+        lock.lock();
+    }
+}
+
+/**
+ * 做一次模糊检查点
+ * 事务在整个过程中正常执行：ATT和DPT在CKPT_BEGIN之后复制，复制期间及之后产生的日志都在CKPT_BEGIN之后，
+ * 恢复时analyze从检查点开始扫描就能看到它们；写回页面走BufferPoolManager::FlushPage()，
+ * 每次只持有缓冲池latch写一个页面；被pin住的页面可能正修改到一半，不写回，它们留在之后的脏页表中，
+ * 截断日志时仍以它们的recLSN为界
+ */
+lsn_t CheckpointManager::CreateCheckpoint() {
+    std::scoped_lock lock{checkpoint_latch_};
+    LogRecord begin_log(LogType::CKPT_BEGIN, INVALID_TXN_ID);
+    lsn_t begin_lsn = log_manager_->add_log_to_buffer(&begin_log);
+
+    auto active_txns = txn_manager_->GetActiveTransactionTable();
+    auto dirty_frames = buffer_pool_manager_->GetDirtyPageTable();
+    std::vector<DirtyPageEntry> dirty_pages;
+    dirty_pages.reserve(dirty_frames.size());
+    for (auto &[page_id, rec_lsn] : dirty_frames) {
+        if (rec_lsn == INVALID_LSN) {
+            continue;
+        }
+        try {
+            dirty_pages.push_back({disk_manager_->GetFileName(page_id.fd), page_id.page_no, rec_lsn});
+        } catch (FileNotOpenError &) {
+            // 复制DPT之后文件被关闭，关闭时已经刷盘
+        }
+    }
+    lsn_t truncate_lsn = begin_lsn;
+    for (auto &entry : active_txns) {
+        truncate_lsn = std::min(truncate_lsn, entry.begin_lsn);
+    }
+    CheckpointLogRecord end_log(std::move(active_txns), std::move(dirty_pages));
+    log_manager_->WaitForFlush(log_manager_->add_log_to_buffer(&end_log));
+
+    // 分批写回检查点时的脏页，使恢复时需要redo的日志越来越少
+    size_t num_flushed = 0;
+    for (auto &entry : dirty_frames) {
+        buffer_pool_manager_->FlushPage(entry.first);
+        if (++num_flushed % FLUSH_BATCH_PAGES == 0) {
+            std::this_thread::sleep_for(FLUSH_BATCH_PAUSE);
+        }
+    }
+
+    // 写回之后仍然脏(或者又变脏)的页面，其recLSN之后的日志还需要保留
+    for (auto &[page_id, rec_lsn] : buffer_pool_manager_->GetDirtyPageTable()) {
+        if (rec_lsn != INVALID_LSN) {
+            truncate_lsn = std::min(truncate_lsn, rec_lsn);
+        }
+    }
+    log_manager_->TruncateLog(truncate_lsn);
+    num_checkpoints_.fetch_add(1, std::memory_order_relaxed);
+    return begin_lsn;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "log_manager.h"
+#include "transaction/transaction_manager.h"
+
+/**
+ * @brief 模糊检查点(fuzzy checkpoint)，不阻塞事务
+ * 1. 写CKPT_BEGIN
+ * 2. 复制活跃事务表(TransactionManager)和脏页表(BufferPoolManager)，只在复制期间持有各自的latch
+ * 3. 把ATT和DPT写入CKPT_END并等待它落盘
+ * 4. 把DPT中的页面分批写回，每批之间让出I/O，避免长时间占用磁盘带宽影响提交延迟
+ * 5. 截断日志：恢复只需要CKPT_BEGIN、活跃事务的BEGIN和仍然脏的页面的recLSN三者中最小LSN之后的日志
+ * FSM页面也在缓冲池中，随DPT一起写回；记录文件头中的num_pages不随检查点写回，
+ * 重新打开时按文件大小修正(见RmFileHandle::open_free_space_map())
+ */
+class CheckpointManager {
+   public:
+    static constexpr std::chrono::milliseconds DEFAULT_CHECKPOINT_INTERVAL{30000};
+    static constexpr size_t FLUSH_BATCH_PAGES = 64;                  // 每批写回的页面数
+    static constexpr std::chrono::milliseconds FLUSH_BATCH_PAUSE{1};  // 两批之间的间隔
+
+    CheckpointManager(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, LogManager *log_manager,
+                      TransactionManager *txn_manager)
+        : disk_manager_(disk_manager),
+          buffer_pool_manager_(buffer_pool_manager),
+          log_manager_(log_manager),
+          txn_manager_(txn_manager) {}
+
+    ~CheckpointManager() { StopCheckpointThread(); }
+
+    /** 启动后台检查点线程，每隔interval做一次检查点 */
+    void StartCheckpointThread(std::chrono::milliseconds interval = DEFAULT_CHECKPOINT_INTERVAL);
+
+    void StopCheckpointThread();
+
+    /**
+     * @brief 做一次模糊检查点
+     * @return CKPT_BEGIN的LSN
+     */
+    lsn_t CreateCheckpoint();
+
+    /** 已完成的检查点数 */
+    uint64_t GetNumCheckpoints() const { return num_checkpoints_.load(std::memory_order_relaxed); }
+
+   private:
+    void RunCheckpointThread();
+
+    DiskManager *disk_manager_;
+    BufferPoolManager *buffer_pool_manager_;
+    LogManager *log_manager_;
+    TransactionManager *txn_manager_;
+
+    std::mutex checkpoint_latch_;  // 同一时刻只有一个检查点
+    std::chrono::milliseconds checkpoint_interval_{DEFAULT_CHECKPOINT_INTERVAL};
+    std::thread checkpoint_thread_;
+    std::mutex thread_latch_;           // 保护checkpoint_enabled_
+    std::condition_variable thread_cv_;  // 用于及时停止检查点线程
+    bool checkpoint_enabled_ = false;
+    std::atomic<uint64_t> num_checkpoints_{0};
+};
@@ -1,5 +1,13 @@
 #include "lock_manager.h"
 
+#include <sched.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
 /**
  * 申请行级读锁
  * @param txn 要申请锁的事务对象指针
@@ -15,7 +23,7 @@ bool LockManager::LockSharedOnRecord(Transaction *txn, const Rid &rid, int tab_f
     // 4. 将要申请的锁放入到全局锁表中，并通过组模式来判断是否可以成功授予锁
     // 5. 如果成功，更新目标数据项在全局锁表中的信息，否则阻塞当前操作
     // 提示：步骤5中的阻塞操作可以通过条件变量来完成，所有加锁操作都遵循上述步骤，在下面的加锁操作中不再进行注释提示
-    return true;
+    return LockOnRecord(txn, rid, tab_fd, LockMode::SHARED);
 }
 
 /**
@@ -26,8 +34,7 @@ bool LockManager::LockSharedOnRecord(Transaction *txn, const Rid &rid, int tab_f
  * @return 返回加锁是否成功
  */
 bool LockManager::LockExclusiveOnRecord(Transaction *txn, const Rid &rid, int tab_fd) {
-
-    return true;
+    return LockOnRecord(txn, rid, tab_fd, LockMode::EXLUCSIVE);
 }
 
 /**
@@ -37,8 +44,7 @@ bool LockManager::LockExclusiveOnRecord(Transaction *txn, const Rid &rid, int ta
  * @return 返回加锁是否成功
  */
 bool LockManager::LockSharedOnTable(Transaction *txn, int tab_fd) {
-
-    return true;
+    return LockOnTable(txn, tab_fd, LockMode::SHARED);
 }
 
 /**
@@ -48,8 +54,7 @@ bool LockManager::LockSharedOnTable(Transaction *txn, int tab_fd) {
  * @return 返回加锁是否成功
  */
 bool LockManager::LockExclusiveOnTable(Transaction *txn, int tab_fd) {
-
-    return true;
+    return LockOnTable(txn, tab_fd, LockMode::EXLUCSIVE);
 }
 
 /**
@@ -59,8 +64,7 @@ bool LockManager::LockExclusiveOnTable(Transaction *txn, int tab_fd) {
  * @return 返回加锁是否成功
  */
 bool LockManager::LockISOnTable(Transaction *txn, int tab_fd) {
-
-    return true;
+    return LockOnTable(txn, tab_fd, LockMode::INTENTION_SHARED);
 }
 
 /**
@@ -70,8 +74,7 @@ bool LockManager::LockISOnTable(Transaction *txn, int tab_fd) {
  * @return 返回加锁是否成功
  */
 bool LockManager::LockIXOnTable(Transaction *txn, int tab_fd) {
-
-    return true;
+    return LockOnTable(txn, tab_fd, LockMode::INTENTION_EXCLUSIVE);
 }
 
 /**
@@ -81,6 +84,582 @@ bool LockManager::LockIXOnTable(Transaction *txn, int tab_fd) {
  * @return 返回解锁是否成功
  */
 bool LockManager::Unlock(Transaction *txn, LockDataId lock_data_id) {
+    if (lock_data_id.type_ == LockDataType::TABLE && FastUnlockOnTable(txn, lock_data_id.fd_)) {
+        if (txn->GetState() == TransactionState::GROWING) {
+            txn->SetState(TransactionState::SHRINKING);
+        }
+        return true;
+    }
+    if (!ReleaseLock(txn, lock_data_id)) {
+        return false;
+    }
+    if (lock_data_id.type_ == LockDataType::RECORD) {
+        auto key = RowLockCountKey(txn->GetTransactionId(), lock_data_id.fd_);
+        auto &count_partition = GetRowLockCountPartition(key);
+        std::scoped_lock lock{count_partition.latch_};
+        auto iter = count_partition.row_lock_counts_.find(key);
+        if (iter != count_partition.row_lock_counts_.end() && --iter->second.num_row_locks_ == 0) {
+            count_partition.row_lock_counts_.erase(iter);
+        }
+    }
+    if (txn->GetState() == TransactionState::GROWING) {
+        txn->SetState(TransactionState::SHRINKING);
+    }
+    return true;
+}
+
+/**
+ * 表锁的公共流程
+ * IS/IX优先走快速路径；S/X/SIX先登记到strong_requests_，阻止新的快速路径加锁，
+ * 再把已有的快速路径意向锁迁移到锁表，之后与行锁一样在LockOnData()中判断冲突。
+ * 事务已经持有S/X/SIX表锁时(如S升级为X)不重复登记，strong_requests_在这把表锁释放时减一
+ */
+bool LockManager::LockOnTable(Transaction *txn, int tab_fd, LockMode lock_mode) {
+    if (!CheckTransactionState(txn)) {
+        return false;
+    }
+    if (IsIntentionLock(lock_mode)) {
+        return FastLockOnTable(txn, tab_fd, lock_mode) ||
+               LockOnData(txn, LockDataId(tab_fd, LockDataType::TABLE), lock_mode);
+    }
+    LockDataId table_id(tab_fd, LockDataType::TABLE);
+    FastPathTable *fast_path_table = GetFastPathTable(tab_fd, true);
+    if (fast_path_table == nullptr || HoldsLock(txn, table_id, LockMode::SHARED)) {
+        return LockOnData(txn, table_id, lock_mode);
+    }
+    fast_path_table->strong_requests_.fetch_add(1);
+    bool granted = false;
+    try {
+        MigrateFastPathLocks(tab_fd, fast_path_table);
+        granted = LockOnData(txn, table_id, lock_mode);
+    } catch (...) {
+        fast_path_table->strong_requests_.fetch_sub(1);
+        throw;
+    }
+    if (!granted) {
+        fast_path_table->strong_requests_.fetch_sub(1);
+    }
+    return granted;
+}
+
+/**
+ * 先增加计数器再检查strong_requests_，与MigrateFastPathLocks()先增加strong_requests_再读取计数器相对应：
+ * 两者至少有一方能看到对方的修改，迁移不会漏掉正在加锁的事务
+ */
+bool LockManager::FastLockOnTable(Transaction *txn, int tab_fd, LockMode lock_mode) {
+    FastPathTable *fast_path_table = GetFastPathTable(tab_fd, true);
+    if (fast_path_table == nullptr || fast_path_table->strong_requests_.load() != 0) {
+        return false;
+    }
+    LockDataId table_id(tab_fd, LockDataType::TABLE);
+    auto key = RowLockCountKey(txn->GetTransactionId(), tab_fd);
+    auto &fast_path_partition = GetFastPathPartition(key);
+    std::scoped_lock lock{fast_path_partition.latch_};
+    auto iter = fast_path_partition.fast_locks_.find(key);
+    if (iter != fast_path_partition.fast_locks_.end()) {
+        // IS -> IX，尚未被迁移说明还没有S/X/SIX表锁被授予
+        iter->second = Upgrade(iter->second, lock_mode);
+        return true;
+    }
+    if (txn->GetLockSet()->count(table_id) != 0) {  // 已经在锁表中持有该表的锁
+        return false;
+    }
+    int cpu = sched_getcpu();
+    auto &counter = fast_path_table->counters_[cpu < 0 ? 0 : cpu % FAST_PATH_SLOTS].num_holders_;
+    counter.fetch_add(1);
+    if (fast_path_table->strong_requests_.load() != 0) {
+        counter.fetch_sub(1);
+        return false;
+    }
+    fast_path_partition.fast_locks_.emplace(key, lock_mode);
+    txn->GetLockSet()->insert(table_id);
+    num_fast_path_locks_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * 计数器只需要总和正确，释放时减的是当前CPU的计数器，不一定是加锁时的那个
+ */
+bool LockManager::FastUnlockOnTable(Transaction *txn, int tab_fd) {
+    FastPathTable *fast_path_table = GetFastPathTable(tab_fd, false);
+    if (fast_path_table == nullptr) {
+        return false;
+    }
+    auto key = RowLockCountKey(txn->GetTransactionId(), tab_fd);
+    auto &fast_path_partition = GetFastPathPartition(key);
+    std::scoped_lock lock{fast_path_partition.latch_};
+    if (fast_path_partition.fast_locks_.erase(key) == 0) {
+        return false;
+    }
+    int cpu = sched_getcpu();
+    fast_path_table->counters_[cpu < 0 ? 0 : cpu % FAST_PATH_SLOTS].num_holders_.fetch_sub(1);
+    return true;
+}
+
+/**
+ * 把快速路径上的意向锁作为已授予的请求放入锁表，直到计数器总和为0；
+ * 计数器已经加一但还没有登记到fast_path_partitions_的事务会在很短时间内完成登记，此时让出CPU后重新扫描
+ */
+void LockManager::MigrateFastPathLocks(int tab_fd, FastPathTable *fast_path_table) {
+    LockDataId table_id(tab_fd, LockDataType::TABLE);
+    while (fast_path_table->num_holders() != 0) {
+        for (auto &fast_path_partition : fast_path_partitions_) {
+            std::scoped_lock fast_path_lock{fast_path_partition.latch_};
+            for (auto iter = fast_path_partition.fast_locks_.begin(); iter != fast_path_partition.fast_locks_.end();) {
+                if (static_cast<int>(static_cast<uint32_t>(iter->first)) != tab_fd) {
+                    ++iter;
+                    continue;
+                }
+                {
+                    auto &partition = GetPartition(table_id);
+                    std::scoped_lock lock{partition.latch_};
+                    auto &queue = partition.lock_table_[table_id];
+                    auto &request = queue.request_queue_.emplace_back(static_cast<txn_id_t>(iter->first >> 32),
+                                                                      iter->second);
+                    request.granted_ = true;
+                    UpdateGroupLockMode(queue);
+                }
+                fast_path_table->counters_[0].num_holders_.fetch_sub(1);
+                iter = fast_path_partition.fast_locks_.erase(iter);
+                num_migrated_fast_path_locks_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (fast_path_table->num_holders() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+LockManager::FastPathTable *LockManager::GetFastPathTable(int tab_fd, bool create) {
+    if (tab_fd < 0 || tab_fd >= MAX_FAST_PATH_FDS) {
+        return nullptr;
+    }
+    FastPathTable *fast_path_table = fast_path_tables_[tab_fd].load();
+    if (fast_path_table == nullptr && create) {
+        auto new_table = new FastPathTable();
+        if (fast_path_tables_[tab_fd].compare_exchange_strong(fast_path_table, new_table)) {
+            fast_path_table = new_table;
+        } else {
+            delete new_table;
+        }
+    }
+    return fast_path_table;
+}
+
+/**
+ * 行锁的公共流程
+ * 每个事务在每张表上的行锁数超过escalation_threshold_时，升级为表锁并释放这些行锁，
+ * 之后该事务在这张表上的行锁请求直接由表锁满足，不再进入锁表
+ * @param txn 要申请锁的事务对象指针
+ * @param rid 加锁的目标记录ID
+ * @param tab_fd 记录所在的表的fd
+ * @param lock_mode SHARED或EXLUCSIVE
+ * @return 返回加锁是否成功
+ */
+bool LockManager::LockOnRecord(Transaction *txn, const Rid &rid, int tab_fd, LockMode lock_mode) {
+    LockDataId table_id(tab_fd, LockDataType::TABLE);
+    if (HoldsLock(txn, table_id, lock_mode)) {
+        return true;
+    }
+    LockMode intention_mode =
+        lock_mode == LockMode::SHARED ? LockMode::INTENTION_SHARED : LockMode::INTENTION_EXCLUSIVE;
+    if (!LockOnTable(txn, tab_fd, intention_mode)) {
+        return false;
+    }
+    LockDataId record_id(tab_fd, rid, LockDataType::RECORD);
+    bool is_new = txn->GetLockSet()->count(record_id) == 0;
+    if (!LockOnData(txn, record_id, lock_mode)) {
+        return false;
+    }
+
+    size_t threshold = escalation_threshold_.load(std::memory_order_relaxed);
+    bool escalate = false;
+    bool exclusive = false;
+    {
+        auto key = RowLockCountKey(txn->GetTransactionId(), tab_fd);
+        auto &count_partition = GetRowLockCountPartition(key);
+        std::scoped_lock lock{count_partition.latch_};
+        auto &count = count_partition.row_lock_counts_[key];
+        count.num_row_locks_ += is_new;
+        count.has_exclusive_ |= lock_mode == LockMode::EXLUCSIVE;
+        escalate = threshold != 0 && count.num_row_locks_ >= threshold;
+        exclusive = count.has_exclusive_;
+    }
+    if (escalate) {
+        EscalateToTable(txn, tab_fd, exclusive);
+    }
+    return true;
+}
+
+/**
+ * 锁升级
+ * 表上已有的IS/IX锁按LockOnData()的升级规则合并：只读时IS -> S、IX -> SIX，有写时升级为X，
+ * 与其他事务的表锁冲突时同样按wait-die等待或abort；拿到表锁后再释放行锁，保证任何时刻都有锁保护。
+ * 没有拿到表锁(事务已经结束)时保留行锁不变
+ */
+void LockManager::EscalateToTable(Transaction *txn, int tab_fd, bool exclusive) {
+    if (!LockOnTable(txn, tab_fd, exclusive ? LockMode::EXLUCSIVE : LockMode::SHARED)) {
+        return;
+    }
+
+    auto lock_set = txn->GetLockSet();
+    std::vector<LockDataId> row_locks;
+    for (auto &lock_data_id : *lock_set) {
+        if (lock_data_id.type_ == LockDataType::RECORD && lock_data_id.fd_ == tab_fd) {
+            row_locks.push_back(lock_data_id);
+        }
+    }
+    for (auto &lock_data_id : row_locks) {
+        ReleaseLock(txn, lock_data_id);
+        lock_set->erase(lock_data_id);
+    }
+    {
+        auto key = RowLockCountKey(txn->GetTransactionId(), tab_fd);
+        auto &count_partition = GetRowLockCountPartition(key);
+        std::scoped_lock lock{count_partition.latch_};
+        count_partition.row_lock_counts_.erase(key);
+    }
+    num_escalations_.fetch_add(1, std::memory_order_relaxed);
+    num_escalated_row_locks_.fetch_add(row_locks.size(), std::memory_order_relaxed);
+}
+
+bool LockManager::HoldsLock(Transaction *txn, const LockDataId &lock_data_id, LockMode lock_mode) {
+    auto &partition = GetPartition(lock_data_id);
+    std::scoped_lock lock{partition.latch_};
+    auto queue_iter = partition.lock_table_.find(lock_data_id);
+    if (queue_iter == partition.lock_table_.end()) {
+        return false;
+    }
+    for (auto &request : queue_iter->second.request_queue_) {
+        if (request.txn_id_ == txn->GetTransactionId()) {
+            return request.granted_ && IsCovered(request.lock_mode_, lock_mode);
+        }
+    }
+    return false;
+}
+
+bool LockManager::ReleaseLock(Transaction *txn, const LockDataId &lock_data_id) {
+    auto &partition = GetPartition(lock_data_id);
+    std::unique_lock<std::mutex> lock(partition.latch_);
+    auto queue_iter = partition.lock_table_.find(lock_data_id);
+    if (queue_iter == partition.lock_table_.end()) {
+        return false;
+    }
+    auto &queue = queue_iter->second;
+    auto iter = std::find_if(queue.request_queue_.begin(), queue.request_queue_.end(),
+                             [&](const LockRequest &request) { return request.txn_id_ == txn->GetTransactionId(); });
+    if (iter == queue.request_queue_.end()) {
+        return false;
+    }
+    if (lock_data_id.type_ == LockDataType::TABLE && iter->granted_ && !IsIntentionLock(iter->lock_mode_)) {
+        if (FastPathTable *fast_path_table = GetFastPathTable(lock_data_id.fd_, false)) {
+            fast_path_table->strong_requests_.fetch_sub(1);
+        }
+    }
+    queue.request_queue_.erase(iter);
+    if (queue.request_queue_.empty()) {
+        // 队列为空说明没有事务在cv_上等待，可以直接删除
+        partition.lock_table_.erase(queue_iter);
+    } else {
+        UpdateGroupLockMode(queue);
+        queue.cv_.notify_all();
+    }
+    return true;
+}
+
+/**
+ * 所有加锁操作的公共流程
+ * 冲突时在该数据对象的条件变量上等待。DeadlockMode::PREVENTION下采用wait-die：与更老(txn_id更小)的事务
+ * 冲突时直接abort，等待关系只能从老事务指向新事务，不会形成环；DeadlockMode::DETECTION下总是等待，
+ * 由检测线程标记牺牲者并唤醒
+ * @param txn 要申请锁的事务对象指针
+ * @param lock_data_id 加锁的目标数据对象
+ * @param lock_mode 申请的锁类型
+ * @return 返回加锁是否成功
+ */
+bool LockManager::LockOnData(Transaction *txn, const LockDataId &lock_data_id, LockMode lock_mode) {
+    if (!CheckTransactionState(txn)) {
+        return false;
+    }
+
+    txn_id_t txn_id = txn->GetTransactionId();
+    auto &partition = GetPartition(lock_data_id);
+    std::unique_lock<std::mutex> lock(partition.latch_);
+    auto &queue = partition.lock_table_[lock_data_id];
+
+    // 查找当前事务是否已经持有该数据对象上的锁
+    auto iter = std::find_if(queue.request_queue_.begin(), queue.request_queue_.end(),
+                             [&](const LockRequest &request) { return request.txn_id_ == txn_id; });
+    LockMode target_mode = lock_mode;
+    bool upgrading = iter != queue.request_queue_.end();
+    if (upgrading) {
+        if (IsCovered(iter->lock_mode_, lock_mode)) {
+            return true;
+        }
+        if (queue.upgrading_) {
+            txn->SetState(TransactionState::ABORTED);
+            throw TransactionAbortException(txn_id, AbortReason::UPGRADE_CONFLICT);
+        }
+        target_mode = Upgrade(iter->lock_mode_, lock_mode);
+        queue.upgrading_ = true;
+    } else {
+        iter = queue.request_queue_.emplace(queue.request_queue_.end(), txn_id, lock_mode);
+    }
+
+    // 撤销本次申请，已授予的锁保留，由abort统一释放
+    auto cancel_request = [&](AbortReason reason) {
+        if (upgrading) {
+            queue.upgrading_ = false;
+            iter->waiting_ = false;
+            iter->aborted_ = false;
+        } else {
+            queue.request_queue_.erase(iter);
+        }
+        if (queue.request_queue_.empty()) {
+            partition.lock_table_.erase(lock_data_id);
+        } else {
+            UpdateGroupLockMode(queue);
+            queue.cv_.notify_all();
+        }
+        txn->SetState(TransactionState::ABORTED);
+        throw TransactionAbortException(txn_id, reason);
+    };
+
+    while (true) {
+        bool conflict = false;
+        bool conflict_with_older = false;
+        for (auto &request : queue.request_queue_) {
+            if (request.granted_ && request.txn_id_ != txn_id && !IsCompatible(request.lock_mode_, target_mode)) {
+                conflict = true;
+                conflict_with_older |= request.txn_id_ < txn_id;
+            }
+        }
+        if (!conflict) {
+            break;
+        }
+        if (conflict_with_older && deadlock_mode_ == DeadlockMode::PREVENTION) {
+            cancel_request(AbortReason::DEADLOCK_PREVENTION);  // die
+        }
+        queue.is_waiting_ = true;
+        iter->waiting_ = true;
+        iter->wait_mode_ = target_mode;
+        queue.cv_.wait(lock);
+        iter->waiting_ = false;
+        if (iter->aborted_) {
+            cancel_request(AbortReason::DEADLOCK_DETECTION);
+        }
+    }
+
+    iter->lock_mode_ = target_mode;
+    iter->granted_ = true;
+    if (upgrading) {
+        queue.upgrading_ = false;
+    }
+    UpdateGroupLockMode(queue);
+    txn->GetLockSet()->insert(lock_data_id);
+    return true;
+}
 
+bool LockManager::CheckTransactionState(Transaction *txn) {
+    if (txn->GetState() == TransactionState::SHRINKING) {
+        txn->SetState(TransactionState::ABORTED);
+        throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_SHIRINKING);
+    }
+    if (txn->GetState() == TransactionState::ABORTED || txn->GetState() == TransactionState::COMMITTED) {
+        return false;
+    }
+    txn->SetState(TransactionState::GROWING);
     return true;
-}
\ No newline at end of file
+}
+
+bool LockManager::IsCompatible(LockMode held, LockMode requested) {
+    switch (held) {
+        case LockMode::INTENTION_SHARED:
+            return requested != LockMode::EXLUCSIVE;
+        case LockMode::INTENTION_EXCLUSIVE:
+            return requested == LockMode::INTENTION_SHARED || requested == LockMode::INTENTION_EXCLUSIVE;
+        case LockMode::SHARED:
+            return requested == LockMode::INTENTION_SHARED || requested == LockMode::SHARED;
+        case LockMode::S_IX:
+            return requested == LockMode::INTENTION_SHARED;
+        default:
+            return false;
+    }
+}
+
+bool LockManager::IsCovered(LockMode held, LockMode requested) {
+    if (held == requested || held == LockMode::EXLUCSIVE) {
+        return true;
+    }
+    switch (held) {
+        case LockMode::S_IX:
+            return requested != LockMode::EXLUCSIVE;
+        case LockMode::SHARED:
+        case LockMode::INTENTION_EXCLUSIVE:
+            return requested == LockMode::INTENTION_SHARED;
+        default:
+            return false;
+    }
+}
+
+LockManager::LockMode LockManager::Upgrade(LockMode held, LockMode requested) {
+    if (IsCovered(requested, held)) {
+        return requested;
+    }
+    if ((held == LockMode::SHARED && requested == LockMode::INTENTION_EXCLUSIVE) ||
+        (held == LockMode::INTENTION_EXCLUSIVE && requested == LockMode::SHARED)) {
+        return LockMode::S_IX;
+    }
+    return LockMode::EXLUCSIVE;
+}
+
+void LockManager::UpdateGroupLockMode(LockRequestQueue &queue) {
+    bool has[5] = {false, false, false, false, false};
+    queue.shared_lock_num_ = 0;
+    queue.IX_lock_num_ = 0;
+    queue.is_waiting_ = false;
+    for (auto &request : queue.request_queue_) {
+        if (!request.granted_) {
+            queue.is_waiting_ = true;
+            continue;
+        }
+        has[static_cast<int>(request.lock_mode_)] = true;
+        queue.shared_lock_num_ += request.lock_mode_ == LockMode::SHARED;
+        queue.IX_lock_num_ += request.lock_mode_ == LockMode::INTENTION_EXCLUSIVE;
+    }
+    if (has[static_cast<int>(LockMode::EXLUCSIVE)]) {
+        queue.group_lock_mode_ = GroupLockMode::X;
+    } else if (has[static_cast<int>(LockMode::S_IX)] ||
+               (has[static_cast<int>(LockMode::SHARED)] && has[static_cast<int>(LockMode::INTENTION_EXCLUSIVE)])) {
+        queue.group_lock_mode_ = GroupLockMode::SIX;
+    } else if (has[static_cast<int>(LockMode::SHARED)]) {
+        queue.group_lock_mode_ = GroupLockMode::S;
+    } else if (has[static_cast<int>(LockMode::INTENTION_EXCLUSIVE)]) {
+        queue.group_lock_mode_ = GroupLockMode::IX;
+    } else if (has[static_cast<int>(LockMode::INTENTION_SHARED)]) {
+        queue.group_lock_mode_ = GroupLockMode::IS;
+    } else {
+        queue.group_lock_mode_ = GroupLockMode::NON_LOCK;
+    }
+}
+void LockManager::EnableDeadlockDetection(std::chrono::milliseconds interval) {
+    DisableDeadlockDetection();
+    {
+        std::scoped_lock lock{detection_latch_};
+        detection_interval_ = interval;
+        detection_enabled_ = true;
+    }
+    deadlock_mode_ = DeadlockMode::DETECTION;
+    detection_thread_ = std::thread(&LockManager::RunDeadlockDetection, this);
+}
+
+void LockManager::DisableDeadlockDetection() {
+    {
+        std::scoped_lock lock{detection_latch_};
+        detection_enabled_ = false;
+    }
+    detection_cv_.notify_all();
+    if (detection_thread_.joinable()) {
+        detection_thread_.join();
+    }
+    deadlock_mode_ = DeadlockMode::PREVENTION;
+}
+
+void LockManager::RunDeadlockDetection() {
+    std::unique_lock<std::mutex> lock(detection_latch_);
+    while (!detection_cv_.wait_for(lock, detection_interval_, [&] { return !detection_enabled_; })) {
+        lock.unlock();
+        DetectAndBreakDeadlocks();
+        lock.lock();
+    }
+}
+
+/**
+ * 构建等待图并打破所有的环
+ * 等待图的边 waiter -> holder 表示waiter申请的锁与holder已授予的锁不相容；
+ * 每找到一个环就abort环中最年轻(txn_id最大)的事务，把它从图中删除后继续找，直到图中无环。
+ * 检测期间按下标顺序锁住所有分区，得到锁表的一致快照，不会误判已经解除的等待
+ */
+void LockManager::DetectAndBreakDeadlocks() {
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(LOCK_TABLE_PARTITIONS);
+    for (auto &partition : partitions_) {
+        locks.emplace_back(partition.latch_);
+    }
+
+    // 用有序容器保存等待图，使每次检测的搜索顺序确定
+    std::map<txn_id_t, std::set<txn_id_t>> waits_for;
+    std::map<txn_id_t, std::pair<LockRequest *, LockRequestQueue *>> waiting_requests;
+    for (auto &partition : partitions_) {
+        for (auto &[lock_data_id, queue] : partition.lock_table_) {
+            for (auto &waiter : queue.request_queue_) {
+                if (!waiter.waiting_ || waiter.aborted_) {
+                    continue;
+                }
+                waiting_requests[waiter.txn_id_] = {&waiter, &queue};
+                for (auto &holder : queue.request_queue_) {
+                    if (holder.granted_ && holder.txn_id_ != waiter.txn_id_ &&
+                        !IsCompatible(holder.lock_mode_, waiter.wait_mode_)) {
+                        waits_for[waiter.txn_id_].insert(holder.txn_id_);
+                    }
+                }
+            }
+        }
+    }
+
+    // DFS找环，返回环中最年轻的事务，没有环返回INVALID_TXN_ID
+    std::set<txn_id_t> visited;
+    std::vector<txn_id_t> path;
+    std::set<txn_id_t> on_path;
+    std::function<txn_id_t(txn_id_t)> find_cycle = [&](txn_id_t txn_id) -> txn_id_t {
+        visited.insert(txn_id);
+        path.push_back(txn_id);
+        on_path.insert(txn_id);
+        auto edges = waits_for.find(txn_id);
+        if (edges != waits_for.end()) {
+            for (txn_id_t next : edges->second) {
+                if (on_path.count(next)) {
+                    auto cycle_begin = std::find(path.begin(), path.end(), next);
+                    return *std::max_element(cycle_begin, path.end());
+                }
+                if (!visited.count(next)) {
+                    txn_id_t victim = find_cycle(next);
+                    if (victim != INVALID_TXN_ID) {
+                        return victim;
+                    }
+                }
+            }
+        }
+        path.pop_back();
+        on_path.erase(txn_id);
+        return INVALID_TXN_ID;
+    };
+
+    while (true) {
+        txn_id_t victim = INVALID_TXN_ID;
+        visited.clear();
+        for (auto &[txn_id, edges] : waits_for) {
+            if (visited.count(txn_id)) {
+                continue;
+            }
+            path.clear();
+            on_path.clear();
+            victim = find_cycle(txn_id);
+            if (victim != INVALID_TXN_ID) {
+                break;
+            }
+        }
+        if (victim == INVALID_TXN_ID) {
+            break;
+        }
+        // 环中的事务都在等待，牺牲者一定有正在等待的请求
+        auto [request, queue] = waiting_requests.at(victim);
+        request->aborted_ = true;
+        queue->cv_.notify_all();
+        num_deadlock_victims_.fetch_add(1, std::memory_order_relaxed);
+        waits_for.erase(victim);
+        for (auto &[txn_id, edges] : waits_for) {
+            edges.erase(victim);
+        }
+    }
+}
@@ -1,11 +1,23 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
+#include <list>
+#include <thread>
+#include <unordered_map>
 #include "transaction/transaction.h"
 
 static const std::string GroupLockModeStr[10] = {"NON_LOCK", "IS", "IX", "S", "X", "SIX"};
 
+/**
+ * @brief 死锁处理方式
+ * PREVENTION: wait-die，与更老的事务冲突时立即abort
+ * DETECTION: 冲突时总是等待，由后台线程周期性地在等待图(wait-for graph)中找环，abort环中最年轻的事务
+ */
+enum class DeadlockMode { PREVENTION, DETECTION };
+
 class LockManager {
     enum class LockMode { SHARED, EXLUCSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE, S_IX };
     /**
@@ -27,6 +39,10 @@ class LockManager {
         txn_id_t txn_id_;
         LockMode lock_mode_;
         bool granted_;
+        // 以下仅用于死锁检测
+        bool waiting_ = false;   // 是否正在等待(新申请或升级)
+        LockMode wait_mode_;     // 等待授予的锁，升级时为升级后的锁
+        bool aborted_ = false;   // 被死锁检测选为牺牲者，唤醒后abort
     };
 
     class LockRequestQueue {
@@ -48,10 +64,90 @@ class LockManager {
         int IX_lock_num_ = 0;
     };
 
+    /**
+     * @brief 锁表的一个分区
+     * 锁表按LockDataId::Get()的哈希值划分为LOCK_TABLE_PARTITIONS个分区，每个分区有自己的latch_，
+     * 不同数据对象上的加锁/解锁只在落入同一分区时才会互相阻塞；每个LockRequestQueue有自己的条件变量，
+     * 解锁时只唤醒等待同一数据对象的事务
+     */
+    struct alignas(64) LockTablePartition {
+        std::mutex latch_;                                          // 保护本分区的lock_table_
+        std::unordered_map<LockDataId, LockRequestQueue> lock_table_;
+    };
+
+    /* 一个事务在一张表上持有的行锁，用于判断是否需要锁升级(escalation) */
+    struct RowLockCount {
+        size_t num_row_locks_ = 0;   // 行锁个数
+        bool has_exclusive_ = false;  // 是否持有X行锁，决定升级为表级S锁还是X锁
+    };
+
+    static constexpr int FAST_PATH_SLOTS = 16;     // 每张表的意向锁计数器个数
+    static constexpr int MAX_FAST_PATH_FDS = 1024;  // fd小于该值的表才使用快速路径
+
+    /* 行锁计数表的一个分区，按(txn_id, tab_fd)划分 */
+    struct alignas(64) RowLockCountPartition {
+        std::mutex latch_;
+        std::unordered_map<int64_t, RowLockCount> row_lock_counts_;   // key: (txn_id << 32) | tab_fd
+    };
+
+    /**
+     * @brief 一张表的意向锁快速路径
+     * 没有S/X/SIX表锁请求时，IS/IX表锁不进入锁表，只在持有者所在CPU对应的计数器上加一，
+     * 并在fast_path_partitions_中记下(事务, 表) -> 锁类型；计数器按CPU分开，热点表上的并发加锁不会争抢同一个缓存行。
+     * 申请S/X/SIX表锁时先增加strong_requests_，使新的意向锁改走慢路径，再把已经通过快速路径授予的意向锁
+     * 迁移到锁表中，之后按正常流程判断冲突
+     */
+    struct FastPathTable {
+        struct alignas(64) Counter {
+            std::atomic<int64_t> num_holders_{0};
+        };
+        std::atomic<int> strong_requests_{0};   // 已持有或正在申请的S/X/SIX表锁个数
+        Counter counters_[FAST_PATH_SLOTS];      // 通过快速路径持有意向锁的事务数，按CPU分开计数，单个计数器可能为负
+
+        int64_t num_holders() const {
+            int64_t num_holders = 0;
+            for (auto &counter : counters_) {
+                num_holders += counter.num_holders_.load();
+            }
+            return num_holders;
+        }
+    };
+
+    /* 通过快速路径持有的意向锁的一个分区，按(txn_id, tab_fd)划分 */
+    struct alignas(64) FastPathPartition {
+        std::mutex latch_;
+        std::unordered_map<int64_t, LockMode> fast_locks_;  // key: (txn_id << 32) | tab_fd
+    };
+
 public:
+    static constexpr int LOCK_TABLE_PARTITION_BITS = 6;
+    static constexpr int LOCK_TABLE_PARTITIONS = 1 << LOCK_TABLE_PARTITION_BITS;
+
+    static constexpr size_t DEFAULT_ESCALATION_THRESHOLD = 5000;  // 单个事务在一张表上的行锁数上限
+    static constexpr std::chrono::milliseconds DEFAULT_DETECTION_INTERVAL{50};
+
     LockManager() {}
 
-    ~LockManager() {}
+    ~LockManager() {
+        DisableDeadlockDetection();
+        for (auto &fast_path_table : fast_path_tables_) {
+            delete fast_path_table.load();
+        }
+    }
+
+    /**
+     * @brief 切换到死锁检测模式并启动后台检测线程，每隔interval检测一次
+     * @note 应在没有事务等待锁时切换死锁处理方式
+     */
+    void EnableDeadlockDetection(std::chrono::milliseconds interval = DEFAULT_DETECTION_INTERVAL);
+
+    /** 停止后台检测线程，回到wait-die */
+    void DisableDeadlockDetection();
+
+    DeadlockMode GetDeadlockMode() const { return deadlock_mode_; }
+
+    /** 死锁检测abort的事务数 */
+    uint64_t GetNumDeadlockVictims() const { return num_deadlock_victims_.load(std::memory_order_relaxed); }
 
     bool LockSharedOnRecord(Transaction *txn, const Rid &rid, int tab_fd);
 
@@ -67,7 +163,116 @@ public:
 
     bool Unlock(Transaction *txn, LockDataId lock_data_id);
 
+    /** 设置锁升级的阈值，0表示不做锁升级 */
+    void SetEscalationThreshold(size_t threshold) { escalation_threshold_ = threshold; }
+
+    size_t GetEscalationThreshold() const { return escalation_threshold_; }
+
+    /** 发生锁升级的次数 */
+    uint64_t GetNumEscalations() const { return num_escalations_.load(std::memory_order_relaxed); }
+
+    /** 因锁升级而提前释放的行锁个数 */
+    uint64_t GetNumEscalatedRowLocks() const { return num_escalated_row_locks_.load(std::memory_order_relaxed); }
+
+    /** 通过快速路径授予的意向锁个数 */
+    uint64_t GetNumFastPathLocks() const { return num_fast_path_locks_.load(std::memory_order_relaxed); }
+
+    /** 因S/X/SIX表锁请求而迁移到锁表中的意向锁个数 */
+    uint64_t GetNumMigratedFastPathLocks() const { return num_migrated_fast_path_locks_.load(std::memory_order_relaxed); }
+
 private:
-    std::mutex latch_;  // 互斥锁，用于锁表的互斥访问
-    std::unordered_map<LockDataId, LockRequestQueue> lock_table_;   // 全局锁表
+    /** 表锁的公共流程：IS/IX先尝试快速路径，S/X/SIX在进入锁表之前迁移快速路径上的意向锁 */
+    bool LockOnTable(Transaction *txn, int tab_fd, LockMode lock_mode);
+
+    /** 尝试通过快速路径授予IS/IX表锁，表上有S/X/SIX请求或事务已经在锁表中持有该表的锁时返回false */
+    bool FastLockOnTable(Transaction *txn, int tab_fd, LockMode lock_mode);
+
+    /** 释放通过快速路径持有的表锁，不存在时返回false */
+    bool FastUnlockOnTable(Transaction *txn, int tab_fd);
+
+    /** 把所有事务通过快速路径持有的tab_fd上的意向锁迁移到锁表中 */
+    void MigrateFastPathLocks(int tab_fd, FastPathTable *fast_path_table);
+
+    /** tab_fd的快速路径，create为true时按需创建；fd超出范围时返回nullptr，该表总是走慢路径 */
+    FastPathTable *GetFastPathTable(int tab_fd, bool create);
+
+    FastPathPartition &GetFastPathPartition(int64_t key) {
+        return fast_path_partitions_[(static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL) >>
+                                     (64 - LOCK_TABLE_PARTITION_BITS)];
+    }
+
+    static bool IsIntentionLock(LockMode lock_mode) {
+        return lock_mode == LockMode::INTENTION_SHARED || lock_mode == LockMode::INTENTION_EXCLUSIVE;
+    }
+
+    /** 检查并推进事务状态，事务已经结束时返回false */
+    static bool CheckTransactionState(Transaction *txn);
+
+    /** 行锁的公共流程：表上已有足够强的锁时不再加行锁，否则先加意向锁再加行锁，并检查是否需要锁升级 */
+    bool LockOnRecord(Transaction *txn, const Rid &rid, int tab_fd, LockMode lock_mode);
+
+    /** 锁升级：申请表级S/X锁，然后释放该事务在这张表上的所有行锁 */
+    void EscalateToTable(Transaction *txn, int tab_fd, bool exclusive);
+
+    /** txn是否已经持有lock_data_id上包含lock_mode权限的锁 */
+    bool HoldsLock(Transaction *txn, const LockDataId &lock_data_id, LockMode lock_mode);
+
+    /** 从锁表中删除txn在lock_data_id上的锁，不改变事务状态 */
+    bool ReleaseLock(Transaction *txn, const LockDataId &lock_data_id);
+
+    RowLockCountPartition &GetRowLockCountPartition(int64_t key) {
+        return row_lock_count_partitions_[(static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL) >>
+                                          (64 - LOCK_TABLE_PARTITION_BITS)];
+    }
+
+    static int64_t RowLockCountKey(txn_id_t txn_id, int tab_fd) {
+        return (static_cast<int64_t>(txn_id) << 32) | static_cast<uint32_t>(tab_fd);
+    }
+
+    /** 所有加锁操作的公共流程 */
+    bool LockOnData(Transaction *txn, const LockDataId &lock_data_id, LockMode lock_mode);
+
+    LockTablePartition &GetPartition(const LockDataId &lock_data_id) {
+        // Get()的低位主要来自slot_no/fd，乘以黄金分割常数后取高位，使相邻的rid分散到不同分区
+        uint64_t hash = static_cast<uint64_t>(lock_data_id.Get()) * 0x9E3779B97F4A7C15ULL;
+        return partitions_[hash >> (64 - LOCK_TABLE_PARTITION_BITS)];
+    }
+
+    /** 两个不同事务的锁是否相容 */
+    static bool IsCompatible(LockMode held, LockMode requested);
+
+    /** held是否已经包含了requested的权限，如持有X时再申请S */
+    static bool IsCovered(LockMode held, LockMode requested);
+
+    /** 同一事务先后申请的两种锁合并(升级)后的锁，如S + IX = SIX */
+    static LockMode Upgrade(LockMode held, LockMode requested);
+
+    /** 根据已授予的锁重新计算group_lock_mode_ */
+    static void UpdateGroupLockMode(LockRequestQueue &queue);
+
+    /** 后台检测线程的主循环 */
+    void RunDeadlockDetection();
+
+    /** 锁住所有分区，构建等待图并打破其中所有的环 */
+    void DetectAndBreakDeadlocks();
+
+    LockTablePartition partitions_[LOCK_TABLE_PARTITIONS];  // 分区的全局锁表
+    RowLockCountPartition row_lock_count_partitions_[LOCK_TABLE_PARTITIONS];
+
+    std::atomic<FastPathTable *> fast_path_tables_[MAX_FAST_PATH_FDS] = {};  // 按fd下标，按需创建
+    FastPathPartition fast_path_partitions_[LOCK_TABLE_PARTITIONS];
+    std::atomic<uint64_t> num_fast_path_locks_{0};
+    std::atomic<uint64_t> num_migrated_fast_path_locks_{0};
+
+    std::atomic<size_t> escalation_threshold_{DEFAULT_ESCALATION_THRESHOLD};
+    std::atomic<uint64_t> num_escalations_{0};
+    std::atomic<uint64_t> num_escalated_row_locks_{0};
+
+    std::atomic<DeadlockMode> deadlock_mode_{DeadlockMode::PREVENTION};
+    std::chrono::milliseconds detection_interval_{DEFAULT_DETECTION_INTERVAL};
+    std::thread detection_thread_;
+    std::mutex detection_latch_;           // 保护detection_enabled_
+    std::condition_variable detection_cv_;  // 用于及时停止检测线程
+    bool detection_enabled_ = false;
+    std::atomic<uint64_t> num_deadlock_victims_{0};
 };
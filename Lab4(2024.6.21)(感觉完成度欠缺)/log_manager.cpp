@@ -0,0 +1,170 @@
+#include "log_manager.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+
+LogManager::LogManager(DiskManager *disk_manager)
+    : disk_manager_(disk_manager),
+      active_buffer_(std::make_unique<LogBuffer>()),
+      flush_buffer_(std::make_unique<LogBuffer>()) {
+    log_file_size_ = std::max<off_t>(disk_manager_->GetFileSize(LOG_FILE_NAME), 0);
+    flush_thread_ = std::thread(&LogManager::RunFlushThread, this);
+}
+
+/**
+ * 停止flush线程，退出前会把缓冲区中剩余的日志刷盘
+ */
+LogManager::~LogManager() {
+    {
+        std::unique_lock<std::mutex> lock(latch_);
+        shutdown_ = true;
+    }
+    flush_cv_.notify_one();
+    flush_thread_.join();
+}
+
+/**
+ * 为日志记录分配LSN并追加到active_buffer_
+ * LSN在latch_内分配，因此缓冲区(以及日志文件)中的日志记录按LSN递增排列
+ * @param log_record 日志记录，调用者需要事先设置好log_tid_和prev_lsn_
+ * @return 分配的LSN
+ */
+lsn_t LogManager::add_log_to_buffer(LogRecord *log_record) {
+    std::unique_lock<std::mutex> lock(latch_);
+    int len = static_cast<int>(log_record->log_tot_len_);
+    if (len > LOG_BUFFER_SIZE) {
+        throw InternalError("LogManager::add_log_to_buffer: log record is larger than the log buffer");
+    }
+    while (active_buffer_->is_full(len)) {
+        // 缓冲区已满，请求flush线程交换缓冲区
+        flush_requested_ = true;
+        flush_cv_.notify_one();
+        persist_cv_.wait(lock);
+    }
+    log_record->lsn_ = next_lsn_++;
+    if (active_buffer_->offset_ == 0) {
+        active_buffer_->first_lsn_ = log_record->lsn_;
+    }
+    log_record->serialize(active_buffer_->buffer_ + active_buffer_->offset_);
+    active_buffer_->offset_ += len;
+    active_buffer_->last_lsn_ = log_record->lsn_;
+    return log_record->lsn_;
+}
+
+/**
+ * 等待LSN <= lsn的日志落盘
+ * 多个事务同时等待时只会触发一次刷盘，它们的日志由同一次fsync持久化
+ */
+void LogManager::WaitForFlush(lsn_t lsn) {
+    if (persist_lsn_.load() >= lsn) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(latch_);
+    while (persist_lsn_.load() < lsn) {
+        flush_requested_ = true;
+        flush_cv_.notify_one();
+        persist_cv_.wait(lock);
+    }
+}
+
+void LogManager::flush_log_to_disk() { WaitForFlush(next_lsn_.load() - 1); }
+
+/**
+ * flush线程的主循环
+ * 被唤醒(或超时)后如果active_buffer_中有日志，就在latch_内与flush_buffer_交换，
+ * 然后释放latch_写入日志文件并fsync，最后推进persist_lsn_并唤醒等待的事务。
+ * flush_buffer_只在上一次刷盘完成后才会被换回，所以交换时它一定是空的
+ */
+void LogManager::RunFlushThread() {
+    std::unique_lock<std::mutex> lock(latch_);
+    while (true) {
+        flush_cv_.wait_for(lock, LOG_FLUSH_INTERVAL, [&] { return flush_requested_ || shutdown_; });
+        flush_requested_ = false;
+        if (active_buffer_->offset_ == 0) {
+            persist_cv_.notify_all();
+            if (shutdown_) {
+                return;
+            }
+            continue;
+        }
+        std::swap(active_buffer_, flush_buffer_);
+        // 等待缓冲区空间的事务现在可以向新的active_buffer_追加
+        persist_cv_.notify_all();
+        lock.unlock();
+
+        disk_manager_->WriteLog(flush_buffer_->buffer_, flush_buffer_->offset_);
+        disk_manager_->SyncLog();
+        num_flushes_++;
+        {
+            std::scoped_lock batch_lock{batch_latch_};
+            flushed_batches_.emplace_back(flush_buffer_->first_lsn_, log_file_size_);
+        }
+        log_file_size_ += flush_buffer_->offset_;
+        persist_lsn_.store(flush_buffer_->last_lsn_);
+        flush_buffer_->offset_ = 0;
+        flush_buffer_->last_lsn_ = INVALID_LSN;
+
+        lock.lock();
+        persist_cv_.notify_all();
+    }
+}
+
+/**
+ * 截断点取包含lsn的刷盘批次的起始偏移，先把新的起始偏移持久化，再释放它之前的空间；
+ * 两步之间崩溃时恢复只是多扫描一段日志
+ */
+off_t LogManager::TruncateLog(lsn_t lsn) {
+    off_t offset = -1;
+    {
+        std::scoped_lock batch_lock{batch_latch_};
+        while (flushed_batches_.size() > 1 && flushed_batches_[1].first <= lsn) {
+            flushed_batches_.pop_front();
+        }
+        if (!flushed_batches_.empty() && flushed_batches_.front().first <= lsn) {
+            offset = flushed_batches_.front().second;
+        }
+    }
+    off_t start_offset = ReadLogStartOffset();
+    if (offset <= start_offset) {
+        return start_offset;
+    }
+    WriteLogStartOffset(offset);
+    disk_manager_->DiscardLog(offset);
+    return offset;
+}
+
+off_t LogManager::ReadLogStartOffset() {
+    int fd = open(LOG_MASTER_NAME.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    int64_t offset = 0;
+    if (read(fd, &offset, sizeof(int64_t)) != sizeof(int64_t)) {
+        offset = 0;
+    }
+    close(fd);
+    return static_cast<off_t>(offset);
+}
+
+/**
+ * 偏移固定按int64_t存储，与off_t的宽度无关；先写临时文件再rename，崩溃时LOG_MASTER_NAME要么是旧值要么是新值
+ */
+void LogManager::WriteLogStartOffset(off_t offset) {
+    std::string tmp_name = LOG_MASTER_NAME + ".tmp";
+    int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        throw UnixError();
+    }
+    int64_t master = offset;
+    if (write(fd, &master, sizeof(int64_t)) != sizeof(int64_t) || fsync(fd) != 0) {
+        close(fd);
+        throw UnixError();
+    }
+    close(fd);
+    if (rename(tmp_name.c_str(), LOG_MASTER_NAME.c_str()) != 0) {
+        throw UnixError();
+    }
+}
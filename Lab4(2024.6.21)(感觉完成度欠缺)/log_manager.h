@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "log_record.h"
+#include "storage/disk_manager.h"
+
+/* 记录日志文件中有效部分起始偏移的文件，日志截断后恢复从这里开始扫描 */
+static const std::string LOG_MASTER_NAME = "db.log.master";
+
+/* 日志缓冲区，保存尚未写入磁盘的日志记录 */
+struct LogBuffer {
+    char buffer_[LOG_BUFFER_SIZE];
+    int offset_ = 0;                 // 已写入的字节数
+    lsn_t first_lsn_ = INVALID_LSN;  // 缓冲区中第一条日志记录的LSN
+    lsn_t last_lsn_ = INVALID_LSN;   // 缓冲区中最后一条日志记录的LSN
+
+    bool is_full(int append_size) const { return offset_ + append_size > LOG_BUFFER_SIZE; }
+};
+
+/**
+ * @brief 日志管理器，负责分配LSN、缓存日志记录并把它们刷入日志文件
+ * 日志尾部采用双缓冲：事务总是向active_buffer_追加日志，后台flush线程把active_buffer_与
+ * flush_buffer_交换之后，在不持有latch_的情况下写入并fsync flush_buffer_，期间新的日志可以继续追加。
+ * 提交的事务在WaitForFlush()中等待自己的commit日志落盘；一次fsync覆盖这段时间内所有追加的日志，
+ * 因此并发提交的事务共享同一次fsync(group commit)。
+ * 缓冲池在写回脏页之前调用WaitForFlush(page_lsn)，保证日志先于数据页落盘(WAL)。
+ */
+class LogManager {
+   public:
+    /* flush线程在没有刷盘请求时的最长等待时间，限制异步写入的日志在内存中停留的时间 */
+    static constexpr std::chrono::microseconds LOG_FLUSH_INTERVAL{1000};
+
+    explicit LogManager(DiskManager *disk_manager);
+
+    ~LogManager();
+
+    /**
+     * @brief 为log_record分配LSN，并把它序列化到日志缓冲区中
+     * 缓冲区空间不足时阻塞，直到flush线程交换出一个空的缓冲区
+     * @return 分配的LSN
+     */
+    lsn_t add_log_to_buffer(LogRecord *log_record);
+
+    /** 把当前已追加的所有日志刷入磁盘，阻塞直到完成 */
+    void flush_log_to_disk();
+
+    /**
+     * @brief 阻塞直到LSN <= lsn的日志全部落盘
+     * 只唤醒flush线程而不自己写盘，等待期间其他事务追加的日志会被同一次fsync一起持久化
+     */
+    void WaitForFlush(lsn_t lsn);
+
+    /** 已经落盘的最大LSN */
+    lsn_t GetPersistLsn() const { return persist_lsn_.load(); }
+
+    /** 下一条日志记录将分配的LSN */
+    lsn_t GetNextLsn() const { return next_lsn_.load(); }
+
+    /** 恢复时调用：日志文件中已有LSN < next_lsn的日志，它们都已经落盘 */
+    void SetNextLsn(lsn_t next_lsn) {
+        next_lsn_.store(next_lsn);
+        persist_lsn_.store(next_lsn - 1);
+        log_file_size_ = std::max<off_t>(disk_manager_->GetFileSize(LOG_FILE_NAME), 0);
+    }
+
+    /**
+     * @brief 丢弃日志文件中LSN < lsn的日志所占的空间，由检查点在确认这些日志不再被恢复需要后调用
+     * 只能以刷盘批次为单位截断，保留的部分可能包含少量LSN < lsn的日志；日志文件中的偏移保持不变，
+     * 新的起始偏移以64位整数写入LOG_MASTER_NAME
+     * @return 截断后日志的起始偏移
+     */
+    off_t TruncateLog(lsn_t lsn);
+
+    /** 日志中有效部分的起始偏移，没有截断过时为0 */
+    static off_t ReadLogStartOffset();
+
+    /** 启动后台flush线程的fsync次数，可以与提交的事务数对比group commit的效果 */
+    size_t GetNumFlushes() const { return num_flushes_.load(); }
+
+   private:
+    /** flush线程：等待刷盘请求或超时，交换缓冲区后写入并fsync */
+    void RunFlushThread();
+
+    static void WriteLogStartOffset(off_t offset);
+
+    DiskManager *disk_manager_;
+    std::unique_ptr<LogBuffer> active_buffer_;  // 正在追加的缓冲区，受latch_保护
+    std::unique_ptr<LogBuffer> flush_buffer_;   // 正在刷盘的缓冲区，只由flush线程访问
+
+    // LSN从1开始，页面LSN为0(新页面或不写日志的页面)表示页面上没有需要等待落盘的日志
+    std::atomic<lsn_t> next_lsn_{1};
+    std::atomic<lsn_t> persist_lsn_{0};
+    std::atomic<size_t> num_flushes_{0};
+
+    std::mutex latch_;
+    std::condition_variable flush_cv_;    // 唤醒flush线程
+    std::condition_variable persist_cv_;  // 通知等待落盘或等待缓冲区空间的事务
+    bool flush_requested_ = false;
+    bool shutdown_ = false;
+    std::thread flush_thread_;
+
+    off_t log_file_size_ = 0;  // 日志文件的长度，由flush线程维护
+    std::mutex batch_latch_;  // 保护flushed_batches_
+    std::deque<std::pair<lsn_t, off_t>> flushed_batches_;  // 每次刷盘的(第一条日志的LSN, 在日志文件中的偏移)
+};
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+#include "record/rm_defs.h"
+
+/**
+ * 日志记录的类型
+ * MARK_DELETE: 事务的删除，只在版本链中留下删除标记，记录文件不变，因此不需要redo；
+ * 事务提交后记录由GC以一条普通的DELETE真正删除，恢复时补做已提交但尚未回收的删除
+ * CKPT_BEGIN/CKPT_END: 模糊检查点的开始和结束，CKPT_END中保存两者之间获取的ATT和DPT
+ */
+enum LogType : int { UPDATE = 0, INSERT, DELETE, BEGIN, COMMIT, ABORT, MARK_DELETE, CKPT_BEGIN, CKPT_END };
+
+static std::string LogTypeStr[] = {"UPDATE", "INSERT", "DELETE",     "BEGIN",   "COMMIT",
+                                   "ABORT",  "MARK_DELETE", "CKPT_BEGIN", "CKPT_END"};
+
+/**
+ * @brief 日志记录的基类，所有日志记录以相同的头部开始
+ * 头部格式: | log_type_ | lsn_ | log_tot_len_ | log_tid_ | prev_lsn_ |
+ * prev_lsn_把同一个事务的日志记录按写入顺序反向串成一条链，用于回滚和恢复时的undo
+ */
+class LogRecord {
+   public:
+    static constexpr int OFFSET_LOG_TYPE = 0;
+    static constexpr int OFFSET_LSN = OFFSET_LOG_TYPE + sizeof(LogType);
+    static constexpr int OFFSET_LOG_TOT_LEN = OFFSET_LSN + sizeof(lsn_t);
+    static constexpr int OFFSET_LOG_TID = OFFSET_LOG_TOT_LEN + sizeof(uint32_t);
+    static constexpr int OFFSET_PREV_LSN = OFFSET_LOG_TID + sizeof(txn_id_t);
+    static constexpr int LOG_HEADER_SIZE = OFFSET_PREV_LSN + sizeof(lsn_t);
+
+    LogType log_type_;
+    lsn_t lsn_ = INVALID_LSN;
+    uint32_t log_tot_len_ = LOG_HEADER_SIZE;  // 整条日志记录的长度，包括头部
+    txn_id_t log_tid_ = INVALID_TXN_ID;
+    lsn_t prev_lsn_ = INVALID_LSN;
+
+    LogRecord(LogType log_type, txn_id_t txn_id) : log_type_(log_type), log_tid_(txn_id) {}
+    virtual ~LogRecord() = default;
+
+    /** 把日志记录序列化到dest中，dest至少有log_tot_len_字节 */
+    virtual void serialize(char *dest) const {
+        memcpy(dest + OFFSET_LOG_TYPE, &log_type_, sizeof(LogType));
+        memcpy(dest + OFFSET_LSN, &lsn_, sizeof(lsn_t));
+        memcpy(dest + OFFSET_LOG_TOT_LEN, &log_tot_len_, sizeof(uint32_t));
+        memcpy(dest + OFFSET_LOG_TID, &log_tid_, sizeof(txn_id_t));
+        memcpy(dest + OFFSET_PREV_LSN, &prev_lsn_, sizeof(lsn_t));
+    }
+
+    /** 从src中反序列化日志记录 */
+    virtual void deserialize(const char *src) {
+        log_type_ = *reinterpret_cast<const LogType *>(src + OFFSET_LOG_TYPE);
+        lsn_ = *reinterpret_cast<const lsn_t *>(src + OFFSET_LSN);
+        log_tot_len_ = *reinterpret_cast<const uint32_t *>(src + OFFSET_LOG_TOT_LEN);
+        log_tid_ = *reinterpret_cast<const txn_id_t *>(src + OFFSET_LOG_TID);
+        prev_lsn_ = *reinterpret_cast<const lsn_t *>(src + OFFSET_PREV_LSN);
+    }
+
+   protected:
+    /** 辅助函数：写入一条长度前缀的记录，返回写入的字节数 */
+    static int serialize_record(char *dest, const RmRecord &record) {
+        memcpy(dest, &record.size, sizeof(int));
+        memcpy(dest + sizeof(int), record.data, record.size);
+        return sizeof(int) + record.size;
+    }
+
+    static int deserialize_record(const char *src, RmRecord &record) {
+        int size = *reinterpret_cast<const int *>(src);
+        record = RmRecord(size, const_cast<char *>(src + sizeof(int)));
+        return sizeof(int) + size;
+    }
+
+    static int serialize_string(char *dest, const std::string &str) {
+        size_t len = str.size();
+        memcpy(dest, &len, sizeof(size_t));
+        memcpy(dest + sizeof(size_t), str.data(), len);
+        return sizeof(size_t) + len;
+    }
+
+    static int deserialize_string(const char *src, std::string &str) {
+        size_t len = *reinterpret_cast<const size_t *>(src);
+        str.assign(src + sizeof(size_t), len);
+        return sizeof(size_t) + len;
+    }
+};
+
+/* 事务开始、提交、终止的日志记录只有头部 */
+class BeginLogRecord : public LogRecord {
+   public:
+    explicit BeginLogRecord(txn_id_t txn_id = INVALID_TXN_ID) : LogRecord(LogType::BEGIN, txn_id) {}
+};
+
+class CommitLogRecord : public LogRecord {
+   public:
+    explicit CommitLogRecord(txn_id_t txn_id = INVALID_TXN_ID) : LogRecord(LogType::COMMIT, txn_id) {}
+};
+
+class AbortLogRecord : public LogRecord {
+   public:
+    explicit AbortLogRecord(txn_id_t txn_id = INVALID_TXN_ID) : LogRecord(LogType::ABORT, txn_id) {}
+};
+
+/**
+ * @brief 插入和删除的日志记录，保存记录的完整内容(after image / before image)
+ * 格式: | header | record | rid | table_name |
+ */
+class InsertOrDeleteLogRecord : public LogRecord {
+   public:
+    RmRecord record_;
+    Rid rid_;
+    std::string table_name_;
+
+    InsertOrDeleteLogRecord(LogType log_type, txn_id_t txn_id, const RmRecord &record, const Rid &rid,
+                            const std::string &table_name)
+        : LogRecord(log_type, txn_id), record_(record), rid_(rid), table_name_(table_name) {
+        log_tot_len_ += sizeof(int) + record_.size + sizeof(Rid) + sizeof(size_t) + table_name_.size();
+    }
+
+    /** 用于反序列化 */
+    explicit InsertOrDeleteLogRecord(LogType log_type) : LogRecord(log_type, INVALID_TXN_ID) {}
+
+    void serialize(char *dest) const override {
+        LogRecord::serialize(dest);
+        int offset = LOG_HEADER_SIZE;
+        offset += serialize_record(dest + offset, record_);
+        memcpy(dest + offset, &rid_, sizeof(Rid));
+        offset += sizeof(Rid);
+        serialize_string(dest + offset, table_name_);
+    }
+
+    void deserialize(const char *src) override {
+        LogRecord::deserialize(src);
+        int offset = LOG_HEADER_SIZE;
+        offset += deserialize_record(src + offset, record_);
+        rid_ = *reinterpret_cast<const Rid *>(src + offset);
+        offset += sizeof(Rid);
+        deserialize_string(src + offset, table_name_);
+    }
+};
+
+class InsertLogRecord : public InsertOrDeleteLogRecord {
+   public:
+    InsertLogRecord(txn_id_t txn_id, const RmRecord &record, const Rid &rid, const std::string &table_name)
+        : InsertOrDeleteLogRecord(LogType::INSERT, txn_id, record, rid, table_name) {}
+    InsertLogRecord() : InsertOrDeleteLogRecord(LogType::INSERT) {}
+};
+
+class DeleteLogRecord : public InsertOrDeleteLogRecord {
+   public:
+    DeleteLogRecord(txn_id_t txn_id, const RmRecord &record, const Rid &rid, const std::string &table_name)
+        : InsertOrDeleteLogRecord(LogType::DELETE, txn_id, record, rid, table_name) {}
+    DeleteLogRecord() : InsertOrDeleteLogRecord(LogType::DELETE) {}
+};
+
+class MarkDeleteLogRecord : public InsertOrDeleteLogRecord {
+   public:
+    MarkDeleteLogRecord(txn_id_t txn_id, const RmRecord &record, const Rid &rid, const std::string &table_name)
+        : InsertOrDeleteLogRecord(LogType::MARK_DELETE, txn_id, record, rid, table_name) {}
+    MarkDeleteLogRecord() : InsertOrDeleteLogRecord(LogType::MARK_DELETE) {}
+};
+
+/**
+ * @brief 更新的日志记录，同时保存更新前后的记录内容
+ * 格式: | header | old_record | new_record | rid | table_name |
+ */
+class UpdateLogRecord : public LogRecord {
+   public:
+    RmRecord old_record_;
+    RmRecord new_record_;
+    Rid rid_;
+    std::string table_name_;
+
+    UpdateLogRecord(txn_id_t txn_id, const RmRecord &old_record, const RmRecord &new_record, const Rid &rid,
+                    const std::string &table_name)
+        : LogRecord(LogType::UPDATE, txn_id),
+          old_record_(old_record),
+          new_record_(new_record),
+          rid_(rid),
+          table_name_(table_name) {
+        log_tot_len_ += 2 * sizeof(int) + old_record_.size + new_record_.size + sizeof(Rid) + sizeof(size_t) +
+                        table_name_.size();
+    }
+
+    /** 用于反序列化 */
+    UpdateLogRecord() : LogRecord(LogType::UPDATE, INVALID_TXN_ID) {}
+
+    void serialize(char *dest) const override {
+        LogRecord::serialize(dest);
+        int offset = LOG_HEADER_SIZE;
+        offset += serialize_record(dest + offset, old_record_);
+        offset += serialize_record(dest + offset, new_record_);
+        memcpy(dest + offset, &rid_, sizeof(Rid));
+        offset += sizeof(Rid);
+        serialize_string(dest + offset, table_name_);
+    }
+
+    void deserialize(const char *src) override {
+        LogRecord::deserialize(src);
+        int offset = LOG_HEADER_SIZE;
+        offset += deserialize_record(src + offset, old_record_);
+        offset += deserialize_record(src + offset, new_record_);
+        rid_ = *reinterpret_cast<const Rid *>(src + offset);
+        offset += sizeof(Rid);
+        deserialize_string(src + offset, table_name_);
+    }
+};
+
+/* 检查点中的活跃事务表项 */
+struct ActiveTxnEntry {
+    txn_id_t txn_id;
+    lsn_t last_lsn;   // 事务最后一条日志的LSN，undo从这里开始
+    lsn_t begin_lsn;  // 事务BEGIN日志的LSN，日志截断不能越过它
+};
+
+/* 检查点中的脏页表项 */
+struct DirtyPageEntry {
+    std::string table_name;
+    int page_no;
+    lsn_t rec_lsn;  // 页面变脏以来第一条修改它的日志的LSN(下界)
+};
+
+/**
+ * @brief 模糊检查点的结束日志，保存CKPT_BEGIN之后获取的ATT和DPT
+ * 格式: | header | num_txns | ActiveTxnEntry... | num_pages | (table_name, page_no, rec_lsn)... |
+ */
+class CheckpointLogRecord : public LogRecord {
+   public:
+    std::vector<ActiveTxnEntry> active_txns_;
+    std::vector<DirtyPageEntry> dirty_pages_;
+
+    CheckpointLogRecord(std::vector<ActiveTxnEntry> active_txns, std::vector<DirtyPageEntry> dirty_pages)
+        : LogRecord(LogType::CKPT_END, INVALID_TXN_ID),
+          active_txns_(std::move(active_txns)),
+          dirty_pages_(std::move(dirty_pages)) {
+        log_tot_len_ += 2 * sizeof(size_t) + active_txns_.size() * sizeof(ActiveTxnEntry);
+        for (auto &entry : dirty_pages_) {
+            log_tot_len_ += sizeof(size_t) + entry.table_name.size() + sizeof(int) + sizeof(lsn_t);
+        }
+    }
+
+    /** 用于反序列化 */
+    CheckpointLogRecord() : LogRecord(LogType::CKPT_END, INVALID_TXN_ID) {}
+
+    void serialize(char *dest) const override {
+        LogRecord::serialize(dest);
+        int offset = LOG_HEADER_SIZE;
+        size_t num_txns = active_txns_.size();
+        memcpy(dest + offset, &num_txns, sizeof(size_t));
+        offset += sizeof(size_t);
+        memcpy(dest + offset, active_txns_.data(), num_txns * sizeof(ActiveTxnEntry));
+        offset += num_txns * sizeof(ActiveTxnEntry);
+        size_t num_pages = dirty_pages_.size();
+        memcpy(dest + offset, &num_pages, sizeof(size_t));
+        offset += sizeof(size_t);
+        for (auto &entry : dirty_pages_) {
+            offset += serialize_string(dest + offset, entry.table_name);
+            memcpy(dest + offset, &entry.page_no, sizeof(int));
+            offset += sizeof(int);
+            memcpy(dest + offset, &entry.rec_lsn, sizeof(lsn_t));
+            offset += sizeof(lsn_t);
+        }
+    }
+
+    void deserialize(const char *src) override {
+        LogRecord::deserialize(src);
+        int offset = LOG_HEADER_SIZE;
+        size_t num_txns = *reinterpret_cast<const size_t *>(src + offset);
+        offset += sizeof(size_t);
+        active_txns_.resize(num_txns);
+        memcpy(active_txns_.data(), src + offset, num_txns * sizeof(ActiveTxnEntry));
+        offset += num_txns * sizeof(ActiveTxnEntry);
+        size_t num_pages = *reinterpret_cast<const size_t *>(src + offset);
+        offset += sizeof(size_t);
+        dirty_pages_.resize(num_pages);
+        for (auto &entry : dirty_pages_) {
+            offset += deserialize_string(src + offset, entry.table_name);
+            entry.page_no = *reinterpret_cast<const int *>(src + offset);
+            offset += sizeof(int);
+            entry.rec_lsn = *reinterpret_cast<const lsn_t *>(src + offset);
+            offset += sizeof(lsn_t);
+        }
+    }
+};
@@ -0,0 +1,409 @@
+#include "log_recovery.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <queue>
+#include <thread>
+
+#include "record/rm.h"
+
+/**
+ * @description: analyze阶段，需要获得脏页表（DPT）和未完成的事务列表（ATT）
+ * 同时记录每条日志在日志文件中的偏移，并截掉末尾不完整的日志记录，之后新写入的日志紧接在最后一条完整日志之后。
+ * 扫描从截断后日志的起始偏移开始；遇到完整的检查点时，CKPT_BEGIN之前建立的DPT被检查点中的DPT取代：
+ * 那时不在检查点DPT中的页面已经落盘
+ */
+void RecoveryManager::analyze() {
+    std::map<PageKey, lsn_t> pre_checkpoint_pages;  // CKPT_BEGIN之前的DPT，检查点不完整时需要恢复
+    bool in_checkpoint = false;
+    std::unordered_set<txn_id_t> aborted_txns;
+    log_start_ = LogManager::ReadLogStartOffset();
+    log_end_ = log_start_;
+    scan_log(log_start_, [&](std::unique_ptr<LogRecord> &log, off_t offset) {
+        LogRecord *log_record = log.get();
+        lsn_t lsn = log_record->lsn_;
+        txn_id_t txn_id = log_record->log_tid_;
+        lsn_offsets_[lsn] = offset;
+        max_lsn_ = std::max(max_lsn_, lsn);
+        log_end_ = offset + log_record->log_tot_len_;
+
+        switch (log_record->log_type_) {
+            case LogType::COMMIT:
+                active_txns_.erase(txn_id);
+                committed_txns_.insert(txn_id);
+                return;
+            case LogType::ABORT:
+                active_txns_.erase(txn_id);
+                aborted_txns.insert(txn_id);
+                return;
+            case LogType::CKPT_BEGIN:
+                pre_checkpoint_pages = std::move(dirty_pages_);
+                dirty_pages_.clear();
+                in_checkpoint = true;
+                return;
+            case LogType::CKPT_END: {
+                auto ckpt_log = static_cast<CheckpointLogRecord *>(log_record);
+                for (auto &entry : ckpt_log->dirty_pages_) {
+                    auto pos = dirty_pages_.emplace(PageKey{entry.table_name, entry.page_no}, entry.rec_lsn).first;
+                    pos->second = std::min(pos->second, entry.rec_lsn);
+                    auto &max_page_no = max_page_no_[entry.table_name];
+                    max_page_no = std::max(max_page_no, entry.page_no);
+                }
+                // 检查点之前开始、在获取ATT之后才结束的事务已经在扫描中被移除，不能再加回来
+                for (auto &entry : ckpt_log->active_txns_) {
+                    if (!committed_txns_.count(entry.txn_id) && !aborted_txns.count(entry.txn_id)) {
+                        active_txns_.emplace(entry.txn_id, entry.last_lsn);
+                    }
+                }
+                pre_checkpoint_pages.clear();
+                in_checkpoint = false;
+                return;
+            }
+            default:
+                break;
+        }
+        // GC以INVALID_TXN_ID写的DELETE不属于任何事务，只需要redo
+        if (txn_id != INVALID_TXN_ID) {
+            active_txns_[txn_id] = lsn;
+        }
+        if (log_record->log_type_ == LogType::BEGIN) {
+            return;
+        }
+        auto del_log = dynamic_cast<InsertOrDeleteLogRecord *>(log_record);
+        auto upd_log = dynamic_cast<UpdateLogRecord *>(log_record);
+        const std::string &table_name = del_log != nullptr ? del_log->table_name_ : upd_log->table_name_;
+        const Rid &rid = del_log != nullptr ? del_log->rid_ : upd_log->rid_;
+        RidKey rid_key{table_name, {rid.page_no, rid.slot_no}};
+        if (log_record->log_type_ == LogType::MARK_DELETE) {
+            mark_deletes_[rid_key] = txn_id;
+            return;
+        }
+        if (log_record->log_type_ == LogType::DELETE) {
+            mark_deletes_.erase(rid_key);
+        }
+        dirty_pages_.emplace(PageKey{table_name, rid.page_no}, lsn);
+        auto &max_page_no = max_page_no_[table_name];
+        max_page_no = std::max(max_page_no, rid.page_no);
+    });
+    if (in_checkpoint) {
+        for (auto &entry : pre_checkpoint_pages) {
+            auto pos = dirty_pages_.emplace(entry.first, entry.second).first;
+            pos->second = std::min(pos->second, entry.second);
+        }
+    }
+
+    if (log_end_ < disk_manager_->GetFileSize(LOG_FILE_NAME)) {
+        if (ftruncate(disk_manager_->GetLogFd(), log_end_) != 0) {
+            throw UnixError();
+        }
+    }
+    log_manager_->SetNextLsn(max_lsn_ + 1);
+}
+
+/**
+ * @description: 重做所有未落盘的操作
+ * 从DPT中最小的recLSN开始扫描日志(已被截断的日志所做的修改都已落盘)，把数据日志按(表, 页号)划分给若干线程；
+ * 不同页面之间的修改互不依赖，同一页面的日志在同一线程中按LSN顺序重做
+ */
+void RecoveryManager::redo() {
+    if (dirty_pages_.empty()) {
+        return;
+    }
+    // 先把记录文件扩展到日志中出现过的最大页号，避免多个线程同时扩展同一个文件
+    for (auto &entry : max_page_no_) {
+        RmFileHandle *fh = get_file_handle(entry.first);
+        if (fh == nullptr) {
+            continue;
+        }
+        while (fh->get_file_hdr().num_pages <= entry.second) {
+            RmPageHandle page_handle = fh->create_new_page_handle();
+            buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), true);
+        }
+    }
+
+    lsn_t redo_lsn = INVALID_LSN;
+    for (auto &entry : dirty_pages_) {
+        if (redo_lsn == INVALID_LSN || entry.second < redo_lsn) {
+            redo_lsn = entry.second;
+        }
+    }
+    int num_threads = std::min<int>(MAX_REDO_THREADS, std::max<unsigned>(std::thread::hardware_concurrency(), 1));
+    std::vector<std::vector<std::unique_ptr<LogRecord>>> partitions(num_threads);
+    std::hash<std::string> hash_table;
+    // recLSN只是下界，不一定恰好是某条日志的LSN
+    auto redo_pos = lsn_offsets_.lower_bound(redo_lsn);
+    off_t redo_offset = redo_pos == lsn_offsets_.end() ? log_end_ : redo_pos->second;
+    scan_log(redo_offset, [&](std::unique_ptr<LogRecord> &log, off_t offset) {
+        LogRecord *log_record = log.get();
+        if (!is_data_log(log_record->log_type_)) {
+            return;
+        }
+        auto del_log = dynamic_cast<InsertOrDeleteLogRecord *>(log_record);
+        auto upd_log = dynamic_cast<UpdateLogRecord *>(log_record);
+        const std::string &table_name = del_log != nullptr ? del_log->table_name_ : upd_log->table_name_;
+        int page_no = del_log != nullptr ? del_log->rid_.page_no : upd_log->rid_.page_no;
+        // DPT中页面的recLSN之前的修改已经落盘
+        auto pos = dirty_pages_.find(PageKey{table_name, page_no});
+        if (pos == dirty_pages_.end() || log_record->lsn_ < pos->second) {
+            return;
+        }
+        size_t part = (hash_table(table_name) * 31 + page_no) % num_threads;
+        partitions[part].push_back(std::move(log));
+    });
+
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors(num_threads);
+    for (int i = 0; i < num_threads; i++) {
+        workers.emplace_back([&, i] {
+            try {
+                for (auto &log_record : partitions[i]) {
+                    redo_log(log_record.get());
+                }
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    for (auto &error : errors) {
+        if (error != nullptr) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+/**
+ * @description: 回滚未完成的事务
+ * 所有loser的日志按LSN从大到小撤销，每个loser沿prev_lsn回溯到BEGIN后写一条ABORT；
+ * 撤销操作以loser的身份写入日志，恢复过程中再次崩溃时，下次恢复会连同这些日志一起撤销，结果不变
+ */
+void RecoveryManager::undo() {
+    std::unordered_map<txn_id_t, std::unique_ptr<Transaction>> losers;
+    std::priority_queue<std::pair<lsn_t, txn_id_t>> to_undo;
+    for (auto &entry : active_txns_) {
+        auto txn = std::make_unique<Transaction>(entry.first);
+        txn->SetPrevLsn(entry.second);
+        txn->SetState(TransactionState::ABORTED);
+        losers.emplace(entry.first, std::move(txn));
+        to_undo.emplace(entry.second, entry.first);
+    }
+    while (!to_undo.empty()) {
+        auto [lsn, txn_id] = to_undo.top();
+        to_undo.pop();
+        Transaction *txn = losers.at(txn_id).get();
+        auto log_record = read_log(lsn_offsets_.at(lsn));
+        Context context(nullptr, log_manager_, txn);
+        undo_log(log_record.get(), &context);
+        if (log_record->prev_lsn_ != INVALID_LSN) {
+            to_undo.emplace(log_record->prev_lsn_, txn_id);
+        } else {
+            AbortLogRecord abort_log(txn_id);
+            abort_log.prev_lsn_ = txn->GetPrevLsn();
+            txn->SetPrevLsn(log_manager_->add_log_to_buffer(&abort_log));
+        }
+    }
+    active_txns_.clear();
+
+    finish_mark_deletes();
+    log_manager_->flush_log_to_disk();
+    rebuild_indexes();
+}
+
+void RecoveryManager::scan_log(off_t offset, const std::function<void(std::unique_ptr<LogRecord> &, off_t)> &visit) {
+    std::vector<char> buffer(LOG_BUFFER_SIZE);
+    while (disk_manager_->ReadLog(buffer.data(), LOG_BUFFER_SIZE, offset, 0)) {
+        int size = static_cast<int>(std::min<off_t>(LOG_BUFFER_SIZE, disk_manager_->GetFileSize(LOG_FILE_NAME) - offset));
+        int pos = 0;
+        while (pos + LogRecord::LOG_HEADER_SIZE <= size) {
+            const char *src = buffer.data() + pos;
+            auto len = *reinterpret_cast<const uint32_t *>(src + LogRecord::OFFSET_LOG_TOT_LEN);
+            auto log_type = *reinterpret_cast<const LogType *>(src + LogRecord::OFFSET_LOG_TYPE);
+            if (len < LogRecord::LOG_HEADER_SIZE || log_type < LogType::UPDATE || log_type > LogType::CKPT_END) {
+                return;  // 不完整的日志记录
+            }
+            if (pos + static_cast<int>(len) > size) {
+                break;  // 跨越了缓冲区末尾，从它的起始位置重新读
+            }
+            auto log_record = create_log_record(log_type);
+            log_record->deserialize(src);
+            visit(log_record, offset + pos);
+            pos += len;
+        }
+        if (pos == 0) {
+            return;
+        }
+        offset += pos;
+    }
+}
+
+std::unique_ptr<LogRecord> RecoveryManager::read_log(off_t offset) {
+    char header[LogRecord::LOG_HEADER_SIZE];
+    disk_manager_->ReadLog(header, LogRecord::LOG_HEADER_SIZE, offset, 0);
+    auto len = *reinterpret_cast<const uint32_t *>(header + LogRecord::OFFSET_LOG_TOT_LEN);
+    auto log_type = *reinterpret_cast<const LogType *>(header + LogRecord::OFFSET_LOG_TYPE);
+    std::vector<char> buf(len);
+    disk_manager_->ReadLog(buf.data(), len, offset, 0);
+    auto log_record = create_log_record(log_type);
+    log_record->deserialize(buf.data());
+    return log_record;
+}
+
+std::unique_ptr<LogRecord> RecoveryManager::create_log_record(LogType log_type) {
+    switch (log_type) {
+        case LogType::INSERT:
+            return std::make_unique<InsertLogRecord>();
+        case LogType::DELETE:
+            return std::make_unique<DeleteLogRecord>();
+        case LogType::MARK_DELETE:
+            return std::make_unique<MarkDeleteLogRecord>();
+        case LogType::UPDATE:
+            return std::make_unique<UpdateLogRecord>();
+        case LogType::CKPT_END:
+            return std::make_unique<CheckpointLogRecord>();
+        default:
+            return std::make_unique<LogRecord>(log_type, INVALID_TXN_ID);
+    }
+}
+
+RmFileHandle *RecoveryManager::get_file_handle(const std::string &table_name) {
+    try {
+        return sm_manager_->get_file_handle(table_name);
+    } catch (TableNotFoundError &) {
+        return nullptr;
+    }
+}
+
+bool RecoveryManager::need_redo(RmFileHandle *fh, const Rid &rid, lsn_t lsn, bool *exists) {
+    RmPageHandle page_handle = fh->fetch_page_handle(rid.page_no);
+    bool need = page_handle.page->GetPageLsn() < lsn;
+    *exists = Bitmap::is_set(page_handle.bitmap, rid.slot_no);
+    buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), false);
+    return need;
+}
+
+bool RecoveryManager::record_exists(RmFileHandle *fh, const Rid &rid) {
+    bool exists;
+    need_redo(fh, rid, INVALID_LSN, &exists);
+    return exists;
+}
+
+void RecoveryManager::set_page_lsn(RmFileHandle *fh, int page_no, lsn_t lsn) {
+    RmPageHandle page_handle = fh->fetch_page_handle(page_no);
+    page_handle.page->SetPageLsn(lsn);
+    buffer_pool_manager_->UnpinPage(page_handle.page->GetPageId(), true);
+}
+
+/**
+ * 重做一条数据日志，修改只作用于日志中的页面，因此可以与其他页面的重做并行
+ */
+void RecoveryManager::redo_log(LogRecord *log_record) {
+    bool exists;
+    if (log_record->log_type_ == LogType::UPDATE) {
+        auto upd_log = static_cast<UpdateLogRecord *>(log_record);
+        RmFileHandle *fh = get_file_handle(upd_log->table_name_);
+        if (fh == nullptr || !need_redo(fh, upd_log->rid_, upd_log->lsn_, &exists)) {
+            return;
+        }
+        if (exists) {
+            fh->update_record(upd_log->rid_, upd_log->new_record_.data, nullptr);
+        } else {
+            fh->insert_record(upd_log->rid_, upd_log->new_record_.data);
+        }
+        set_page_lsn(fh, upd_log->rid_.page_no, upd_log->lsn_);
+        return;
+    }
+    auto del_log = static_cast<InsertOrDeleteLogRecord *>(log_record);
+    RmFileHandle *fh = get_file_handle(del_log->table_name_);
+    if (fh == nullptr || !need_redo(fh, del_log->rid_, del_log->lsn_, &exists)) {
+        return;
+    }
+    if (log_record->log_type_ == LogType::INSERT) {
+        if (exists) {
+            fh->update_record(del_log->rid_, del_log->record_.data, nullptr);
+        } else {
+            fh->insert_record(del_log->rid_, del_log->record_.data);
+        }
+    } else if (exists) {
+        fh->delete_record(del_log->rid_, nullptr);
+    }
+    set_page_lsn(fh, del_log->rid_.page_no, del_log->lsn_);
+}
+
+/**
+ * 撤销一条数据日志：INSERT对应删除，DELETE对应重新插入，UPDATE对应写回旧值；
+ * 与TransactionManager::Abort()中按撤销项类型所做的回滚相同
+ */
+void RecoveryManager::undo_log(LogRecord *log_record, Context *context) {
+    if (log_record->log_type_ == LogType::UPDATE) {
+        auto upd_log = static_cast<UpdateLogRecord *>(log_record);
+        RmFileHandle *fh = get_file_handle(upd_log->table_name_);
+        if (fh != nullptr && record_exists(fh, upd_log->rid_)) {
+            fh->update_record(upd_log->rid_, upd_log->old_record_.data, context);
+        }
+        return;
+    }
+    if (log_record->log_type_ != LogType::INSERT && log_record->log_type_ != LogType::DELETE) {
+        return;  // BEGIN以及只存在于内存版本链中的删除标记
+    }
+    auto del_log = static_cast<InsertOrDeleteLogRecord *>(log_record);
+    RmFileHandle *fh = get_file_handle(del_log->table_name_);
+    if (fh == nullptr) {
+        return;
+    }
+    bool exists = record_exists(fh, del_log->rid_);
+    if (log_record->log_type_ == LogType::INSERT && exists) {
+        fh->delete_record(del_log->rid_, context);
+    } else if (log_record->log_type_ == LogType::DELETE && !exists) {
+        fh->insert_record(del_log->rid_, del_log->record_.data, context);
+    }
+}
+
+/**
+ * 已提交的删除标记在崩溃前还没被GC回收时，记录仍留在记录文件中；重启后没有任何快照需要它，直接删除
+ */
+void RecoveryManager::finish_mark_deletes() {
+    Transaction gc_txn(INVALID_TXN_ID);
+    Context context(nullptr, log_manager_, &gc_txn);
+    for (auto &entry : mark_deletes_) {
+        if (committed_txns_.count(entry.second) == 0) {
+            continue;
+        }
+        RmFileHandle *fh = get_file_handle(entry.first.first);
+        Rid rid{entry.first.second.first, entry.first.second.second};
+        if (fh != nullptr && record_exists(fh, rid)) {
+            fh->delete_record(rid, &context);
+        }
+    }
+    mark_deletes_.clear();
+}
+
+/**
+ * 索引页面的修改不写日志，恢复后的索引可能与记录文件不一致，按记录文件重建所有索引
+ */
+void RecoveryManager::rebuild_indexes() {
+    auto ix_manager = sm_manager_->get_ix_manager();
+    for (auto &tab_name : sm_manager_->get_table_names()) {
+        auto &tab = sm_manager_->db_.get_table(tab_name);
+        RmFileHandle *fh = nullptr;  // 只打开有索引的表
+        for (size_t col_i = 0; col_i < tab.cols.size(); col_i++) {
+            auto &col = tab.cols[col_i];
+            if (!col.index) {
+                continue;
+            }
+            if (fh == nullptr) {
+                fh = sm_manager_->get_file_handle(tab_name);
+            }
+            sm_manager_->close_index_handle(ix_manager->get_index_name(tab.name, col_i));
+            ix_manager->destroy_index(tab.name, col_i);
+            ix_manager->create_index(tab.name, col_i, col.type, col.len);
+            auto ih = sm_manager_->get_index_handle(tab.name, col_i);
+            for (RmScan rm_scan(fh); !rm_scan.is_end(); rm_scan.next()) {
+                auto rec = fh->get_record(rm_scan.rid(), nullptr);
+                ih->insert_entry(rec->data + col.offset, rm_scan.rid(), nullptr);
+            }
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "log_manager.h"
+#include "system/sm_manager.h"
+
+/**
+ * @brief ARIES风格的崩溃恢复，在打开数据库之后、接受新事务之前依次调用analyze()、redo()、undo()
+ * analyze: 从截断后日志的起始处扫描，建立活跃事务表(ATT)和脏页表(DPT, 页面 -> recLSN)，遇到检查点时以其中的DPT为准
+ * redo:    从最小的recLSN开始重做历史；日志按页面划分给多个线程并行重做，同一页面的日志由同一线程按LSN顺序重做，
+ *          页面LSN >= 日志LSN说明修改已经在页面上，跳过
+ * undo:    按LSN从大到小撤销未结束事务(loser)的修改，撤销操作与运行时回滚一样写入日志，最后为每个loser写ABORT
+ * 索引页面不写日志，恢复完成后根据记录文件重建所有索引
+ */
+class RecoveryManager {
+   public:
+    /* 并行redo的线程数上限 */
+    static constexpr int MAX_REDO_THREADS = 16;
+
+    RecoveryManager(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, SmManager *sm_manager,
+                    LogManager *log_manager)
+        : disk_manager_(disk_manager),
+          buffer_pool_manager_(buffer_pool_manager),
+          sm_manager_(sm_manager),
+          log_manager_(log_manager) {}
+
+    void analyze();
+
+    void redo();
+
+    void undo();
+
+   private:
+    using PageKey = std::pair<std::string, int>;  // (表名, 页号)
+    using RidKey = std::pair<std::string, std::pair<int, int>>;  // (表名, (页号, slot号))
+
+    /**
+     * @brief 从日志文件的offset处开始顺序读取日志记录，遇到末尾不完整的日志记录(崩溃时写了一半)时停止
+     * visit可以取走日志记录的所有权
+     */
+    void scan_log(off_t offset, const std::function<void(std::unique_ptr<LogRecord> &, off_t)> &visit);
+
+    /** 读取日志文件offset处的一条日志记录 */
+    std::unique_ptr<LogRecord> read_log(off_t offset);
+
+    static std::unique_ptr<LogRecord> create_log_record(LogType log_type);
+
+    static bool is_data_log(LogType log_type) {
+        return log_type == LogType::INSERT || log_type == LogType::DELETE || log_type == LogType::UPDATE;
+    }
+
+    /** 数据日志所修改的表，表已被删除时返回nullptr */
+    RmFileHandle *get_file_handle(const std::string &table_name);
+
+    /**
+     * @brief rid所在页面的LSN是否小于lsn，即该日志的修改尚未反映在页面上
+     * @param[out] exists rid处是否有记录
+     */
+    bool need_redo(RmFileHandle *fh, const Rid &rid, lsn_t lsn, bool *exists);
+
+    bool record_exists(RmFileHandle *fh, const Rid &rid);
+
+    void set_page_lsn(RmFileHandle *fh, int page_no, lsn_t lsn);
+
+    void redo_log(LogRecord *log_record);
+
+    /** 撤销一条数据日志，撤销操作通过context写入日志 */
+    void undo_log(LogRecord *log_record, Context *context);
+
+    /** 补做已提交但尚未被GC回收的快照隔离删除 */
+    void finish_mark_deletes();
+
+    void rebuild_indexes();
+
+    DiskManager *disk_manager_;
+    BufferPoolManager *buffer_pool_manager_;
+    SmManager *sm_manager_;
+    LogManager *log_manager_;
+
+    std::unordered_map<txn_id_t, lsn_t> active_txns_;  // ATT: 未结束的事务 -> 最后一条日志的LSN
+    std::unordered_set<txn_id_t> committed_txns_;
+    std::map<PageKey, lsn_t> dirty_pages_;                // DPT: 页面 -> recLSN
+    std::unordered_map<std::string, int> max_page_no_;   // 每个表在日志中出现过的最大页号，redo前据此扩展文件
+    std::map<lsn_t, off_t> lsn_offsets_;                 // LSN -> 日志文件偏移，用于redo定位起点和undo时沿prev_lsn回溯
+    std::map<RidKey, txn_id_t> mark_deletes_;            // 尚未被回收的删除标记 -> 打标记的事务
+    lsn_t max_lsn_ = 0;
+    off_t log_start_ = 0;  // 截断后日志的起始偏移
+    off_t log_end_ = 0;    // 最后一条完整日志记录的末尾
+};
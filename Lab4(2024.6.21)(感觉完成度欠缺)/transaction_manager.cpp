@@ -1,8 +1,80 @@
 #include "transaction_manager.h"
+
+#include <set>
+#include <tuple>
+
+#include "common/context.h"
 #include "record/rm_file_handle.h"
 
 std::unordered_map<txn_id_t, Transaction *> TransactionManager::txn_map = {};
 
+using TableMap = std::unordered_map<int, std::pair<std::string, RmFileHandle *>>;
+
+/**
+ * 维护tab_name上的所有索引：把rec中各索引列的键删除(is_insert为false)或插入(is_insert为true)
+ * 用于事务回滚和MVCC回收删除标记；非快照隔离事务删除记录时已经删除了索引项，之后同一个键可能已被插入到
+ * 别的rid上，因此只删除仍指向rid的索引项
+ */
+static void maintain_indexes(SmManager *sm_manager, const std::string &tab_name, const RmRecord &rec, const Rid &rid,
+                             bool is_insert) {
+    auto &tab = sm_manager->db_.get_table(tab_name);
+    for (size_t col_i = 0; col_i < tab.cols.size(); col_i++) {
+        auto &col = tab.cols[col_i];
+        if (!col.index) {
+            continue;
+        }
+        auto ih = sm_manager->get_index_handle(tab_name, col_i);
+        if (is_insert) {
+            ih->insert_entry(rec.data + col.offset, rid, nullptr);
+            continue;
+        }
+        std::vector<Rid> rids;
+        if (ih->GetValue(rec.data + col.offset, &rids, nullptr) && rids.front() == rid) {
+            ih->delete_entry(rec.data + col.offset, nullptr);
+        }
+    }
+}
+
+/**
+ * 撤销缓冲区中的表以fd标识，回滚和提交前先建立fd到(表名, 记录文件句柄)的映射
+ */
+static TableMap open_tables(SmManager *sm_manager) {
+    TableMap tables;
+    for (auto &[tab_name, fh] : sm_manager->get_open_file_handles()) {
+        tables.emplace(fh->GetFd(), std::make_pair(std::move(tab_name), fh));
+    }
+    return tables;
+}
+
+/**
+ * Silo的验证阶段：读集中每条记录的TID都没有变化，且没有被其他事务修改；
+ * 写集中的记录在修改时已经加了X锁并登记为writer，验证通过后其他事务无法再修改它们
+ */
+static bool validate_read_set(Transaction *txn, const TableMap &tables) {
+    for (auto &entry : *txn->GetReadSet()) {
+        auto iter = tables.find(entry.fd);
+        if (iter == tables.end() || !iter->second.second->get_tid_table()->validate(entry.rid, txn, entry.tid)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * 为txn追加一条只有头部的日志(BEGIN/COMMIT/ABORT)，并把它接到txn的日志链上
+ * @return 日志的LSN，没有日志管理器时返回INVALID_LSN
+ */
+static lsn_t append_txn_log(LogManager *log_manager, Transaction *txn, LogType log_type) {
+    if (log_manager == nullptr) {
+        return INVALID_LSN;
+    }
+    LogRecord log_record(log_type, txn->GetTransactionId());
+    log_record.prev_lsn_ = txn->GetPrevLsn();
+    lsn_t lsn = log_manager->add_log_to_buffer(&log_record);
+    txn->SetPrevLsn(lsn);
+    return lsn;
+}
+
 /**
  * 事务的开始方法
  * @param txn 事务指针
@@ -16,7 +88,32 @@ Transaction * TransactionManager::Begin(Transaction *txn, LogManager *log_manage
     // 2. 如果为空指针，创建新事务
     // 3. 把开始事务加入到全局事务表中
     // 4. 返回当前事务指针
+    // 快照隔离事务的start_ts取最近一次提交的时间戳，能看到所有commit_ts <= start_ts的版本
+    // OPTIMISTIC模式下事务默认以乐观方式执行，最近的乐观事务abort过多时，接下来的OCC_FALLBACK_TXNS个事务改用2PL
 
+    if (txn == nullptr) {
+        txn = new Transaction(next_txn_id_++, default_isolation_level_);
+    }
+    if (concurrency_mode_ == ConcurrencyMode::OPTIMISTIC &&
+        txn->GetIsolationLevel() != IsolationLevel::SNAPSHOT_ISOLATION) {
+        bool optimistic = num_occ_begins_.fetch_add(1) >= pessimistic_until_.load();
+        txn->SetOptimistic(optimistic);
+        if (!optimistic) {
+            num_occ_fallbacks_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    // start_ts、BEGIN日志和登记在同一个txn_map_latch_内完成：GarbageCollect()计算watermark时
+    // 要么看到这个事务，要么事务的start_ts不小于它读到的时间戳；检查点的ATT中也不会漏掉已写BEGIN的事务
+    std::scoped_lock lock{txn_map_latch_};
+    txn->SetStartTs(next_timestamp_.load());
+    lsn_t begin_lsn = append_txn_log(log_manager, txn, LogType::BEGIN);
+    // 与GarbageCollect()读取handle_epoch_互斥，保证事务此后访问的文件句柄不会被关闭
+    sm_manager_->advance_handle_epoch(txn->GetTransactionId());
+    txn_map[txn->GetTransactionId()] = txn;
+    active_txns_[txn->GetTransactionId()] = txn;
+    if (begin_lsn != INVALID_LSN) {
+        begin_lsns_[txn->GetTransactionId()] = begin_lsn;
+    }
     return txn;
 }
 
@@ -32,7 +129,58 @@ void TransactionManager::Commit(Transaction * txn, LogManager *log_manager) {
     // 2. 释放所有锁
     // 3. 释放事务相关资源，eg.锁集
     // 4. 更新事务状态
+    // 写事务(不论隔离级别)在commit_latch_内分配commit_ts并提交所有版本，之后才发布新的时间戳，
+    // 因此start_ts >= commit_ts的快照一定能看到本事务的全部修改
+    // 有写操作的事务要等commit日志落盘后才能让修改可见并释放锁；并发提交的事务在WaitForFlush()中
+    // 共享同一次fsync(group commit)
+    // 乐观事务先验证读集，验证失败时抛出异常，由调用者Abort；所有写事务都在commit_latch_内把修改过的记录的TID
+    // 推进为commit_ts，乐观事务据此发现读集被修改
+
+    auto undo_buffer = txn->GetUndoBuffer();
+    TableMap tables;
+    if (txn->IsOptimistic() || !undo_buffer->empty()) {
+        tables = open_tables(sm_manager_);
+    }
+    if (txn->IsOptimistic() && !validate_read_set(txn, tables)) {
+        txn->SetState(TransactionState::ABORTED);
+        throw TransactionAbortException(txn->GetTransactionId(), AbortReason::VALIDATION_FAILED);
+    }
+    lsn_t commit_lsn = append_txn_log(log_manager, txn, LogType::COMMIT);
+    if (commit_lsn != INVALID_LSN) {
+        EndTransactionLog(txn);
+        if (!undo_buffer->empty()) {
+            log_manager->WaitForFlush(commit_lsn);
+        }
+    }
+    if (!undo_buffer->empty()) {
+        std::scoped_lock lock{commit_latch_};
+        timestamp_t commit_ts = next_timestamp_.load() + 1;
+        undo_buffer->for_each_reverse([&](UndoBuffer::Entry *entry) {
+            auto fh = tables.at(entry->fd).second;
+            fh->get_version_store()->commit(entry->rid, txn->GetTransactionId(), commit_ts);
+            fh->get_tid_table()->install(entry->rid, txn->GetTransactionId(), commit_ts);
+        });
+        next_timestamp_.store(commit_ts);
+    }
+    undo_buffer->clear();
+    txn->GetReadSet()->clear();
+    if (txn->IsOptimistic()) {
+        num_occ_commits_.fetch_add(1, std::memory_order_relaxed);
+        RecordOccOutcome(false);
+    }
+
+    auto lock_set = txn->GetLockSet();
+    for (auto &lock_data_id : *lock_set) {
+        lock_manager_->Unlock(txn, lock_data_id);
+    }
+    lock_set->clear();
+    txn->SetState(TransactionState::COMMITTED);
+    EndTransaction(txn);
 
+    if (++num_commits_since_gc_ >= GC_INTERVAL_COMMITS) {
+        num_commits_since_gc_ = 0;
+        GarbageCollect(log_manager);
+    }
 }
 
 /**
@@ -47,10 +195,164 @@ void TransactionManager::Abort(Transaction * txn, LogManager *log_manager) {
     // 2. 释放所有锁
     // 3. 清空事务相关资源，eg.锁集
     // 4. 更新事务状态
+    // 所有事务的修改都登记在版本存储中，删除只留下删除标记，撤销时恢复版本信息和被修改过的记录内容，
+    // 撤销插入时真正删除记录
+    // 回滚时对记录文件的补偿操作也以普通的INSERT/DELETE/UPDATE写入日志，恢复时重做历史即可得到回滚后的状态；
+    // 状态先置为ABORTED，记录文件据此跳过版本维护，直接修改最新版本
 
+    auto undo_buffer = txn->GetUndoBuffer();
+    txn->SetState(TransactionState::ABORTED);
+    Context context(lock_manager_, log_manager, txn);
+    auto tables = undo_buffer->empty() ? TableMap{} : open_tables(sm_manager_);
+    txn_id_t txn_id = txn->GetTransactionId();
+    // 撤销缓冲区中的条目可能在修改真正登记之前就写入了(如写写冲突时的UPDATE)，此时记录的writer是其他事务，
+    // 撤销之前先找出本事务确实修改过的记录，只回滚这些记录
+    std::set<std::tuple<int, int, int>> owned;
+    undo_buffer->for_each_reverse([&](UndoBuffer::Entry *entry) {
+        if (tables.at(entry->fd).second->get_version_store()->is_writer(entry->rid, txn_id)) {
+            owned.emplace(entry->fd, entry->rid.page_no, entry->rid.slot_no);
+        }
+    });
+    undo_buffer->for_each_reverse([&](UndoBuffer::Entry *entry) {
+        auto &[tab_name, fh] = tables.at(entry->fd);
+        auto &rid = entry->rid;
+        if (owned.count({entry->fd, rid.page_no, rid.slot_no}) == 0) {
+            return;
+        }
+        // 同一条记录被本事务多次修改时，第一次abort()就恢复到事务开始前的版本，之后返回nullptr；
+        // 返回的版本可能已被本事务更新过(先更新后删除)，所以总是用它覆盖记录文件中的内容
+        auto version = fh->get_version_store()->abort(rid, txn_id);
+        if (version != nullptr) {
+            auto rec = fh->get_record(rid, nullptr);
+            maintain_indexes(sm_manager_, tab_name, *rec, rid, false);
+            fh->update_record(rid, version->image.data, &context);
+            maintain_indexes(sm_manager_, tab_name, version->image, rid, true);
+        }
+        if (entry->wtype == WType::INSERT_TUPLE) {
+            auto rec = fh->get_record(rid, nullptr);
+            maintain_indexes(sm_manager_, tab_name, *rec, rid, false);
+            fh->delete_record(rid, &context);
+        }
+    });
+    // 全部回滚完成后才清除writer，乐观事务不会读到回滚了一半的记录
+    undo_buffer->for_each_reverse([&](UndoBuffer::Entry *entry) {
+        tables.at(entry->fd).second->get_tid_table()->release(entry->rid, txn_id);
+    });
+    undo_buffer->clear();
+    txn->GetReadSet()->clear();
+    if (txn->IsOptimistic()) {
+        num_occ_aborts_.fetch_add(1, std::memory_order_relaxed);
+        RecordOccOutcome(true);
+    }
+    if (append_txn_log(log_manager, txn, LogType::ABORT) != INVALID_LSN) {
+        EndTransactionLog(txn);
+    }
+
+    auto lock_set = txn->GetLockSet();
+    for (auto &lock_data_id : *lock_set) {
+        lock_manager_->Unlock(txn, lock_data_id);
+    }
+    lock_set->clear();
+    EndTransaction(txn);
+}
+
+/**
+ * 回收所有表中不再被任何活跃快照需要的旧版本
+ * watermark取活跃的快照隔离事务中最小的start_ts；已提交且对所有快照可见的删除标记在这里
+ * 才从记录文件和索引中真正删除；最后关闭超出打开文件数上限且不再被活跃事务使用的冷文件句柄
+ * @param log_manager 真正删除记录时写DELETE日志，恢复时据此判断删除标记是否已被回收
+ * @return 回收的版本数
+ */
+size_t TransactionManager::GarbageCollect(LogManager *log_manager) {
+    // 回收过程中持有文件句柄的指针，不能与另一次回收关闭句柄并发；已有回收在进行时直接返回
+    std::unique_lock gc_lock{gc_latch_, std::try_to_lock};
+    if (!gc_lock.owns_lock()) {
+        return 0;
+    }
+    timestamp_t watermark = next_timestamp_.load();
+    timestamp_t occ_watermark = watermark;
+    uint64_t min_active_epoch;
+    {
+        std::scoped_lock lock{txn_map_latch_};
+        // 此后开始的事务访问句柄时记下的epoch都不小于这个值
+        min_active_epoch = sm_manager_->get_handle_epoch();
+        for (auto &[txn_id, txn] : active_txns_) {
+            if (txn->GetState() == TransactionState::COMMITTED || txn->GetState() == TransactionState::ABORTED) {
+                continue;
+            }
+            min_active_epoch = std::min<uint64_t>(min_active_epoch, txn_id);
+            if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION) {
+                watermark = std::min(watermark, txn->GetStartTs());
+            } else if (txn->IsOptimistic()) {
+                occ_watermark = std::min(occ_watermark, txn->GetStartTs());
+            }
+        }
+    }
+    // 回收不属于任何事务，以INVALID_TXN_ID写日志，恢复时只redo不undo
+    Transaction gc_txn(INVALID_TXN_ID);
+    Context context(lock_manager_, log_manager, &gc_txn);
+    size_t num_collected = 0;
+    for (auto &[tab_name, fh] : sm_manager_->get_open_file_handles()) {
+        num_collected += fh->get_version_store()->garbage_collect(watermark, [&](const Rid &rid) {
+            auto rec = fh->get_record(rid, nullptr);
+            maintain_indexes(sm_manager_, tab_name, *rec, rid, false);
+            fh->delete_record(rid, &context);
+        });
+        fh->get_tid_table()->prune(occ_watermark);
+    }
+    // 回收之后版本信息和TID表项为空的冷文件才能关闭
+    sm_manager_->evict_handles(min_active_epoch);
+    return num_collected;
+}
+
+/**
+ * 统计最近乐观事务的abort率(指数加权平均，每个结果的权重为1/16，满分为1024)
+ * abort率超过OCC_ABORT_RATE_THRESHOLD%时认为冲突严重，接下来的OCC_FALLBACK_TXNS个事务改用2PL，之后再尝试乐观执行
+ */
+void TransactionManager::RecordOccOutcome(bool aborted) {
+    int score = occ_abort_score_.load();
+    int new_score;
+    do {
+        new_score = score - score / 16 + (aborted ? 1024 / 16 : 0);
+    } while (!occ_abort_score_.compare_exchange_weak(score, new_score));
+    if (new_score >= 1024 * OCC_ABORT_RATE_THRESHOLD / 100 && occ_abort_score_.exchange(0) != 0) {
+        pessimistic_until_.store(num_occ_begins_.load() + OCC_FALLBACK_TXNS);
+    }
+}
+
+/** 事务写完COMMIT/ABORT日志后，检查点不再需要保留它的日志 */
+void TransactionManager::EndTransactionLog(Transaction *txn) {
+    std::scoped_lock lock{txn_map_latch_};
+    begin_lsns_.erase(txn->GetTransactionId());
 }
 
-/** 以下函数用于日志实验中的checkpoint */
+/**
+ * 事务结束(提交或回滚完成)后从活跃事务表中移除，GC和检查点只扫描仍在执行的事务；
+ * txn_map只用于按txn_id查找会话的上一个事务(GetTransaction)，不再参与这些扫描
+ */
+void TransactionManager::EndTransaction(Transaction *txn) {
+    std::scoped_lock lock{txn_map_latch_};
+    active_txns_.erase(txn->GetTransactionId());
+}
+
+/**
+ * 获取活跃事务表，用于模糊检查点；只在复制期间持有txn_map_latch_，不阻塞事务
+ * last_lsn可能在复制之后继续增长，恢复时analyze会从检查点之后的日志中看到这些日志
+ */
+std::vector<ActiveTxnEntry> TransactionManager::GetActiveTransactionTable() {
+    std::scoped_lock lock{txn_map_latch_};
+    std::vector<ActiveTxnEntry> active_txns;
+    active_txns.reserve(begin_lsns_.size());
+    for (auto &[txn_id, begin_lsn] : begin_lsns_) {
+        active_txns.push_back({txn_id, active_txns_.at(txn_id)->GetPrevLsn(), begin_lsn});
+    }
+    return active_txns;
+}
+
+/**
+ * 以下函数用于stop-the-world的checkpoint
+ * 检查点现在由CheckpointManager以模糊检查点的方式完成，不再需要阻塞事务
+ */
 void TransactionManager::BlockAllTransactions() {}
 
 void TransactionManager::ResumeAllTransactions() {}
\ No newline at end of file
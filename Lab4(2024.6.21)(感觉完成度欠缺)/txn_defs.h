@@ -8,7 +8,7 @@
 
 enum class TransactionState { DEFAULT, GROWING, SHRINKING, COMMITTED, ABORTED };
 
-enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED, SERIALIZABLE };
+enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED, SERIALIZABLE, SNAPSHOT_ISOLATION };
 
 enum class WType { INSERT_TUPLE = 0, DELETE_TUPLE, UPDATE_TUPLE};
 
@@ -47,6 +47,13 @@ class WriteRecord {
     RmRecord record_;
 };
 
+/* 乐观事务读集中的一项，提交时验证rid的TID仍为tid */
+struct OccReadEntry {
+    int fd;
+    Rid rid;
+    timestamp_t tid;
+};
+
 enum class LockDataType { TABLE = 0, RECORD = 1 };
 
 class LockDataId {
@@ -93,7 +100,7 @@ struct std::hash<LockDataId> {
     size_t operator()(const LockDataId &obj) const { return std::hash<int64_t>()(obj.Get()); }
 };
 
-enum class AbortReason { LOCK_ON_SHIRINKING = 0, UPGRADE_CONFLICT, DEADLOCK_PREVENTION };
+enum class AbortReason { LOCK_ON_SHIRINKING = 0, UPGRADE_CONFLICT, DEADLOCK_PREVENTION, DEADLOCK_DETECTION, WRITE_CONFLICT, VALIDATION_FAILED, DUPLICATE_KEY };
 
 class TransactionAbortException : public std::exception {
     txn_id_t txn_id_;
@@ -121,6 +128,25 @@ class TransactionAbortException : public std::exception {
                 return "Transaction " + std::to_string(txn_id_) + " aborted for deadlock prevention\n";
             } break;
 
+            case AbortReason::DEADLOCK_DETECTION: {
+                return "Transaction " + std::to_string(txn_id_) + " aborted as the victim of a detected deadlock\n";
+            } break;
+
+            case AbortReason::WRITE_CONFLICT: {
+                return "Transaction " + std::to_string(txn_id_) +
+                       " aborted because the record was modified by a concurrent transaction\n";
+            } break;
+
+            case AbortReason::VALIDATION_FAILED: {
+                return "Transaction " + std::to_string(txn_id_) +
+                       " aborted because its read set was modified before it committed\n";
+            } break;
+
+            case AbortReason::DUPLICATE_KEY: {
+                return "Transaction " + std::to_string(txn_id_) +
+                       " aborted because an inserted key already exists in a unique index\n";
+            } break;
+
             default: {
                 return "Transaction aborted\n";
             } break;
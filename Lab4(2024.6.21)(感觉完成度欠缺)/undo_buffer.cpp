@@ -0,0 +1,34 @@
+#include "undo_buffer.h"
+
+#include <algorithm>
+
+/**
+ * 在arena中分配一个撤销项，当前内存块放不下时新开一块
+ */
+void UndoBuffer::append(int fd, const Rid &rid, WType wtype) {
+    if (cur_ == nullptr || static_cast<size_t>(end_ - cur_) < sizeof(Entry)) {
+        size_t chunk_size = next_chunk_size_;
+        chunks_.push_back(std::make_unique<char[]>(chunk_size));
+        cur_ = chunks_.back().get();
+        end_ = cur_ + chunk_size;
+        memory_usage_ += chunk_size;
+        next_chunk_size_ = std::min(next_chunk_size_ * 2, MAX_CHUNK_SIZE);
+    }
+    auto entry = reinterpret_cast<Entry *>(cur_);
+    cur_ += sizeof(Entry);
+    entry->prev = last_;
+    entry->rid = rid;
+    entry->fd = fd;
+    entry->wtype = wtype;
+    last_ = entry;
+    num_entries_++;
+}
+
+void UndoBuffer::clear() {
+    chunks_.clear();
+    cur_ = end_ = nullptr;
+    next_chunk_size_ = MIN_CHUNK_SIZE;
+    memory_usage_ = 0;
+    last_ = nullptr;
+    num_entries_ = 0;
+}
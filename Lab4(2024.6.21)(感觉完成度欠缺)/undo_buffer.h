@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "txn_defs.h"
+
+/**
+ * @brief 事务的撤销缓冲区，按顺序记录事务修改过的记录，用于Commit时提交版本、Abort时逆序回滚
+ * 所有撤销项连续存放在事务私有的内存块(arena)中，块只增不减，事务结束时整体释放：
+ * 追加一个撤销项只是一次指针递增，不再为每条记录分配WriteRecord、表名字符串和完整的RmRecord
+ * 撤销项只记录(表的fd, rid, 操作类型)：回滚所需的旧记录由版本存储保存(非快照隔离的读者也要读到它)，
+ * 这里不再重复保存
+ * 撤销项之间用prev指针串成链表，从最后一项开始即可逆序遍历
+ */
+class UndoBuffer {
+   public:
+    static constexpr size_t MIN_CHUNK_SIZE = 4096;        // 第一个内存块的大小，之后每块翻倍
+    static constexpr size_t MAX_CHUNK_SIZE = 64 * 1024;   // 内存块大小的上限
+
+    struct Entry {
+        Entry *prev;
+        Rid rid;
+        int fd;
+        WType wtype;
+    };
+
+    UndoBuffer() = default;
+    UndoBuffer(const UndoBuffer &) = delete;
+    UndoBuffer &operator=(const UndoBuffer &) = delete;
+
+    /** 登记事务对fd中rid的一次修改，调用者在记录文件修改成功之后调用 */
+    void append(int fd, const Rid &rid, WType wtype);
+
+    /** 按追加顺序的逆序遍历所有撤销项 */
+    template <typename Visitor>
+    void for_each_reverse(Visitor &&visit) const {
+        for (Entry *entry = last_; entry != nullptr; entry = entry->prev) {
+            visit(entry);
+        }
+    }
+
+    bool empty() const { return last_ == nullptr; }
+
+    size_t size() const { return num_entries_; }
+
+    /** arena分配的总字节数 */
+    size_t memory_usage() const { return memory_usage_; }
+
+    /** 释放所有撤销项 */
+    void clear();
+
+   private:
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char *cur_ = nullptr;  // 当前内存块中第一个空闲字节
+    char *end_ = nullptr;  // 当前内存块的末尾
+    size_t next_chunk_size_ = MIN_CHUNK_SIZE;
+    size_t memory_usage_ = 0;
+    Entry *last_ = nullptr;
+    size_t num_entries_ = 0;
+};